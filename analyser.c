@@ -0,0 +1,28 @@
+#include <stdio.h>
+#include "chip8.h"
+#include "chip8_analysis.h"
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: analyser <rom.ch8>\n");
+        return 1;
+    }
+
+    chip8Rom_t* rom = chip8_romOpen(argv[1], CHIP8_MAX_ROM_SIZE);
+    if (rom == NULL) {
+        return 1;
+    }
+    chip8Analysis_t* analysis = chip8_analyse(rom->data, rom->size);
+    if (analysis == NULL) {
+        fprintf(stderr, "Failed to analyse ROM\n");
+        chip8_romClose(&rom);
+        return 1;
+    }
+
+    printf("%s: %zu bytes, hash %016llX\n", rom->path, rom->size, (unsigned long long)rom->hash);
+    chip8_analysisReport(analysis, stdout);
+
+    chip8_analysisDel(&analysis);
+    chip8_romClose(&rom);
+    return 0;
+}
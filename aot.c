@@ -0,0 +1,68 @@
+#include <stdlib.h>
+#include <string.h>
+#include "chip8.h"
+
+static void aot_usage(void) {
+    fprintf(stderr, "Usage: aot <rom.ch8>... [--dir directory]\n");
+}
+
+// prints what the artifact holds, how much of the rom runs from fused runs is up to the program
+static void aot_report(const char* romPath, const chip8Aot_t* aot, const char* path) {
+    uint32_t code = 0;
+    uint32_t longest = 0;
+    for (uint32_t i = 0; i < aot->romSize; i++) {
+        if (aot->stream[i].flags & CHIP8_AOT_CODE) {
+            code++;
+        }
+        longest = aot->stream[i].run > longest ? aot->stream[i].run : longest;
+    }
+    printf("%s: %u bytes, %u instructions in %u blocks, %u fused runs up to %u long -> %s\n", romPath,
+           aot->header->romSize, code, aot->header->blockCount, aot->header->fusedCount, longest, path);
+}
+
+int main(int argc, char** argv) {
+    const char* directory = CHIP8_AOT_DIR;
+    int romCount = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--dir") == 0 && i + 1 < argc) {
+            directory = argv[++i];
+        } else if (argv[i][0] == '-') {
+            aot_usage();
+            return 1;
+        } else {
+            romCount++;
+        }
+    }
+    if (romCount == 0) {
+        aot_usage();
+        return 1;
+    }
+    if (!CreateDirectoryA(directory, NULL) && GetLastError() != ERROR_ALREADY_EXISTS) {
+        fprintf(stderr, "Failed to create %s: %lu\n", directory, GetLastError());
+        return 1;
+    }
+
+    int failed = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--dir") == 0) {
+            i++;
+            continue;
+        }
+        chip8Rom_t* rom = chip8_romOpen(argv[i], CHIP8_XO_MAX_ROM_SIZE);
+        if (rom == NULL) {
+            failed++;
+            continue;
+        }
+        chip8Aot_t* aot = chip8_aotCompile(directory, rom);
+        if (aot == NULL) {
+            failed++;
+        } else {
+            char path[CHIP8_AOT_PATH_SIZE];
+            chip8_aotPath(directory, rom->hash, path, sizeof(path));
+            aot_report(argv[i], aot, path);
+            chip8_aotClose(&aot);
+        }
+        chip8_romClose(&rom);
+    }
+    return failed > 0 ? 1 : 0;
+}
@@ -2,7 +2,12 @@
 #include <allegro5/allegro_font.h>
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 #include "chip8.h"
+#include "chip8_audio.h"
+
+// the trace is only written when the state was created with a log file
+#define CHIP8_LOG(state, ...) do { if ((state)->log != NULL) { fprintf((state)->log, __VA_ARGS__); } } while (0)
 
 uint8_t chip8_fontset[CHIP8_FONTSET_SIZE] =
         {
@@ -37,37 +42,149 @@ uint8_t chip8_fontset[CHIP8_FONTSET_SIZE] =
                 0xF0, 0x80, 0xF0, 0x80, 0x80  // F
         };
 
+uint8_t chip8_bigFontset[CHIP8_BIG_FONTSET_SIZE] =
+        {
+                // 8x10 digits for FX30, SUPER-CHIP only defines 0-9, XO-CHIP adds A-F
+                0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, // 0
+                0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF, // 1
+                0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // 2
+                0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 3
+                0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03, // 4
+                0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 5
+                0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 6
+                0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18, // 7
+                0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 8
+                0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 9
+                0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, // A
+                0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, // B
+                0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C, // C
+                0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, // D
+                0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // E
+                0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0  // F
+        };
+
+// off, first plane, second plane, both planes
+const uint8_t chip8_palette[CHIP8_PALETTE_SIZE] = { 0x00, 0xFF, 0xAA, 0x55 };
+
 chip8State_t* chip8_init(void) {
+    return chip8_initWithLog(CHIP8_LOG_PATH);
+}
+
+chip8State_t* chip8_initWithLog(const char* logPath) {
+    return chip8_initMachine(Chip8_Machine_Chip8, logPath);
+}
+
+// decode function of every opcode class, indexed by the top nibble of the opcode
+static const chip8DecodeFn_t chip8_decoders[CHIP8_DISPATCH_SIZE] = {
+        &chip8_decode0x0000, &chip8_decode0x1000, &chip8_decode0x2000, &chip8_decode0x3000,
+        &chip8_decode0x4000, &chip8_decode0x5000, &chip8_decode0x6000, &chip8_decode0x7000,
+        &chip8_decode0x8000, &chip8_decode0x9000, &chip8_decode0xA000, &chip8_decode0xB000,
+        &chip8_decode0xC000, &chip8_decode0xD000, &chip8_decode0xE000, &chip8_decode0xF000
+};
+
+chip8State_t* chip8_initMachine(enum chip8_machine machine, const char* logPath) {
     chip8State_t* state = calloc(sizeof(chip8State_t), 1);
 
-    // clear registers
+    state->machine = machine;
+    state->memSize = machine == Chip8_Machine_XoChip ? CHIP8_XO_MEM_SIZE : CHIP8_MEM_SIZE;
+    state->memMask = state->memSize - 1;
     state->V = calloc(CHIP8_REGISTERS_SIZE, sizeof(uint8_t));
+    state->stack = calloc(CHIP8_STACK_SIZE, sizeof(uint16_t));
+    state->memory = calloc(state->memSize + CHIP8_MEMORY_GUARD, sizeof(uint8_t));
+    state->display = calloc(CHIP8_DISPLAY_PLANES * CHIP8_HIRES_HEIGHT * CHIP8_DISPLAY_WORDS, sizeof(uint64_t));
+    state->keys = calloc(CHIP8_KEYS_SIZE, sizeof(uint8_t));
+    state->log = logPath != NULL ? fopen(logPath, "w") : NULL;
+    state->profiler = NULL;
+    state->shared = NULL;
+    state->lateLatch = false;
+    state->latency = NULL;
+    state->scaler = NULL;
+    state->pacing = NULL;
+    state->vipTiming = false;
+    for (int i = 0; i < CHIP8_DISPATCH_SIZE; ++i) {
+        state->dispatch[i] = chip8_decoders[i];
+    }
+    state->debugger = NULL;
+    state->aot = NULL;
+    state->strictMemory = false;
+    chip8_seedRandom(state, CHIP8_RANDOM_SEED);
+    chip8_reset(state);
+
+    return state;
+}
+
+void chip8_reset(chip8State_t* state) {
+    // clear registers
+    memset(state->V, 0, CHIP8_REGISTERS_SIZE);
     // reset index register
     state->I = 0;
     // reset stack pointer
     state->SP = 0;
     // reset stack
-    state->stack = calloc(CHIP8_STACK_SIZE, sizeof(uint16_t));
+    memset(state->stack, 0, CHIP8_STACK_SIZE * sizeof(uint16_t));
     // program counter starts at 0x200
     state->PC = CHIP8_PC_START;
     // reset timers
     state->delay = 0;
     state->sound = 0;
     // clear memory
-    state->memory = calloc(CHIP8_MEM_SIZE, sizeof(uint8_t));
+    memset(state->memory, 0, state->memSize);
     for (int i = 0; i < CHIP8_FONTSET_SIZE; ++i) {
         state->memory[i] = chip8_fontset[i];
     }
-    // clear display
-    state->gfx = calloc(CHIP8_GRAPHICS_SIZE, sizeof(uint8_t));
+    for (int i = 0; i < CHIP8_BIG_FONTSET_SIZE; ++i) {
+        state->memory[CHIP8_BIG_FONTSET_START + i] = chip8_bigFontset[i];
+    }
+    memcpy(&state->memory[state->memSize], state->memory, CHIP8_MEMORY_GUARD);
+    memset(state->faults, 0, sizeof(state->faults));
+    // clear display, every machine starts in low resolution with only the first plane selected
+    memset(state->display, 0, CHIP8_DISPLAY_PLANES * CHIP8_HIRES_HEIGHT * CHIP8_DISPLAY_WORDS * sizeof(uint64_t));
+    state->width = CHIP8_GRAPHICS_WIDTH;
+    state->height = CHIP8_GRAPHICS_HEIGHT;
+    state->planeMask = 1;
+    state->pitch = CHIP8_PITCH_DEFAULT;
+    memset(state->pattern, 0, CHIP8_PATTERN_SIZE);
+    state->patternLoaded = false;
+    memset(state->flags, 0, CHIP8_FLAGS_SIZE);
 
-    state->keys = calloc(CHIP8_KEYS_SIZE, sizeof(uint8_t));
+    memset(state->keys, 0, CHIP8_KEYS_SIZE);
     state->drawFlag = false;
     state->isGameLoaded = false;
-    state->log = fopen("..\\logs\\log.txt", "w");
+    chip8_aotClose(&state->aot);
     state->cycle = 1;
+    state->waitingForKey = false;
+    state->waitRegister = 0;
+    state->waitKey = CHIP8_NO_KEY;
+    state->instructions = 0;
+    state->frames = 0;
+    state->draws = 0;
+    state->keyQueueCount = 0;
+    state->keyEvents = 0;
+    state->keysApplied = 0;
+    state->drawsAtApply = 0;
+    state->vipCycles = 0;
+}
 
-    return state;
+void chip8_seedRandom(chip8State_t* state, uint32_t seed) {
+    // xorshift never leaves zero
+    state->random = seed != 0 ? seed : CHIP8_RANDOM_SEED;
+}
+
+uint64_t chip8_faultCount(const chip8State_t* state) {
+    uint64_t count = 0;
+    for (int i = 0; i < CHIP8_DISPATCH_SIZE; i++) {
+        count += state->faults[i];
+    }
+    return count;
+}
+
+void chip8_writeFaults(const chip8State_t* state, FILE* out) {
+    for (int i = 0; i < CHIP8_DISPATCH_SIZE; i++) {
+        if (state->faults[i] != 0) {
+            fprintf(out, "%XNNN: %llu accesses wrapped past the end of memory\n", i,
+                    (unsigned long long)state->faults[i]);
+        }
+    }
 }
 
 void chip8_del(chip8State_t** state) {
@@ -78,31 +195,197 @@ void chip8_del(chip8State_t** state) {
         (*state)->stack = NULL;
         free((*state)->memory);
         (*state)->memory = NULL;
-        free((*state)->gfx);
-        (*state)->gfx = NULL;
+        free((*state)->display);
+        (*state)->display = NULL;
         free((*state)->keys);
         (*state)->keys = NULL;
-        fclose((*state)->log);
-        (*state)->log = NULL;
+        if ((*state)->log != NULL) {
+            fclose((*state)->log);
+            (*state)->log = NULL;
+        }
+        chip8_aotClose(&(*state)->aot);
         free(*state);
         *state = NULL;
     }
 }
 
+// Counts an access of length bytes at address that runs past the end of memory against the class of the opcode,
+// without a branch. Only strict mode stops at such an access, the instruction is then invalid.
+static inline bool chip8_checkAccess(chip8State_t* state, uint16_t opcode, uint32_t address, uint32_t length) {
+    uint32_t overrun = (address + length > state->memSize) & (length != 0);
+    state->faults[opcode >> 12u] += overrun;
+    if (overrun & state->strictMemory) {
+        fprintf(stderr, "Opcode 0x%X accesses memory past its end at 0x%X\n", opcode, address);
+        return false;
+    }
+    return true;
+}
+
+// Up to CHIP8_MEMORY_GUARD bytes can be read from the returned pointer, past the end they are the start of memory
+static inline const uint8_t* chip8_memoryAt(const chip8State_t* state, uint32_t address) {
+    return &state->memory[address & state->memMask];
+}
+
+// Writes a byte, the start of memory is written to the guard as well so it keeps mirroring it. Any other address
+// is its own mirror, which keeps the write free of branches.
+static inline void chip8_writeByte(chip8State_t* state, uint32_t address, uint8_t value) {
+    uint32_t at = address & state->memMask;
+    uint32_t mirror = at + (state->memSize & -(uint32_t)(at < CHIP8_MEMORY_GUARD));
+    state->memory[at] = value;
+    state->memory[mirror] = value;
+}
+
+// the artifact describes the rom as loaded, once the program writes over code it predecoded it no longer applies
+static void chip8_markWritten(chip8State_t* state, uint16_t address, uint16_t length) {
+    if (state->aot == NULL) {
+        return;
+    }
+    for (uint16_t i = 0; i < length; i++) {
+        const chip8AotInstruction_t* entry = chip8_aotAt(state->aot, (uint16_t)(address + i));
+        if (entry != NULL && (entry->flags & (CHIP8_AOT_CODE | CHIP8_AOT_CODE_TAIL)) != 0) {
+            chip8_aotClose(&state->aot);
+            return;
+        }
+    }
+}
+
+static void chip8_markDrawn(chip8State_t* state) {
+    state->drawFlag = true;
+    state->draws++;
+}
+
+static void chip8_clearPlanes(chip8State_t* state, uint8_t planeMask) {
+    for (int plane = 0; plane < CHIP8_DISPLAY_PLANES; plane++) {
+        if ((planeMask & (1u << plane)) != 0) {
+            memset(chip8_displayRow(state, plane, 0), 0, CHIP8_HIRES_HEIGHT * CHIP8_DISPLAY_WORDS * sizeof(uint64_t));
+        }
+    }
+}
+
+// Moves whole rows of the selected planes, down for positive rows and up for negative ones
+static void chip8_scrollVertical(chip8State_t* state, int rows) {
+    int distance = rows < 0 ? -rows : rows;
+    if (distance > state->height) {
+        distance = state->height;
+    }
+    size_t rowSize = CHIP8_DISPLAY_WORDS * sizeof(uint64_t);
+    size_t kept = (size_t)(state->height - distance) * rowSize;
+    for (int plane = 0; plane < CHIP8_DISPLAY_PLANES; plane++) {
+        if ((state->planeMask & (1u << plane)) == 0) {
+            continue;
+        }
+        if (rows > 0) {
+            memmove(chip8_displayRow(state, plane, distance), chip8_displayRow(state, plane, 0), kept);
+            memset(chip8_displayRow(state, plane, 0), 0, distance * rowSize);
+        } else {
+            memmove(chip8_displayRow(state, plane, 0), chip8_displayRow(state, plane, distance), kept);
+            memset(chip8_displayRow(state, plane, state->height - distance), 0, distance * rowSize);
+        }
+    }
+}
+
+// Shifts every row of the selected planes by less than 64 pixels, right for positive pixels and left for negative ones
+static void chip8_scrollHorizontal(chip8State_t* state, int pixels) {
+    unsigned int distance = pixels < 0 ? -pixels : pixels;
+    for (int plane = 0; plane < CHIP8_DISPLAY_PLANES; plane++) {
+        if ((state->planeMask & (1u << plane)) == 0) {
+            continue;
+        }
+        for (int y = 0; y < state->height; y++) {
+            uint64_t* row = chip8_displayRow(state, plane, y);
+            if (pixels > 0) {
+                row[1] = (row[1] >> distance) | (row[0] << (64u - distance));
+                row[0] >>= distance;
+            } else {
+                row[0] = (row[0] << distance) | (row[1] >> (64u - distance));
+                row[1] <<= distance;
+            }
+            if (state->width <= 64) {
+                // pixels pushed off the right edge of the low resolution display are gone
+                row[1] = 0;
+            }
+        }
+    }
+}
+
+static void chip8_setResolution(chip8State_t* state, bool hires) {
+    state->width = hires ? CHIP8_HIRES_WIDTH : CHIP8_GRAPHICS_WIDTH;
+    state->height = hires ? CHIP8_HIRES_HEIGHT : CHIP8_GRAPHICS_HEIGHT;
+    chip8_clearPlanes(state, (1u << CHIP8_DISPLAY_PLANES) - 1);
+}
+
+// Skips the instruction after the one at PC, XO-CHIP's F000 NNNN is twice as long as the others
+static void chip8_skipNext(chip8State_t* state) {
+    const uint8_t* next = chip8_memoryAt(state, state->PC + 2u);
+    if (state->machine == Chip8_Machine_XoChip && next[0] == 0xF0 && next[1] == 0x00) {
+        state->PC += 4;
+    } else {
+        state->PC += 2;
+    }
+}
+
 enum chip8_decodeState chip8_decode0x0000(chip8State_t* state, uint16_t opcode) {
+    if (state->machine != Chip8_Machine_Chip8) {
+        if ((opcode & 0xFFF0u) == 0x00C0) {
+            // 00CN: Scrolls the display down by N pixels
+            CHIP8_LOG(state, "00CN: Scrolls the display down by N pixels\n");
+            chip8_scrollVertical(state, opcode & 0x000Fu);
+            chip8_markDrawn(state);
+            state->PC += 2;
+            return Chip8_Decode_State_Success;
+        }
+        if ((opcode & 0xFFF0u) == 0x00D0 && state->machine == Chip8_Machine_XoChip) {
+            // 00DN: Scrolls the display up by N pixels
+            CHIP8_LOG(state, "00DN: Scrolls the display up by N pixels\n");
+            chip8_scrollVertical(state, -(int)(opcode & 0x000Fu));
+            chip8_markDrawn(state);
+            state->PC += 2;
+            return Chip8_Decode_State_Success;
+        }
+        switch (opcode) {
+            case 0x00FB:
+                // 00FB: Scrolls the display right by 4 pixels
+                CHIP8_LOG(state, "00FB: Scrolls the display right by 4 pixels\n");
+                chip8_scrollHorizontal(state, CHIP8_SCROLL_PIXELS);
+                chip8_markDrawn(state);
+                state->PC += 2;
+                return Chip8_Decode_State_Success;
+            case 0x00FC:
+                // 00FC: Scrolls the display left by 4 pixels
+                CHIP8_LOG(state, "00FC: Scrolls the display left by 4 pixels\n");
+                chip8_scrollHorizontal(state, -CHIP8_SCROLL_PIXELS);
+                chip8_markDrawn(state);
+                state->PC += 2;
+                return Chip8_Decode_State_Success;
+            case 0x00FD:
+                // 00FD: Exits the interpreter
+                CHIP8_LOG(state, "00FD: Exits the interpreter\n");
+                fprintf(stderr, "Program exited\n");
+                return Chip8_Decode_State_Invalid;
+            case 0x00FE:
+            case 0x00FF:
+                // 00FE: Switches to 64x32 low resolution, 00FF: Switches to 128x64 high resolution
+                // Both clear the display
+                CHIP8_LOG(state, "00FE/00FF: Switches to low or high resolution\n");
+                chip8_setResolution(state, opcode == 0x00FF);
+                chip8_markDrawn(state);
+                state->PC += 2;
+                return Chip8_Decode_State_Success;
+            default:
+                break;
+        }
+    }
     switch(opcode & 0x00FFu) {
         case 0x00E0:
             // 00E0: clears the screen
-            fprintf(state->log, "00E0: clears the screen\n");
-            for (int i = 0; i < CHIP8_GRAPHICS_SIZE; i++) {
-                state->gfx[i] = 0;
-            }
-            state->drawFlag = true;
+            CHIP8_LOG(state, "00E0: clears the screen\n");
+            chip8_clearPlanes(state, state->planeMask);
+            chip8_markDrawn(state);
             state->PC += 2;
             break;
         case 0x00EE:
             // 00EE: Returns from a subroutine
-            fprintf(state->log, "00EE: Returns from a subroutine\n");
+            CHIP8_LOG(state, "00EE: Returns from a subroutine\n");
             if (state->SP == 0) {
                 fprintf(stderr, "Stack is empty!\n");
                 return Chip8_Decode_State_Invalid;
@@ -113,7 +396,7 @@ enum chip8_decodeState chip8_decode0x0000(chip8State_t* state, uint16_t opcode)
             break;
         default: {
             // 0NNN: Calls machine code routine at address NNN. Not necessary for most ROMs.
-            fprintf(state->log, "0NNN: Calls machine code routine at address NNN. Not necessary for most ROMs.\n");
+            CHIP8_LOG(state, "0NNN: Calls machine code routine at address NNN. Not necessary for most ROMs.\n");
             state->PC = opcode & 0x0FFFu;
             break;
         }
@@ -123,14 +406,14 @@ enum chip8_decodeState chip8_decode0x0000(chip8State_t* state, uint16_t opcode)
 
 enum chip8_decodeState chip8_decode0x1000(chip8State_t* state, uint16_t opcode) {
     // 1NNN: Jumps to address NNN
-    fprintf(state->log, "1NNN: Jumps to address NNN\n");
+    CHIP8_LOG(state, "1NNN: Jumps to address NNN\n");
     state->PC = opcode & 0xFFFu;
     return Chip8_Decode_State_Success;
 }
 
 enum chip8_decodeState chip8_decode0x2000(chip8State_t* state, uint16_t opcode) {
     // 2NNN: Calls subroutine at NNN
-    fprintf(state->log, "2NNN: Calls subroutine at NNN\n");
+    CHIP8_LOG(state, "2NNN: Calls subroutine at NNN\n");
     if (state->SP == CHIP8_STACK_SIZE) {
         fprintf(stderr, "Stack is full!\n");
         return Chip8_Decode_State_Invalid;
@@ -144,11 +427,11 @@ enum chip8_decodeState chip8_decode0x2000(chip8State_t* state, uint16_t opcode)
 
 enum chip8_decodeState chip8_decode0x3000(chip8State_t* state, uint16_t opcode) {
     // 3XNN: Skips the next instruction if VX equals NN
-    fprintf(state->log, "3XNN: Skips the next instruction if VX equals NN\n");
+    CHIP8_LOG(state, "3XNN: Skips the next instruction if VX equals NN\n");
     uint8_t X = (opcode & 0x0F00u) >> 8u;
     uint8_t NN = opcode & 0x00FFu;
     if (state->V[X] == NN) {
-        state->PC += 2;
+        chip8_skipNext(state);
     }
     state->PC += 2;
     return Chip8_Decode_State_Success;
@@ -156,27 +439,53 @@ enum chip8_decodeState chip8_decode0x3000(chip8State_t* state, uint16_t opcode)
 
 enum chip8_decodeState chip8_decode0x4000(chip8State_t* state, uint16_t opcode) {
     // 4XNN: Skips the next instruction if VX doesn't equal NN
-    fprintf(state->log, "4XNN: Skips the next instruction if VX doesn't equal NN\n");
+    CHIP8_LOG(state, "4XNN: Skips the next instruction if VX doesn't equal NN\n");
     uint8_t X = (opcode & 0x0F00u) >> 8u;
     uint8_t NN = opcode & 0x00FFu;
     if (state->V[X] != NN) {
-        state->PC += 2;
+        chip8_skipNext(state);
     }
     state->PC += 2;
     return Chip8_Decode_State_Success;
 }
 
 enum chip8_decodeState chip8_decode0x5000(chip8State_t* state, uint16_t opcode) {
+    uint8_t low = opcode & 0x000Fu;
+    if (state->machine == Chip8_Machine_XoChip && (low == 0x2 || low == 0x3)) {
+        // 5XY2: Stores VX to VY in memory starting at address I, 5XY3: Loads VX to VY from memory starting at I
+        // The registers are visited from X to Y, backwards if Y is smaller than X. I is left unmodified
+        CHIP8_LOG(state, "5XY2/5XY3: Stores or loads VX to VY in memory starting at address I\n");
+        uint8_t X = (opcode & 0x0F00u) >> 8u;
+        uint8_t Y = (opcode & 0x00F0u) >> 4u;
+        int step = X <= Y ? 1 : -1;
+        int count = (X <= Y ? Y - X : X - Y) + 1;
+        if (!chip8_checkAccess(state, opcode, state->I, count)) {
+            return Chip8_Decode_State_Invalid;
+        }
+        const uint8_t* bytes = chip8_memoryAt(state, state->I);
+        for (int i = 0; i < count; i++) {
+            if (low == 0x2) {
+                chip8_writeByte(state, state->I + i, state->V[X + i * step]);
+            } else {
+                state->V[X + i * step] = bytes[i];
+            }
+        }
+        if (low == 0x2) {
+            chip8_markWritten(state, state->I & state->memMask, count);
+        }
+        state->PC += 2;
+        return Chip8_Decode_State_Success;
+    }
     // 5XY0: Skips the next instruction if VX equals VY
-    fprintf(state->log, "5XY0: Skips the next instruction if VX equals VY\n");
-    if ((opcode & 0x000Fu) > 0) {
+    CHIP8_LOG(state, "5XY0: Skips the next instruction if VX equals VY\n");
+    if (low > 0) {
         fprintf(stderr, "Unknown opcode: 0x%X\n", opcode);
         return Chip8_Decode_State_Invalid;
     } else {
         uint8_t X = (opcode & 0x0F00u) >> 8u;
         uint8_t Y = (opcode & 0x00F0u) >> 4u;
         if (state->V[X] == state->V[Y]) {
-            state->PC += 2;
+            chip8_skipNext(state);
         }
     }
     state->PC += 2;
@@ -185,7 +494,7 @@ enum chip8_decodeState chip8_decode0x5000(chip8State_t* state, uint16_t opcode)
 
 enum chip8_decodeState chip8_decode0x6000(chip8State_t* state, uint16_t opcode) {
     // 6XNN: Sets VX to NN
-    fprintf(state->log, "6XNN: Sets VX to NN\n");
+    CHIP8_LOG(state, "6XNN: Sets VX to NN\n");
     uint8_t X = (opcode & 0x0F00u) >> 8u;
     uint8_t NN = opcode & 0x00FFu;
     state->V[X] = NN;
@@ -195,7 +504,7 @@ enum chip8_decodeState chip8_decode0x6000(chip8State_t* state, uint16_t opcode)
 
 enum chip8_decodeState chip8_decode0x7000(chip8State_t* state, uint16_t opcode) {
     // 7XNN: Adds NN to VX. (Carry flag is not changed)
-    fprintf(state->log, "7XNN: Adds NN to VX. (Carry flag is not changed)\n");
+    CHIP8_LOG(state, "7XNN: Adds NN to VX. (Carry flag is not changed)\n");
     uint8_t X = (opcode & 0x0F00u) >> 8u;
     uint8_t NN = opcode & 0x00FFu;
     state->V[X] += NN;
@@ -209,27 +518,27 @@ enum chip8_decodeState chip8_decode0x8000(chip8State_t* state, uint16_t opcode)
     switch (opcode & 0x000Fu) {
         case 0x0000:
             // 8XY0: Sets VX to the value of VY
-            fprintf(state->log, "8XY0: Sets VX to the value of VY\n");
+            CHIP8_LOG(state, "8XY0: Sets VX to the value of VY\n");
             state->V[X] = state->V[Y];
             break;
         case 0x0001:
             // 8XY1: Sets VX to VX or VY (Bitwise OR operation)
-            fprintf(state->log, "8XY1: Sets VX to VX or VY (Bitwise OR operation)\n");
+            CHIP8_LOG(state, "8XY1: Sets VX to VX or VY (Bitwise OR operation)\n");
             state->V[X] = state->V[X] | state->V[Y];
             break;
         case 0x0002:
             // 8XY2: Sets VX to VX and VY (Bitwise AND operation)
-            fprintf(state->log, "8XY2: Sets VX to VX and VY (Bitwise AND operation)\n");
+            CHIP8_LOG(state, "8XY2: Sets VX to VX and VY (Bitwise AND operation)\n");
             state->V[X] = state->V[X] & state->V[Y];
             break;
         case 0x0003:
             // 8XY3: Sets VX to VX xor VY
-            fprintf(state->log, "8XY3: Sets VX to VX xor VY\n");
+            CHIP8_LOG(state, "8XY3: Sets VX to VX xor VY\n");
             state->V[X] = state->V[X] ^ state->V[Y];
             break;
         case 0x0004:
             // 8XY4: Adds VY to VX. VF is set to 1 when there's a carry, and to 0 when there isn't
-            fprintf(state->log, "8XY4: Adds VY to VX. VF is set to 1 when there's a carry, and to 0 when there isn't\n");
+            CHIP8_LOG(state, "8XY4: Adds VY to VX. VF is set to 1 when there's a carry, and to 0 when there isn't\n");
             if (state->V[Y] > (0xFF - state->V[X])) {
                 state->V[CHIP8_REGISTER_CARRY] = 1; // carry
             } else {
@@ -239,7 +548,7 @@ enum chip8_decodeState chip8_decode0x8000(chip8State_t* state, uint16_t opcode)
             break;
         case 0x0005:
             // 8XY5: VY is subtracted from VX. VF is set to 0 when there's a borrow, and 1 when there isn't
-            fprintf(state->log, "8XY5: VY is subtracted from VX. VF is set to 0 when there's a borrow, and 1 when there isn't\n");
+            CHIP8_LOG(state, "8XY5: VY is subtracted from VX. VF is set to 0 when there's a borrow, and 1 when there isn't\n");
             if (state->V[X] < state->V[Y]) {
                 state->V[CHIP8_REGISTER_CARRY] = 0; // borrow
             } else {
@@ -249,12 +558,12 @@ enum chip8_decodeState chip8_decode0x8000(chip8State_t* state, uint16_t opcode)
             break;
         case 0x0006:
             // 8XY6: Stores the least significant bit of VX in VF and then shifts VX to the right by 1
-            fprintf(state->log, "Stores the least significant bit of VX in VF and then shifts VX to the right by 1\n");
+            CHIP8_LOG(state, "Stores the least significant bit of VX in VF and then shifts VX to the right by 1\n");
             state->V[X] >>= 1u;
             break;
         case 0x0007:
             // 8XY7: Sets VX to VY minus VX. VF is set to 0 when there's a borrow, and 1 when there isn't
-            fprintf(state->log, "8XY7: Sets VX to VY minus VX. VF is set to 0 when there's a borrow, and 1 when there isn't\n");
+            CHIP8_LOG(state, "8XY7: Sets VX to VY minus VX. VF is set to 0 when there's a borrow, and 1 when there isn't\n");
             if (state->V[Y] < state->V[X]) {
                 state->V[CHIP8_REGISTER_CARRY] = 0;
             } else {
@@ -264,7 +573,7 @@ enum chip8_decodeState chip8_decode0x8000(chip8State_t* state, uint16_t opcode)
             break;
         case 0x000E:
             // 8XYE: Stores the most significant bit of VX in VF and shifts VX to the left by 1.
-            fprintf(state->log, "8XYE: Stores the most significant bit of VX in VF and shifts VX to the left by 1.\n");
+            CHIP8_LOG(state, "8XYE: Stores the most significant bit of VX in VF and shifts VX to the left by 1.\n");
             state->V[X] <<= 1u;
             break;
         default:
@@ -277,7 +586,7 @@ enum chip8_decodeState chip8_decode0x8000(chip8State_t* state, uint16_t opcode)
 
 enum chip8_decodeState chip8_decode0x9000(chip8State_t* state, uint16_t opcode) {
     // 9XY0: Skips the next instruction if VX doesn't equal VY
-    fprintf(state->log, "9XY0: Skips the next instruction if VX doesn't equal VY\n");
+    CHIP8_LOG(state, "9XY0: Skips the next instruction if VX doesn't equal VY\n");
     if (opcode & 0x000Fu) {
         fprintf(stderr, "Unknown opcode: 0x%X\n", opcode);
         return Chip8_Decode_State_Invalid;
@@ -285,7 +594,7 @@ enum chip8_decodeState chip8_decode0x9000(chip8State_t* state, uint16_t opcode)
         uint8_t X = (opcode & 0x0F00u) >> 8u;
         uint8_t Y = (opcode & 0x00F0u) >> 4u;
         if (state->V[X] != state->V[Y]) {
-            state->PC += 2;
+            chip8_skipNext(state);
         }
     }
     state->PC += 2;
@@ -294,7 +603,7 @@ enum chip8_decodeState chip8_decode0x9000(chip8State_t* state, uint16_t opcode)
 
 enum chip8_decodeState chip8_decode0xA000(chip8State_t* state, uint16_t opcode) {
     // ANNN: Sets I to the address NNN
-    fprintf(state->log, "ANNN: Sets I to the address NNN\n");
+    CHIP8_LOG(state, "ANNN: Sets I to the address NNN\n");
     state->I = opcode & 0x0FFFu;
     state->PC += 2;
     return Chip8_Decode_State_Success;
@@ -302,17 +611,23 @@ enum chip8_decodeState chip8_decode0xA000(chip8State_t* state, uint16_t opcode)
 
 enum chip8_decodeState chip8_decode0xB000(chip8State_t* state, uint16_t opcode) {
     // BNNN: jumps to the address NNN plus V0
-    fprintf(state->log, "BNNN: jumps to the address NNN plus V0\n");
+    CHIP8_LOG(state, "BNNN: jumps to the address NNN plus V0\n");
     state->PC = (opcode & 0x0FFFu) + state->V[0];
     return Chip8_Decode_State_Success;
 }
 
 enum chip8_decodeState chip8_decode0xC000(chip8State_t* state, uint16_t opcode) {
     // CXNN: Sets VX to the result of a bitwise AND operation on a random number (Typically: 0 to 255) and NN
-    fprintf(state->log, "CXNN: Sets VX to the result of a bitwise AND operation on a random number (Typically: 0 to 255) and NN\n");
+    CHIP8_LOG(state, "CXNN: Sets VX to the result of a bitwise AND operation on a random number (Typically: 0 to 255) and NN\n");
     uint8_t X = (opcode & 0x0F00u) >> 8u;
     uint8_t NN = opcode & 0x00FFu;
-    state->V[X] = rand() & NN;
+    // xorshift32, every machine has its own sequence so instances on other threads do not change it
+    uint32_t random = state->random;
+    random ^= random << 13u;
+    random ^= random >> 17u;
+    random ^= random << 5u;
+    state->random = random;
+    state->V[X] = (uint8_t)(random >> 24u) & NN;
     state->PC += 2;
     return Chip8_Decode_State_Success;
 }
@@ -322,31 +637,65 @@ enum chip8_decodeState chip8_decode0xD000(chip8State_t* state, uint16_t opcode)
     // Each row of 8 pixels is read as bit-coded starting from memory location I
     // I value doesn't change during execution of this instruction
     // VF is set to 1 if any screen pixels are flipped from set to unset when the sprite is drawn, and to 0 if not
-    fprintf(state->log, "DXYN: Draws a sprite at coordinate (VX, VY) that has a width of 8 pixels and a height of N pixels.\n");
+    // The coordinates wrap around the display but the sprite itself is clipped at its edges.
+    // DXY0 draws a 16x16 sprite of two bytes per row on SUPER-CHIP and XO-CHIP. With both XO-CHIP planes selected
+    // the sprite for the second plane follows the one for the first.
+    CHIP8_LOG(state, "DXYN: Draws a sprite at coordinate (VX, VY) that has a width of 8 pixels and a height of N pixels.\n");
     uint8_t X = (opcode & 0x0F00u) >> 8u;
     uint8_t Y = (opcode & 0x00F0u) >> 4u;
-    uint8_t height = opcode & 0x000Fu;
+    int height = opcode & 0x000Fu;
+    int width = CHIP8_SPRITE_WIDTH;
+    if (height == 0 && state->machine != Chip8_Machine_Chip8) {
+        width = CHIP8_BIG_SPRITE_WIDTH;
+        height = CHIP8_BIG_SPRITE_WIDTH;
+    }
+    // display sizes are powers of two
+    unsigned int x = state->V[X] & (state->width - 1u);
+    unsigned int top = state->V[Y] & (state->height - 1u);
+    // every selected plane reads a sprite, one after the other, never more than the guard holds
+    int planes = (state->planeMask & 1u) + ((state->planeMask >> 1u) & 1u);
+    if (!chip8_checkAccess(state, opcode, state->I, planes * height * (width / 8))) {
+        return Chip8_Decode_State_Invalid;
+    }
+    const uint8_t* bytes = chip8_memoryAt(state, state->I);
 
     state->V[CHIP8_REGISTER_CARRY] = 0;
-    uint8_t pixel;
-    uint16_t position;
-    // go row by row
-    for (int yline = 0; yline < height; yline++) {
-        pixel = state->memory[state->I + yline];
-        // width of sprites is fixed at 8
-        for (unsigned int xline = 0; xline < CHIP8_SPRITE_WIDTH; xline++) {
+    for (int plane = 0; plane < CHIP8_DISPLAY_PLANES; plane++) {
+        if ((state->planeMask & (1u << plane)) == 0) {
+            continue;
+        }
+        // go row by row, a whole sprite row is placed into the two words of a display row at once
+        for (int yline = 0; yline < height; yline++) {
+            uint64_t bits = *bytes++;
+            if (width == CHIP8_BIG_SPRITE_WIDTH) {
+                bits = (bits << 8u) | *bytes++;
+            }
+            if (top + yline >= state->height) {
+                continue;
+            }
+            uint64_t aligned = bits << (64u - width);
+            uint64_t sprite[CHIP8_DISPLAY_WORDS];
+            if (x < 64) {
+                sprite[0] = aligned >> x;
+                sprite[1] = x == 0 ? 0 : aligned << (64u - x);
+            } else {
+                sprite[0] = 0;
+                sprite[1] = aligned >> (x - 64u);
+            }
+            if (state->width <= 64) {
+                sprite[1] = 0;
+            }
+            uint64_t* row = chip8_displayRow(state, plane, top + yline);
             // check for collision
             // if the pixel is set and if the graphics position is set then there's a collision
-            if ((pixel & (0x80u >> xline)) != 0) {
-                position = state->V[X] + xline + ((state->V[Y] + yline) * CHIP8_GRAPHICS_WIDTH);
-                if (state->gfx[position] == 1) {
-                    state->V[CHIP8_REGISTER_CARRY] = 1;
-                }
-                state->gfx[position] ^= 1u;
+            if (((row[0] & sprite[0]) | (row[1] & sprite[1])) != 0) {
+                state->V[CHIP8_REGISTER_CARRY] = 1;
             }
+            row[0] ^= sprite[0];
+            row[1] ^= sprite[1];
         }
     }
-    state->drawFlag = true;
+    chip8_markDrawn(state);
     state->PC += 2;
     return Chip8_Decode_State_Success;
 }
@@ -356,17 +705,17 @@ enum chip8_decodeState chip8_decode0xE000(chip8State_t* state, uint16_t opcode)
     switch (opcode & 0x00FFu) {
         case 0x009E: {
             // EX9E: Skips the next instruction if the key stored in VX is pressed
-            fprintf(state->log, "EX9E: Skips the next instruction if the key stored in VX is pressed\n");
+            CHIP8_LOG(state, "EX9E: Skips the next instruction if the key stored in VX is pressed\n");
             if (state->V[X] >= 0 && state->V[X] < CHIP8_KEYS_SIZE && state->keys[state->V[X]] != 0) {
-                state->PC += 2;
+                chip8_skipNext(state);
             }
             break;
         }
         case 0x00A1: {
             // EXA1: Skips the next instruction if the key stored in VX isn't pressed
-            fprintf(state->log, "EXA1: Skips the next instruction if the key stored in VX isn't pressed\n");
+            CHIP8_LOG(state, "EXA1: Skips the next instruction if the key stored in VX isn't pressed\n");
             if (state->V[X] >= 0 && state->V[X] < CHIP8_KEYS_SIZE && state->keys[state->V[X]] == 0) {
-                state->PC += 2;
+                chip8_skipNext(state);
             }
             break;
         }
@@ -378,55 +727,98 @@ enum chip8_decodeState chip8_decode0xE000(chip8State_t* state, uint16_t opcode)
     return Chip8_Decode_State_Success;
 }
 
+static enum chip8_decodeState chip8_unknownOpcode(uint16_t opcode) {
+    fprintf(stderr, "Unknown opcode: 0x%X\n", opcode);
+    return Chip8_Decode_State_Invalid;
+}
+
 enum chip8_decodeState chip8_decode0xF000(chip8State_t* state, uint16_t opcode) {
     uint8_t X = (opcode & 0x0F00u) >> 8u;
+    bool superChip = state->machine != Chip8_Machine_Chip8;
+    bool xoChip = state->machine == Chip8_Machine_XoChip;
     switch(opcode & 0x00FFu) {
+        case 0x0000: {
+            // F000 NNNN: Sets I to the 16 bit address NNNN in the following two bytes
+            if (!xoChip || X != 0) {
+                return chip8_unknownOpcode(opcode);
+            }
+            CHIP8_LOG(state, "F000 NNNN: Sets I to the 16 bit address NNNN in the following two bytes\n");
+            if (!chip8_checkAccess(state, opcode, state->PC + 2u, 2)) {
+                return Chip8_Decode_State_Invalid;
+            }
+            const uint8_t* address = chip8_memoryAt(state, state->PC + 2u);
+            state->I = (uint16_t)(address[0] << 8u | address[1]);
+            state->PC += 4;
+            break;
+        }
+        case 0x0001:
+            // FN01: Selects the planes drawing, clearing and scrolling apply to, bit 0 for the first plane
+            if (!xoChip) {
+                return chip8_unknownOpcode(opcode);
+            }
+            CHIP8_LOG(state, "FN01: Selects the planes drawing, clearing and scrolling apply to\n");
+            state->planeMask = X & ((1u << CHIP8_DISPLAY_PLANES) - 1);
+            state->PC += 2;
+            break;
+        case 0x0002:
+            // F002: Loads the 16 bytes at I into the audio pattern buffer
+            if (!xoChip || X != 0) {
+                return chip8_unknownOpcode(opcode);
+            }
+            CHIP8_LOG(state, "F002: Loads the 16 bytes at I into the audio pattern buffer\n");
+            if (!chip8_checkAccess(state, opcode, state->I, CHIP8_PATTERN_SIZE)) {
+                return Chip8_Decode_State_Invalid;
+            }
+            memcpy(state->pattern, chip8_memoryAt(state, state->I), CHIP8_PATTERN_SIZE);
+            state->patternLoaded = true;
+            state->PC += 2;
+            break;
         case 0x0007:
             // FX07: Sets VX to the value of the delay timer
-            fprintf(state->log, "FX07: Sets VX to the value of the delay timer\n");
+            CHIP8_LOG(state, "FX07: Sets VX to the value of the delay timer\n");
             state->V[X] = state->delay;
             state->PC += 2;
             break;
         case 0x000A: {
             // FX0A: A key press is awaited, and then stored in VX.
-            // (Blocking operation. All instruction halted until next key press).
-            fprintf(state->log, "FX0A: A key press is awaited, and then stored in VX.\n");
-            bool keyPressed = false;
+            // (Blocking operation. All instruction halted until the key is released, as on the original
+            // interpreter. The timers keep running).
+            CHIP8_LOG(state, "FX0A: A key press is awaited, and then stored in VX.\n");
+            state->waitingForKey = true;
+            state->waitRegister = X;
+            state->waitKey = CHIP8_NO_KEY;
+            // a key that is already held counts as pressed
             for (int i = 0; i < CHIP8_KEYS_SIZE; i++) {
                 if (state->keys[i] != 0) {
-                    state->V[X] = i;
-                    keyPressed = true;
+                    state->waitKey = i;
+                    break;
                 }
             }
-            // TODO So we don't increment the timers either?
-            if (!keyPressed) {
-                return Chip8_Decode_State_Blocking;
-            }
-            state->PC += 2;
-            break;
+            // PC moves on once chip8_setKey sees the key released
+            return Chip8_Decode_State_Blocking;
         }
         case 0x0015:
             // FX15: Sets the delay timer to VX
-            fprintf(state->log, "FX15: Sets the delay timer to VX\n");
+            CHIP8_LOG(state, "FX15: Sets the delay timer to VX\n");
             state->delay = state->V[X];
             state->PC += 2;
             break;
         case 0x0018:
             // FX18: Sets the sound timer to VX
-            fprintf(state->log, "FX18: Sets the sound timer to VX\n");
+            CHIP8_LOG(state, "FX18: Sets the sound timer to VX\n");
             state->sound = state->V[X];
             state->PC += 2;
             break;
         case 0x001E:
             // FX1E: Adds VX to I. VF is not affected
-            fprintf(state->log, "FX1E: Adds VX to I. VF is not affected\n");
+            CHIP8_LOG(state, "FX1E: Adds VX to I. VF is not affected\n");
             state->I += state->V[X];
             state->PC += 2;
             break;
         case 0x0029: {
             // FX29: Sets I to the location of the sprite for the character in VX.
             // Characters 0-F are represented by the font
-            fprintf(state->log, "FX29: Sets I to the location of the sprite for the character in VX.\n");
+            CHIP8_LOG(state, "FX29: Sets I to the location of the sprite for the character in VX.\n");
             uint16_t location = state->V[X] * CHIP8_FONTSET_WIDTH;
             if (location > CHIP8_FONTSET_SIZE) {
                 fprintf(stderr, "Accessing font out of bounds: %d\n", location);
@@ -437,25 +829,69 @@ enum chip8_decodeState chip8_decode0xF000(chip8State_t* state, uint16_t opcode)
             state->PC += 2;
             break;
         }
+        case 0x0030:
+            // FX30: Sets I to the location of the big 8x10 sprite for the character in VX
+            if (!superChip) {
+                return chip8_unknownOpcode(opcode);
+            }
+            CHIP8_LOG(state, "FX30: Sets I to the location of the big sprite for the character in VX\n");
+            state->I = CHIP8_BIG_FONTSET_START + (state->V[X] & 0x0Fu) * CHIP8_BIG_FONTSET_WIDTH;
+            state->PC += 2;
+            break;
+        case 0x003A:
+            // FX3A: Sets the pitch the audio pattern is played back at to VX
+            if (!xoChip) {
+                return chip8_unknownOpcode(opcode);
+            }
+            CHIP8_LOG(state, "FX3A: Sets the pitch the audio pattern is played back at to VX\n");
+            state->pitch = state->V[X];
+            state->PC += 2;
+            break;
+        case 0x0075:
+            // FX75: Stores V0 to VX in the flag registers
+            if (!superChip) {
+                return chip8_unknownOpcode(opcode);
+            }
+            CHIP8_LOG(state, "FX75: Stores V0 to VX in the flag registers\n");
+            memcpy(state->flags, state->V, X + 1u);
+            state->PC += 2;
+            break;
+        case 0x0085:
+            // FX85: Fills V0 to VX from the flag registers
+            if (!superChip) {
+                return chip8_unknownOpcode(opcode);
+            }
+            CHIP8_LOG(state, "FX85: Fills V0 to VX from the flag registers\n");
+            memcpy(state->V, state->flags, X + 1u);
+            state->PC += 2;
+            break;
         case 0x0033:
             // FX33: Stores the binary-coded decimal representation of VX, with the most significant of three
             // digits at the address in I, the middle digit at I plus 1, and the least significant digit at
             // I plus 2.
             // In other words, take the decimal representation of VX, place the hundreds digit in memory at
             // location in I, the tens digit at location I+1, and the ones digit at location I+2.
-            fprintf(state->log, "FX33: Stores the binary-coded decimal representation of VX\n");
-            state->memory[state->I] = state->V[X] / 100;            // 123 => 1
-            state->memory[state->I + 1] = (state->V[X] / 10) % 10;  // 123 => 12 => 2
-            state->memory[state->I + 2] = (state->V[X] % 100) % 10; // 123 => 23 => 3
+            CHIP8_LOG(state, "FX33: Stores the binary-coded decimal representation of VX\n");
+            if (!chip8_checkAccess(state, opcode, state->I, 3)) {
+                return Chip8_Decode_State_Invalid;
+            }
+            chip8_writeByte(state, state->I, state->V[X] / 100);                // 123 => 1
+            chip8_writeByte(state, state->I + 1u, (state->V[X] / 10) % 10);     // 123 => 12 => 2
+            chip8_writeByte(state, state->I + 2u, (state->V[X] % 100) % 10);    // 123 => 23 => 3
+            chip8_markWritten(state, state->I & state->memMask, 3);
             state->PC += 2;
             break;
         case 0x0055:
             // FX55: Stores V0 to VX (including VX) in memory starting at address I. The offset from I is
             // increased by 1 for each value written, but I itself is left unmodified
-            fprintf(state->log, "FX55: Stores V0 to VX (including VX) in memory starting at address I\n");
+            CHIP8_LOG(state, "FX55: Stores V0 to VX (including VX) in memory starting at address I\n");
+            if (!chip8_checkAccess(state, opcode, state->I, X + 1u)) {
+                return Chip8_Decode_State_Invalid;
+            }
             for (int i = 0; i <= X; i++) {
-                state->memory[state->I + i] = state->V[i];
+                chip8_writeByte(state, state->I + i, state->V[i]);
             }
+            chip8_markWritten(state, state->I & state->memMask, X + 1u);
             // TODO Original interpreter, when the operation is done, I = I + X + 1, do I do this?
             // I += X + 1;
             state->PC += 2;
@@ -463,10 +899,11 @@ enum chip8_decodeState chip8_decode0xF000(chip8State_t* state, uint16_t opcode)
         case 0x0065:
             // FX65: Fills V0 to VX (including VX) with values from memory starting at address I. The offset
             // from I is increased by 1 for each value written, but I itself is left unmodified.
-            fprintf(state->log, "FX65: Fills V0 to VX (including VX) with values from memory starting at address I\n");
-            for (int i = 0; i <= X; i++) {
-                state->V[i] = state->memory[state->I + i];
+            CHIP8_LOG(state, "FX65: Fills V0 to VX (including VX) with values from memory starting at address I\n");
+            if (!chip8_checkAccess(state, opcode, state->I, X + 1u)) {
+                return Chip8_Decode_State_Invalid;
             }
+            memcpy(state->V, chip8_memoryAt(state, state->I), X + 1u);
             // TODO Original interpreter, when the operation is done, I = I + X + 1, do I do this?
             // I += X + 1;
             state->PC += 2;
@@ -478,170 +915,292 @@ enum chip8_decodeState chip8_decode0xF000(chip8State_t* state, uint16_t opcode)
     return Chip8_Decode_State_Success;
 }
 
-bool chip8_emulateCycle(chip8State_t* state, ALLEGRO_SAMPLE *soundEffect) {
-    if (!state->isGameLoaded) {
-        fprintf(stderr, "No game is loaded!\n");
-        return false;
+static void chip8_endFrame(chip8State_t* state) {
+    chip8_updateTimers(state);
+    state->frames++;
+    if (state->shared != NULL) {
+        chip8_sharedPublish(state->shared, state);
     }
-    // Fetch Opcode
-    uint16_t opcode = (state->memory[state->PC] << 8u) | state->memory[state->PC + 1];
+}
 
-    enum chip8_decodeState (*decodedOp)(chip8State_t*, uint16_t) = NULL;
+static void chip8_advanceCycle(chip8State_t* state) {
+    // Update timers
+    if (state->cycle == CHIP8_CYCLES_PER_TIMER_UPDATE) {
+        chip8_endFrame(state);
+        state->cycle = 1;
+    } else {
+        state->cycle++;
+    }
+}
 
-    fprintf(state->log, "%d\t0x%x: ", state->PC, opcode);
-    // Decode Opcode
-    switch(opcode & 0xF000u) {
-        case 0x0000:
-            decodedOp = &chip8_decode0x0000;
-            break;
-        case 0x1000:
-            decodedOp = &chip8_decode0x1000;
-            break;
-        case 0x2000:
-            decodedOp = &chip8_decode0x2000;
-            break;
-        case 0x3000: {
-            decodedOp = &chip8_decode0x3000;
-            break;
-        }
-        case 0x4000: {
-            decodedOp = &chip8_decode0x4000;
-            break;
-        }
-        case 0x5000: {
-            decodedOp = &chip8_decode0x5000;
-            break;
-        }
-        case 0x6000: {
-            decodedOp = &chip8_decode0x6000;
-            break;
-        }
-        case 0x7000: {
-            decodedOp = &chip8_decode0x7000;
-            break;
-        }
-        case 0x8000: {
-            decodedOp = &chip8_decode0x8000;
-            break;
-        }
-        case 0x9000: {
-            decodedOp = &chip8_decode0x9000;
-            break;
-        }
-        case 0xA000:
-            decodedOp = &chip8_decode0xA000;
-            break;
-        case 0xB000:
-            decodedOp = &chip8_decode0xB000;
-            break;
-        case 0xC000: {
-            decodedOp = &chip8_decode0xC000;
-            break;
-        }
-        case 0xD000: {
-            decodedOp = &chip8_decode0xD000;
-            break;
-        }
-        case 0xE000: {
-            decodedOp = &chip8_decode0xE000;
-            break;
-        }
-        case 0xF000: {
-            decodedOp = &chip8_decode0xF000;
-            break;
-        }
-        default:
-            fprintf(stderr, "Unknown opcode: 0x%X\n", opcode);
-            break;
+static uint16_t chip8_fetch(const chip8State_t* state) {
+    const uint8_t* bytes = chip8_memoryAt(state, state->PC);
+    return (uint16_t)(bytes[0] << 8u | bytes[1]);
+}
+
+static enum chip8_decodeState chip8_execute(chip8State_t* state, uint16_t opcode) {
+    CHIP8_LOG(state, "%d\t0x%x: ", state->PC, opcode);
+    // Decode Opcode, the debugger swaps entries of the table for its traps
+    chip8DecodeFn_t decodedOp = state->dispatch[opcode >> 12u];
+#ifdef CHIP8_PROFILE
+    uint16_t profiledPC = state->PC;
+    uint16_t profiledSP = state->SP;
+#endif
+    enum chip8_decodeState decodeState = (*decodedOp)(state, opcode);
+#ifdef CHIP8_PROFILE
+    if (state->profiler != NULL && decodeState == Chip8_Decode_State_Success) {
+        chip8_profilerRecord(state->profiler, profiledPC, opcode, profiledSP, state->SP, state->PC);
     }
+#endif
+    return decodeState;
+}
 
-    if (decodedOp == NULL) {
+bool chip8_emulateCycle(chip8State_t* state) {
+    if (!state->isGameLoaded) {
+        fprintf(stderr, "No game is loaded!\n");
         return false;
     }
-    enum chip8_decodeState decodeState = (*decodedOp)(state, opcode);
+    // late latched keys are applied right before the last instructions of the frame, or as soon as FX0A waits
+    if (state->keyQueueCount > 0 &&
+        (state->waitingForKey || state->cycle == CHIP8_CYCLES_PER_TIMER_UPDATE - CHIP8_LATE_LATCH_CYCLES + 1)) {
+        chip8_latchKeys(state);
+    }
+    // FX0A is waiting for a key to be released, nothing executes but the timers keep running
+    if (state->waitingForKey) {
+        chip8_advanceCycle(state);
+        return true;
+    }
+    // Fetch Opcode, a PC that jumped or ran past the end of memory wraps around
+    uint16_t opcode = chip8_fetch(state);
+    if (!chip8_checkAccess(state, opcode, state->PC, 2)) {
+        return false;
+    }
+    // Decode and execute Opcode
+    enum chip8_decodeState decodeState = chip8_execute(state, opcode);
     // If the decoded state is false, then there was an issue processing the opcode and we should quit
     if (decodeState == Chip8_Decode_State_Invalid) {
         return false;
-    } else if (decodeState == Chip8_Decode_State_Blocking) {
-        // otherwise, if the decoded state is blocking then we should quit early before updating the timers
+    } else if (decodeState == Chip8_Decode_State_Break) {
+        // a debugger trap stopped before the instruction, the cycle did not happen
         return true;
-    } else if (decodeState != Chip8_Decode_State_Success) {
+    } else if (decodeState != Chip8_Decode_State_Success && decodeState != Chip8_Decode_State_Blocking) {
         // otherwise, the decoded state should be success
         // this shouldn't run
         fprintf(stderr, "Invalid Decode State detected: %d\n", decodeState);
         return false;
     }
 
-    // Update timers
-    if (state->cycle == CHIP8_CYCLES_PER_TIMER_UPDATE) {
-        if (state->delay > 0) {
-            state->delay--;
+    state->instructions++;
+    chip8_advanceCycle(state);
+    return true;
+}
+
+// runs up to budget instructions of a fused run from the artifact, returns how many ran or -1 if one was invalid
+static int chip8_runFused(chip8State_t* state, int budget) {
+    // the debugger has to see every instruction and FX0A runs nothing
+    if (state->aot == NULL || state->debugger != NULL || state->waitingForKey || !state->isGameLoaded) {
+        return 0;
+    }
+    const chip8AotInstruction_t* entry = chip8_aotAt(state->aot, state->PC);
+    if (entry == NULL || entry->run == 0) {
+        return 0;
+    }
+    int count = entry->run < budget ? entry->run : budget;
+    if (state->keyQueueCount > 0) {
+        // stop where emulateCycle latches the queued keys
+        int latchCycle = CHIP8_CYCLES_PER_TIMER_UPDATE - CHIP8_LATE_LATCH_CYCLES + 1;
+        int untilLatch = state->cycle <= latchCycle ? latchCycle - state->cycle
+                                                    : CHIP8_CYCLES_PER_TIMER_UPDATE - state->cycle + latchCycle;
+        count = count < untilLatch ? count : untilLatch;
+    }
+    // no member branches, so the run is the next count entries, two bytes apart
+    for (int i = 0; i < count; i++) {
+        if (chip8_execute(state, entry[2 * i].opcode) == Chip8_Decode_State_Invalid) {
+            return -1;
         }
+        state->instructions++;
+        chip8_advanceCycle(state);
+    }
+    return count;
+}
 
-        if (state->sound > 0) {
-            al_play_sample(soundEffect, 1.0f, 0.0f, 1.0f, ALLEGRO_PLAYMODE_ONCE, 0);
-            state->sound--;
+bool chip8_emulateFrame(chip8State_t* state) {
+    int i = 0;
+    while (i < CHIP8_CYCLES_PER_TIMER_UPDATE) {
+        int fused = chip8_runFused(state, CHIP8_CYCLES_PER_TIMER_UPDATE - i);
+        if (fused < 0) {
+            return false;
+        } else if (fused > 0) {
+            i += fused;
+        } else if (!chip8_emulateCycle(state)) {
+            return false;
+        } else {
+            i++;
         }
-        state->cycle = 0;
-    } else {
-        state->cycle++;
     }
     return true;
 }
 
-bool chip8_loadGame(chip8State_t* state, const char* filePath) {
-    FILE *fptr;
-    fptr = fopen(filePath, "rb");
-    if (fptr == NULL) {
-        fprintf(stderr, "Failed to open file: %d\n", errno);
+// Machine cycles the original COSMAC VIP interpreter spends on an instruction that just ran, on top of
+// CHIP8_VIP_FETCH_CYCLES. The figures are approximations of the interpreter's routines.
+static int32_t chip8_vipCycles(const chip8State_t* state, uint16_t opcode, uint16_t previousPC, uint8_t previousVX) {
+    // only the skips move PC on by more than one instruction without jumping
+    bool skipped = (uint16_t)(state->PC - previousPC) > 2;
+    uint8_t X = (opcode & 0x0F00u) >> 8u;
+    switch (opcode & 0xF000u) {
+        case 0x0000:
+            if (opcode == 0x00E0) {
+                return CHIP8_VIP_CLEAR_CYCLES;
+            }
+            return opcode == 0x00EE ? 10 : 26;
+        case 0x1000:
+            return 12;
+        case 0x2000:
+            return 26;
+        case 0x3000:
+        case 0x4000:
+            return skipped ? 14 : 10;
+        case 0x5000:
+        case 0x9000:
+            return skipped ? 18 : 14;
+        case 0x6000:
+            return 6;
+        case 0x7000:
+            return 10;
+        case 0x8000:
+            return 44;
+        case 0xA000:
+            return 12;
+        case 0xB000:
+            return 22;
+        case 0xC000:
+            return 36;
+        case 0xD000: {
+            // every row is shifted into place one bit at a time
+            int32_t rows = opcode & 0x000Fu;
+            return CHIP8_VIP_DRAW_CYCLES + rows * (CHIP8_VIP_DRAW_ROW_CYCLES + 4 * (previousVX & 7u));
+        }
+        case 0xE000:
+            return skipped ? 18 : 14;
+        default:
+            switch (opcode & 0x00FFu) {
+                case 0x001E:
+                case 0x0029:
+                    return 16;
+                case 0x0033:
+                    // each digit is found by repeated subtraction
+                    return 84 + 16 * (previousVX / 100 + (previousVX / 10) % 10 + previousVX % 10);
+                case 0x0055:
+                case 0x0065:
+                    return 14 + 14 * (X + 1);
+                default:
+                    return 10;
+            }
+    }
+}
+
+bool chip8_emulateVipFrame(chip8State_t* state) {
+    if (!state->isGameLoaded) {
+        fprintf(stderr, "No game is loaded!\n");
         return false;
     }
+    // the frame is the unit of time here, so late latched keys are applied when it starts
+    if (state->keyQueueCount > 0) {
+        chip8_latchKeys(state);
+    }
+    // an instruction that ran past the end of the last frame already used part of this one
+    state->vipCycles += CHIP8_VIP_CYCLES_PER_FRAME - CHIP8_VIP_DISPLAY_CYCLES;
+    bool afterInterrupt = true;
+    while (state->vipCycles > 0 && !state->waitingForKey) {
+        uint16_t opcode = chip8_fetch(state);
+        if ((opcode & 0xF000u) == 0xD000 && !afterInterrupt) {
+            // DXYN waits for the display interrupt, the rest of the frame passes idle
+            state->vipCycles = 0;
+            break;
+        }
+        if (!chip8_checkAccess(state, opcode, state->PC, 2)) {
+            return false;
+        }
+        uint16_t previousPC = state->PC;
+        uint8_t previousVX = state->V[(opcode & 0x0F00u) >> 8u];
+        enum chip8_decodeState decodeState = chip8_execute(state, opcode);
+        if (decodeState == Chip8_Decode_State_Invalid) {
+            return false;
+        } else if (decodeState == Chip8_Decode_State_Break) {
+            // a debugger trap stopped before the instruction, it runs first thing next frame
+            break;
+        }
+        state->instructions++;
+        state->vipCycles -= CHIP8_VIP_FETCH_CYCLES + chip8_vipCycles(state, opcode, previousPC, previousVX);
+        afterInterrupt = false;
+    }
+    if (state->waitingForKey && state->vipCycles > 0) {
+        // FX0A idles until the key is released, idle cycles are not saved up
+        state->vipCycles = 0;
+    }
+    // the display interrupt runs the timers
+    chip8_endFrame(state);
+    return true;
+}
+
+void chip8_updateTimers(chip8State_t* state) {
+    if (state->delay > 0) {
+        state->delay--;
+    }
+
+    if (state->sound > 0) {
+        state->sound--;
+    }
+}
 
-    fseek(fptr, 0, SEEK_END);
-    long fileSize = ftell(fptr);
-    rewind(fptr);
+bool chip8_isWaitingForKey(const chip8State_t* state) {
+    return state->waitingForKey;
+}
 
-    if (fileSize == 0) {
-        fprintf(stderr, "File size is 0!\n");
+bool chip8_loadGame(chip8State_t* state, const char* filePath) {
+    chip8Rom_t* rom = chip8_romOpen(filePath, state->memSize - CHIP8_PC_START);
+    if (rom == NULL) {
         return false;
     }
 
-    char* buffer = (char*)malloc(sizeof(char) * fileSize);
-    if (buffer == NULL) {
-        fprintf(stderr, "Failed to allocate memory for buffer for ROM\n");
+    if (!chip8_loadRom(state, rom)) {
+        chip8_romClose(&rom);
         return false;
     }
+    state->aot = chip8_aotOpen(CHIP8_AOT_DIR, rom);
 
-    size_t result = fread(buffer, sizeof(uint8_t), (size_t)fileSize, fptr);
-    if (result != fileSize) {
-        fprintf(stderr, "Failed to read ROM\n");
-        return false;
+    uint16_t opcode;
+    for (size_t i = 0; i + 1 < rom->size; i += 2) {
+        opcode = (rom->data[i] << 8u) | rom->data[i + 1];
+        CHIP8_LOG(state, "%zu: \t0x%x\n", i + CHIP8_PC_START, opcode);
     }
 
-    if (CHIP8_MEM_SIZE >= fileSize) {
-        for (int i = 0; i < fileSize; ++i) {
-            state->memory[i + CHIP8_PC_START] = (uint8_t)buffer[i];
-        }
-        free(buffer);
-        buffer = NULL;
-    } else {
+    chip8_romClose(&rom);
+    return true;
+}
+
+bool chip8_loadRom(chip8State_t* state, const chip8Rom_t* rom) {
+    size_t maxSize = state->memSize - CHIP8_PC_START;
+    if (rom->size > maxSize) {
         fprintf(stderr, "File too large!\n");
         return false;
     }
 
-    fclose(fptr);
-    fptr = NULL;
+    memcpy(&state->memory[CHIP8_PC_START], rom->data, rom->size);
+    // clear whatever a previously loaded rom left behind
+    memset(&state->memory[CHIP8_PC_START + rom->size], 0, maxSize - rom->size);
+    chip8_aotClose(&state->aot);
     state->isGameLoaded = true;
-
-    uint16_t opcode;
-    for (int i = 0; i < fileSize; i += 2) {
-        opcode = (state->memory[i + CHIP8_PC_START] << 8u) | state->memory[i + CHIP8_PC_START + 1];
-        fprintf(state->log, "%d: \t0x%x\n", i + CHIP8_PC_START, opcode);
-    }
-
     return true;
 }
 
+void chip8_attachAot(chip8State_t* state, chip8Aot_t* aot) {
+    // retained first, attaching the artifact the machine already holds must not unmap it
+    chip8Aot_t* held = aot != NULL ? chip8_aotRetain(aot) : NULL;
+    chip8_aotClose(&state->aot);
+    state->aot = held;
+}
+
 void chip8_run(chip8State_t* state) {
     if (!state->isGameLoaded) {
         fprintf(stderr, "No game is loaded!\n");
@@ -651,154 +1210,259 @@ void chip8_run(chip8State_t* state) {
     chip8_draw(state);
 }
 
+// Scales an unpacked display into the frame bitmap and flips it onto the window
+static void chip8_present(chip8Scaler_t* scaler, ALLEGRO_BITMAP* frame, const uint8_t* pixels, uint16_t width,
+                          uint16_t height) {
+    int scaledWidth = 0;
+    int scaledHeight = 0;
+    ALLEGRO_LOCKED_REGION* region = al_lock_bitmap(frame, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE, ALLEGRO_LOCK_WRITEONLY);
+    if (region != NULL) {
+        chip8_scalerRun(scaler, pixels, width, height, region->data, region->pitch, &scaledWidth, &scaledHeight);
+        al_unlock_bitmap(frame);
+    }
+
+    // clear screen
+    al_clear_to_color(al_map_rgb(0, 0, 0));
+    // an edge filter that does not divide the window leaves a smaller image, stretch it over the window
+    if (scaledWidth > 0 && scaledHeight > 0) {
+        al_draw_scaled_bitmap(frame, 0, 0, (float)scaledWidth, (float)scaledHeight, 0, 0,
+                              (float)scaler->outputWidth, (float)scaler->outputHeight, 0);
+    }
+
+    al_flip_display();
+}
+
 void chip8_draw(chip8State_t* state) {
     al_init();
     al_install_keyboard();
     al_install_audio();
-    al_init_acodec_addon();
 
-    ALLEGRO_SAMPLE *soundEffect = al_load_sample("..\\sounds\\beep.wav");
-    if (soundEffect == NULL) {
-        fprintf(stderr, "Failed to load sample!\n");
-    }
-    al_reserve_samples(1);
+    // without audio the machine still runs, it is just silent
+    chip8Audio_t* audio = chip8_audioInit();
 
-    ALLEGRO_TIMER* timer = al_create_timer(CHIP8_ALLEGRO_TIMER_SPEED_SECS);
+    // runs one instruction per tick, or a whole frame with COSMAC VIP timing
+    ALLEGRO_TIMER* timer = al_create_timer(state->vipTiming ? CHIP8_VIP_FRAME_SECS : CHIP8_ALLEGRO_TIMER_SPEED_SECS);
+    // only runs the delay and sound timers while FX0A is waiting, so the event queue can block in between
+    ALLEGRO_TIMER* timerTicker = al_create_timer(CHIP8_ALLEGRO_TIMER_UPDATE_SECS);
     ALLEGRO_EVENT_QUEUE* queue = al_create_event_queue();
-    ALLEGRO_DISPLAY* disp = al_create_display(CHIP8_GRAPHICS_WIDTH * CHIP8_SCALED_PIXEL_SIZE,
-                                              CHIP8_GRAPHICS_HEIGHT * CHIP8_SCALED_PIXEL_SIZE);
+    // without a filter from the frontend the display gets square pixels in a window of the classic size
+    chip8Scaler_t* scaler = state->scaler;
+    if (scaler == NULL) {
+        scaler = chip8_scalerInit(Chip8_Scaler_Filter_Nearest, CHIP8_GRAPHICS_WIDTH * CHIP8_SCALED_PIXEL_SIZE,
+                                  CHIP8_GRAPHICS_HEIGHT * CHIP8_SCALED_PIXEL_SIZE, 0, false);
+    }
+    ALLEGRO_DISPLAY* disp = al_create_display(scaler->outputWidth, scaler->outputHeight);
+    // the scaled image is written on the CPU and uploaded once per frame
+    ALLEGRO_BITMAP* frame = al_create_bitmap(scaler->outputWidth, scaler->outputHeight);
+    // one present per frame of emulated time at most, fewer while emulation falls behind
+    chip8Pacing_t* pacing = state->pacing;
+    if (pacing == NULL) {
+        pacing = chip8_pacingInit(state->vipTiming ? CHIP8_VIP_FRAME_SECS : CHIP8_ALLEGRO_TIMER_UPDATE_SECS);
+    }
+    // ticks of timer that were emulated, the timer counts the ones that should have been
+    int64_t ticksHandled = 0;
     ALLEGRO_FONT* font = al_create_builtin_font();
 
     al_register_event_source(queue, al_get_keyboard_event_source());
     al_register_event_source(queue, al_get_display_event_source(disp));
     al_register_event_source(queue, al_get_timer_event_source(timer));
+    al_register_event_source(queue, al_get_timer_event_source(timerTicker));
+    if (audio != NULL) {
+        al_register_event_source(queue, chip8_audioEventSource(audio));
+    }
 
     ALLEGRO_EVENT event;
+    bool audioPaused = false;
 
     al_start_timer(timer);
     while (1)
     {
-        al_wait_for_event(queue, &event);
+        if (state->drawFlag || scaler->fading) {
+            // a change waiting for its frame is presented then even if no event arrives, e.g. while FX0A waits
+            double wait = pacing->next - al_get_time();
+            ALLEGRO_TIMEOUT timeout;
+            al_init_timeout(&timeout, wait > 0.0 ? wait : 0.0);
+            if (!al_wait_for_event_until(queue, &event, &timeout)) {
+                event.type = 0;     // nothing to handle, only the present is due
+            }
+        } else {
+            al_wait_for_event(queue, &event);
+        }
 
-        if (event.type == ALLEGRO_EVENT_TIMER) {
-            if (chip8_emulateCycle(state, soundEffect) == false) {
+        if (event.type == ALLEGRO_EVENT_TIMER && event.timer.source == timer) {
+            ticksHandled++;
+            bool success = state->vipTiming ? chip8_emulateVipFrame(state) : chip8_emulateCycle(state);
+            if (success == false) {
                 break;
             }
+            // late latched keys still queued get applied by the next cycle even while FX0A waits,
+            // a VIP frame runs the timers itself
+            if (!state->vipTiming && chip8_isWaitingForKey(state) && state->keyQueueCount == 0) {
+                // nothing executes until a key event arrives, so stop waking up for instructions
+                al_stop_timer(timer);
+                if (state->delay > 0 || state->sound > 0 || scaler->fading || state->shared != NULL) {
+                    al_start_timer(timerTicker);
+                }
+            }
+        } else if (event.type == ALLEGRO_EVENT_TIMER) {
+            // the same end of frame as a running machine, so readers of the shared state see the wait too
+            chip8_endFrame(state);
+            // the afterglow keeps fading while the machine waits
+            if (state->delay == 0 && state->sound == 0 && !scaler->fading && state->shared == NULL) {
+                al_stop_timer(timerTicker);
+            }
+        } else if (event.type == ALLEGRO_EVENT_AUDIO_STREAM_FRAGMENT) {
+            if (state->patternLoaded) {
+                chip8_audioSetPattern(audio, state->pattern, state->pitch);
+            }
+            chip8_audioFillFragment(audio, state->sound > 0);
         } else if (event.type == ALLEGRO_EVENT_KEY_DOWN) {
-            chip8_processKey(state, *al_keycode_to_name(event.keyboard.keycode), 1);
+            // the timestamp comes from the same monotonic clock as al_get_time
+            if (state->latency != NULL && chip8_keycodeToKey(event.keyboard.keycode) != CHIP8_NO_KEY) {
+                chip8_latencyInput(state->latency, event.keyboard.timestamp, state->keyEvents);
+            }
+            chip8_processKey(state, event.keyboard.keycode, 1);
         } else if (event.type == ALLEGRO_EVENT_KEY_UP) {
-            chip8_processKey(state, *al_keycode_to_name(event.keyboard.keycode), 0);
+            chip8_processKey(state, event.keyboard.keycode, 0);
         } else if (event.type == ALLEGRO_EVENT_DISPLAY_CLOSE) {
             break;
         }
 
-        if (state->drawFlag && al_is_event_queue_empty(queue))
-        {
-            // clear screen
-            al_clear_to_color(al_map_rgb(0, 0, 0));
-
-            int posX = 0;
-            int x = 0;
-            int y = 0;
-            ALLEGRO_COLOR color;
-            // draw each pixel
-            for (int i = 0; i < CHIP8_GRAPHICS_SIZE; i++) {
-                // pixels are either on (white) or off (black)
-                if (state->gfx[i]) {
-                    color = al_map_rgb(255, 255, 255);
-                } else {
-                    color = al_map_rgb(0, 0, 0);
-                }
-                // Scale each pixel so it's easier to see
-                for (int lineX = 0; lineX < CHIP8_SCALED_PIXEL_SIZE; lineX++) {
-                    for (int lineY = 0; lineY < CHIP8_SCALED_PIXEL_SIZE; lineY++) {
-                        al_draw_pixel(x + lineX, y + lineY, color);
-                    }
-                }
-                x += CHIP8_SCALED_PIXEL_SIZE;
-                posX++;
-                if (posX == CHIP8_GRAPHICS_WIDTH) {
-                    x = 0;
-                    y += CHIP8_SCALED_PIXEL_SIZE;
-                    posX = 0;
-                }
+        if (state->latency != NULL) {
+            chip8_latencyObserve(state->latency, state->keysApplied, state->drawsAtApply);
+        }
+        if (!chip8_isWaitingForKey(state) && !al_get_timer_started(timer)) {
+            // the key was released, go back to running instructions
+            al_stop_timer(timerTicker);
+            al_start_timer(timer);
+        }
+        if (audio != NULL) {
+            // a silent stream still asks for a fragment every few milliseconds, pause it while idle
+            bool idle = chip8_isWaitingForKey(state) && state->sound == 0 && audio->gain == 0.0f;
+            if (idle != audioPaused) {
+                chip8_audioSetPlaying(audio, !idle);
+                audioPaused = idle;
             }
+        }
 
-            al_flip_display();
-            state->drawFlag = false;
+        // every change within a frame goes into one present, the afterglow fades once per frame even when nothing
+        // is drawn
+        double now = al_get_time();
+        if ((state->drawFlag || scaler->fading) && chip8_pacingDue(pacing, now)) {
+            uint8_t pixels[CHIP8_DISPLAY_SIZE];
+            chip8_unpackDisplay(state, pixels);
+            double backlog = (double)(al_get_timer_count(timer) - ticksHandled) * al_get_timer_speed(timer);
+            enum chip8_pacingAction action = chip8_pacingDecide(pacing, pixels, state->width, state->height, now,
+                                                                backlog);
+            if (action == Chip8_Pacing_Action_PresentHeld) {
+                // the skipped frame had pixels that are gone by now, the current one waits for the next frame
+                chip8_present(scaler, frame, pacing->held, pacing->heldWidth, pacing->heldHeight);
+                chip8_pacingPresented(pacing, pacing->held, pacing->heldWidth, pacing->heldHeight, state->draws,
+                                      now, al_get_time());
+            } else if (action == Chip8_Pacing_Action_Present) {
+                chip8_present(scaler, frame, pixels, state->width, state->height);
+                chip8_pacingPresented(pacing, pixels, state->width, state->height, state->draws, now, al_get_time());
+                state->drawFlag = false;
+                if (state->latency != NULL) {
+                    chip8_latencyPresent(state->latency, al_get_time(), state->draws);
+                }
+            }
         }
     }
 
     al_destroy_font(font);
+    al_destroy_bitmap(frame);
     al_destroy_display(disp);
+    if (scaler != state->scaler) {
+        chip8_scalerDel(&scaler);
+    }
+    if (pacing != state->pacing) {
+        chip8_pacingDel(&pacing);
+    }
     al_destroy_timer(timer);
-    al_destroy_sample(soundEffect);
+    al_destroy_timer(timerTicker);
+    chip8_audioDel(&audio);
     al_destroy_event_queue(queue);
 }
 
-void chip8_processKey(chip8State_t* state, int key, int value) {
-    /*
-     * Keypad:
-     * +-+-+-+-+  ===  +-+-+-+-+
-     * |1|2|3|C|       |1|2|3|4|
-     * |4|5|6|D|       |Q|W|E|R|
-     * |7|8|9|E|       |A|S|D|F|
-     * |A|0|B|F|       |Z|X|C|V|
-     */
-    int lower = key;
-    if (isalpha(key)) {
-        lower = tolower(key);
+void chip8_setKey(chip8State_t* state, int key, int value) {
+    state->keys[key] = value;
+    if (!state->waitingForKey) {
+        return;
     }
-    switch (lower) {
-        case '1':
-            state->keys[1] = value;
-            break;
-        case '2':
-            state->keys[2] = value;
-            break;
-        case '3':
-            state->keys[3] = value;
-            break;
-        case '4':
-            state->keys[12] = value;
-            break;
-        case 'q':
-            state->keys[4] = value;
-            break;
-        case 'w':
-            state->keys[5] = value;
-            break;
-        case 'e':
-            state->keys[6] = value;
-            break;
-        case 'r':
-            state->keys[13] = value;
-            break;
-        case 'a':
-            state->keys[7] = value;
-            break;
-        case 's':
-            state->keys[8] = value;
-            break;
-        case 'd':
-            state->keys[9] = value;
-            break;
-        case 'f':
-            state->keys[14] = value;
-            break;
-        case 'z':
-            state->keys[10] = value;
-            break;
-        case 'x':
-            state->keys[0] = value;
-            break;
-        case 'c':
-            state->keys[11] = value;
-            break;
-        case 'v':
-            state->keys[15] = value;
-            break;
-        default:
+    if (value != 0 && state->waitKey == CHIP8_NO_KEY) {
+        state->waitKey = key;
+    } else if (value == 0 && state->waitKey == key) {
+        // FX0A completes on release
+        state->V[state->waitRegister] = key;
+        state->waitingForKey = false;
+        state->waitKey = CHIP8_NO_KEY;
+        state->PC += 2;
+    }
+}
+
+void chip8_queueKey(chip8State_t* state, int key, int value) {
+    if (state->keyQueueCount == CHIP8_KEY_QUEUE_SIZE) {
+        // more events than a frame should ever see, make room rather than lose one
+        chip8_latchKeys(state);
+    }
+    state->keyQueue[state->keyQueueCount].key = (int8_t)key;
+    state->keyQueue[state->keyQueueCount].value = (uint8_t)value;
+    state->keyQueueCount++;
+    state->keyEvents++;
+    if (!state->lateLatch || state->waitingForKey) {
+        while (state->keyQueueCount > 0) {
+            chip8_latchKeys(state);
+        }
+    }
+}
+
+void chip8_latchKeys(chip8State_t* state) {
+    uint16_t changed = 0;
+    uint8_t applied = 0;
+    while (applied < state->keyQueueCount) {
+        const chip8KeyEvent_t* event = &state->keyQueue[applied];
+        // a press and release within the same frame would otherwise never be seen
+        if ((changed & (1u << event->key)) != 0) {
             break;
+        }
+        changed |= 1u << event->key;
+        chip8_setKey(state, event->key, event->value);
+        applied++;
+    }
+    memmove(state->keyQueue, &state->keyQueue[applied], (state->keyQueueCount - applied) * sizeof(chip8KeyEvent_t));
+    state->keyQueueCount -= applied;
+    state->keysApplied += applied;
+    state->drawsAtApply = state->draws;
+}
+
+/*
+ * Keypad:
+ * +-+-+-+-+  ===  +-+-+-+-+
+ * |1|2|3|C|       |1|2|3|4|
+ * |4|5|6|D|       |Q|W|E|R|
+ * |7|8|9|E|       |A|S|D|F|
+ * |A|0|B|F|       |Z|X|C|V|
+ *
+ * Entries hold the keypad index plus one so every unmapped keycode is 0
+ */
+static const uint8_t chip8_keymap[ALLEGRO_KEY_MAX] = {
+        [ALLEGRO_KEY_1] = 0x1 + 1, [ALLEGRO_KEY_2] = 0x2 + 1, [ALLEGRO_KEY_3] = 0x3 + 1, [ALLEGRO_KEY_4] = 0xC + 1,
+        [ALLEGRO_KEY_Q] = 0x4 + 1, [ALLEGRO_KEY_W] = 0x5 + 1, [ALLEGRO_KEY_E] = 0x6 + 1, [ALLEGRO_KEY_R] = 0xD + 1,
+        [ALLEGRO_KEY_A] = 0x7 + 1, [ALLEGRO_KEY_S] = 0x8 + 1, [ALLEGRO_KEY_D] = 0x9 + 1, [ALLEGRO_KEY_F] = 0xE + 1,
+        [ALLEGRO_KEY_Z] = 0xA + 1, [ALLEGRO_KEY_X] = 0x0 + 1, [ALLEGRO_KEY_C] = 0xB + 1, [ALLEGRO_KEY_V] = 0xF + 1,
+};
+
+int chip8_keycodeToKey(int keycode) {
+    if (keycode < 0 || keycode >= ALLEGRO_KEY_MAX || chip8_keymap[keycode] == 0) {
+        return CHIP8_NO_KEY;
+    }
+    return chip8_keymap[keycode] - 1;
+}
+
+void chip8_processKey(chip8State_t* state, int keycode, int value) {
+    int key = chip8_keycodeToKey(keycode);
+    if (key != CHIP8_NO_KEY) {
+        chip8_queueKey(state, key, value);
     }
 }
@@ -1,34 +1,94 @@
 #ifndef CHIP_8_CHIP8_H
 #define CHIP_8_CHIP8_H
 
-#include <allegro5/allegro_audio.h>
-#include <allegro5/allegro_acodec.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdbool.h>
 #include <windows.h>
+#include "chip8_rom.h"
+#include "chip8_profiler.h"
+#include "chip8_shared.h"
+#include "chip8_latency.h"
+#include "chip8_scaler.h"
+#include "chip8_pacing.h"
+#include "chip8_aot.h"
 
 #define CHIP8_REGISTERS_SIZE 16
 #define CHIP8_STACK_SIZE 16
 #define CHIP8_PC_START 0x200
 #define CHIP8_MEM_SIZE 4096
+#define CHIP8_MAX_ROM_SIZE (CHIP8_MEM_SIZE - CHIP8_PC_START)
+#define CHIP8_XO_MEM_SIZE 65536
+#define CHIP8_XO_MAX_ROM_SIZE (CHIP8_XO_MEM_SIZE - CHIP8_PC_START)
+#define CHIP8_MEMORY_GUARD 64           // Bytes past the end of memory mirroring its start, the longest read is a
+                                        // 16x16 sprite on both XO-CHIP planes
 #define CHIP8_GRAPHICS_WIDTH 64
 #define CHIP8_GRAPHICS_HEIGHT 32
 #define CHIP8_GRAPHICS_SIZE CHIP8_GRAPHICS_WIDTH * CHIP8_GRAPHICS_HEIGHT
+#define CHIP8_HIRES_WIDTH 128
+#define CHIP8_HIRES_HEIGHT 64
+#define CHIP8_DISPLAY_SIZE (CHIP8_HIRES_WIDTH * CHIP8_HIRES_HEIGHT)    // Pixels of the largest display
+#define CHIP8_DISPLAY_PLANES 2
+#define CHIP8_DISPLAY_WORDS 2       // 64 pixel words per row of a plane, enough for CHIP8_HIRES_WIDTH
+#define CHIP8_PALETTE_SIZE 4        // One color for every combination of planes
+#define CHIP8_PATTERN_SIZE 16
+#define CHIP8_PITCH_DEFAULT 64
+#define CHIP8_FLAGS_SIZE 16
 #define CHIP8_KEYS_SIZE 16
 #define CHIP8_REGISTER_CARRY 0xF
 #define CHIP8_SPRITE_WIDTH 8
+#define CHIP8_BIG_SPRITE_WIDTH 16
+#define CHIP8_SCROLL_PIXELS 4
 #define CHIP8_SCALED_PIXEL_SIZE 8
 #define CHIP8_ALLEGRO_TIMER_SPEED_SECS 1.0 / 360.0
 #define CHIP8_CYCLES_PER_TIMER_UPDATE 10
+#define CHIP8_ALLEGRO_TIMER_UPDATE_SECS ((CHIP8_ALLEGRO_TIMER_SPEED_SECS) * CHIP8_CYCLES_PER_TIMER_UPDATE)
+#define CHIP8_VIP_FRAME_SECS (1.0 / 60.0)
+#define CHIP8_VIP_CYCLES_PER_FRAME 3668     // 1.7606 MHz with 8 clocks per machine cycle at 60 Hz
+#define CHIP8_VIP_DISPLAY_CYCLES 1832       // Display interrupt and DMA of every frame, not available to programs
+#define CHIP8_VIP_FETCH_CYCLES 40           // Fetching and dispatching any instruction
+#define CHIP8_VIP_CLEAR_CYCLES 3078
+#define CHIP8_VIP_DRAW_CYCLES 26
+#define CHIP8_VIP_DRAW_ROW_CYCLES 46
+#define CHIP8_NO_KEY -1
+#define CHIP8_KEY_QUEUE_SIZE 32
+#define CHIP8_LATE_LATCH_CYCLES 2     // Instructions of each frame that run after late latched keys are applied
+#define CHIP8_RANDOM_SEED 1           // Seed of CXNN until chip8_seedRandom picks another
+#define CHIP8_LOG_PATH "..\\logs\\log.txt"
+#define CHIP8_AOT_DIR "..\\aot"           // Where chip8_loadGame looks for the artifacts written by the aot tool
 
 #define CHIP8_FONTSET_HEIGHT 16
 #define CHIP8_FONTSET_WIDTH 5
 #define CHIP8_FONTSET_SIZE CHIP8_FONTSET_WIDTH * CHIP8_FONTSET_HEIGHT
+#define CHIP8_BIG_FONTSET_START CHIP8_FONTSET_SIZE
+#define CHIP8_BIG_FONTSET_WIDTH 10
+#define CHIP8_BIG_FONTSET_SIZE (CHIP8_BIG_FONTSET_WIDTH * CHIP8_FONTSET_HEIGHT)
 
-enum chip8_decodeState{ Chip8_Decode_State_Invalid, Chip8_Decode_State_Blocking, Chip8_Decode_State_Success };
+extern const uint8_t chip8_palette[CHIP8_PALETTE_SIZE]; // Gray level for every value of an unpacked pixel
+
+enum chip8_decodeState{ Chip8_Decode_State_Invalid, Chip8_Decode_State_Blocking, Chip8_Decode_State_Success,
+                        Chip8_Decode_State_Break };
+
+enum chip8_machine {
+    Chip8_Machine_Chip8,        // 64x32, 4 KB of memory
+    Chip8_Machine_SuperChip,    // Adds 128x64, scrolling, 16x16 sprites, the big font and the flag registers
+    Chip8_Machine_XoChip        // Adds 64 KB of memory, two bitplanes, F000 NNNN and the audio pattern buffer
+};
 
 typedef struct {
+    int8_t key;           // Index of the key on the chip 8 keypad
+    uint8_t value;        // Value to assign to the key
+} chip8KeyEvent_t;
+
+#define CHIP8_DISPATCH_SIZE 16
+
+struct chip8State;
+struct chip8Debugger;
+
+// Executes an instruction of one opcode class, the class is the top nibble of the opcode
+typedef enum chip8_decodeState (*chip8DecodeFn_t)(struct chip8State* state, uint16_t opcode);
+
+typedef struct chip8State {
     uint8_t *V;           // Registers V0-VF
     uint16_t I;           // Index register
     uint16_t SP;          // Stack pointer
@@ -36,21 +96,102 @@ typedef struct {
     uint16_t PC;          // Program counter
     uint8_t delay;        // Delay timer
     uint8_t sound;        // Sound timer
-    uint8_t *memory;      // Memory of system
-    uint8_t *gfx;         // Graphics - each index is a pixel
+    uint8_t *memory;      // Memory of system, followed by CHIP8_MEMORY_GUARD bytes mirroring its start
+    uint64_t *display;    // Graphics - CHIP8_DISPLAY_PLANES planes of CHIP8_HIRES_HEIGHT rows of CHIP8_DISPLAY_WORDS
+                          // words, the top bit of the first word of a row is its leftmost pixel
     uint8_t *keys;        // Input keys
     bool drawFlag;        // Whether the screen needs to be drawn
     bool isGameLoaded;    // Whether there is a game loaded to chip8_run
     FILE* log;            // Log file for debugging
     int cycle;            // Cycle number - should stay between 1 and 10 inclusive
+    bool waitingForKey;   // Whether FX0A is waiting for a key to be pressed and released
+    uint8_t waitRegister; // Register FX0A stores the key in
+    int8_t waitKey;       // Key pressed while FX0A is waiting or CHIP8_NO_KEY
+    chip8Profiler_t* profiler; // Profiler fed by chip8_emulateCycle when built with CHIP8_PROFILE
+    chip8Shared_t* shared;  // Shared memory the state is published to on every timer update or NULL
+    uint64_t instructions;  // Instructions executed
+    uint64_t frames;        // Timer updates, one per frame of emulated time
+    uint64_t draws;         // Instructions that changed the display
+    bool lateLatch;         // Whether key events wait until CHIP8_LATE_LATCH_CYCLES before the end of the frame
+    chip8KeyEvent_t keyQueue[CHIP8_KEY_QUEUE_SIZE]; // Key events not applied to keys yet, oldest first
+    uint8_t keyQueueCount;
+    uint64_t keyEvents;     // Key events received by chip8_queueKey
+    uint64_t keysApplied;   // Key events applied to keys, always in the order they were received
+    uint64_t drawsAtApply;  // Value of draws when key events were last applied
+    chip8Latency_t* latency; // Tracker fed with key press and present times by chip8_draw or NULL
+    chip8Scaler_t* scaler;  // Filter chip8_draw scales the display with, the window is its output size, or NULL
+    chip8Pacing_t* pacing;  // Pacer deciding when chip8_draw presents, with its frame statistics, or NULL
+    enum chip8_machine machine; // Instruction set and memory size the machine was created with
+    uint32_t memSize;       // Size of memory in bytes, a power of two
+    uint32_t memMask;       // memSize - 1
+    uint16_t width;         // Width of the display in pixels, CHIP8_GRAPHICS_WIDTH or CHIP8_HIRES_WIDTH
+    uint16_t height;        // Height of the display in pixels, CHIP8_GRAPHICS_HEIGHT or CHIP8_HIRES_HEIGHT
+    uint8_t planeMask;      // Planes that drawing, clearing and scrolling apply to, selected by FN01
+    uint8_t pattern[CHIP8_PATTERN_SIZE]; // XO-CHIP audio pattern, 128 one bit samples loaded by F002
+    bool patternLoaded;     // Whether F002 has run, the plain tone plays until then
+    uint8_t pitch;          // XO-CHIP pattern playback pitch set by FX3A
+    uint8_t flags[CHIP8_FLAGS_SIZE]; // SUPER-CHIP flag registers saved by FX75 and restored by FX85
+    bool vipTiming;         // Whether frontends run chip8_emulateVipFrame instead of chip8_emulateCycle
+    int32_t vipCycles;      // Machine cycles left in the current COSMAC VIP frame, negative when overspent
+    chip8DecodeFn_t dispatch[CHIP8_DISPATCH_SIZE]; // Decode function for every opcode class
+    struct chip8Debugger* debugger; // Debugger patching dispatch entries to stop execution or NULL
+    uint32_t random;        // State of the generator CXNN draws from
+    chip8Aot_t* aot;        // Artifact of the loaded rom or NULL, dropped once the program writes over its code
+    uint64_t faults[CHIP8_DISPATCH_SIZE]; // Accesses that ran past the end of memory and wrapped, per opcode class
+    bool strictMemory;      // Whether such an access is an invalid instruction instead of only being counted
 } chip8State_t;
 
 /**
- * Initializes and returns a chip 8 state struct
+ * Initializes and returns a chip 8 state struct tracing to CHIP8_LOG_PATH
  * @return A pointer to the created chip8State_t struct
  */
 chip8State_t* chip8_init(void);
 
+/**
+ * Initializes and returns a chip 8 state struct that traces every instruction to the given file
+ * @param logPath The file path of the trace or NULL to run without one
+ * @return A pointer to the created chip8State_t struct
+ */
+chip8State_t* chip8_initWithLog(const char* logPath);
+
+/**
+ * Initializes and returns a chip 8 state struct emulating the given machine
+ * @param machine The instruction set and memory size to emulate
+ * @param logPath The file path of the trace or NULL to run without one, headless frontends pass NULL since the trace
+ * costs far more than the emulation itself
+ * @return A pointer to the created chip8State_t struct
+ */
+chip8State_t* chip8_initMachine(enum chip8_machine machine, const char* logPath);
+
+/**
+ * Puts a chip 8 state back into its power on state without allocating, a rom has to be loaded again
+ * The machine, the trace, the attached frontend objects, the dispatch table, the random generator and strictMemory
+ * are kept, the artifact of the rom is dropped and the fault counters are cleared.
+ * @param state A pointer to the state for chip 8
+ */
+void chip8_reset(chip8State_t* state);
+
+/**
+ * Seeds the generator CXNN draws from, the same seed gives the same numbers on every platform
+ * @param state A pointer to the state for chip 8
+ * @param seed The seed, 0 picks CHIP8_RANDOM_SEED
+ */
+void chip8_seedRandom(chip8State_t* state, uint32_t seed);
+
+/**
+ * Returns the number of memory accesses that ran past the end of memory and wrapped around to its start
+ * @param state A pointer to the state for chip 8
+ * @return The sum of the fault counters of every opcode class
+ */
+uint64_t chip8_faultCount(const chip8State_t* state);
+
+/**
+ * Writes the fault counters of the opcode classes that have any, nothing if there were none
+ * @param state A pointer to the state for chip 8
+ * @param out The stream to write to
+ */
+void chip8_writeFaults(const chip8State_t* state, FILE* out);
+
 /**
  * Deallocates and frees a chip 8 state struct
  * It also nulls the pointer to the object during deletion
@@ -220,20 +361,103 @@ enum chip8_decodeState chip8_decode0xF000(chip8State_t* state, uint16_t opcode);
 
 /**
  * Emulate a cycle of the chip 8 machine
+ * The sound timer only counts down here, the frontend generates the tone while it is non-zero
  * @param state A pointer to the state for chip 8
- * @param soundEffect The sample to be played if the sound timer is counting down
- * @return If the emulation cycle was successful
+ * @return If the emulation cycle was successful, a debugger trap stopping before the instruction counts as successful
+ * but runs nothing
  */
-bool chip8_emulateCycle(chip8State_t* state, ALLEGRO_SAMPLE *soundEffect);
+bool chip8_emulateCycle(chip8State_t* state);
+
+/**
+ * Emulate the cycles between two updates of the timers, one frame of emulated time
+ * With an artifact loaded, runs of simple instructions it found skip the checks of chip8_emulateCycle between them.
+ * @param state A pointer to the state for chip 8
+ * @return If every emulation cycle was successful
+ */
+bool chip8_emulateFrame(chip8State_t* state);
+
+/**
+ * Emulates one 60 Hz frame of the original COSMAC VIP interpreter. Every instruction is charged its approximate
+ * machine cycle cost against the CHIP8_VIP_CYCLES_PER_FRAME - CHIP8_VIP_DISPLAY_CYCLES cycles left to programs,
+ * DXYN waits for the display interrupt that starts the next frame and the timers tick once at its end.
+ * chip8_emulateCycle and its timing are unaffected.
+ * @param state A pointer to the state for chip 8
+ * @return If every instruction was successful
+ */
+bool chip8_emulateVipFrame(chip8State_t* state);
+
+/**
+ * Decrements the delay and sound timers if they are running
+ * chip8_emulateCycle already does this every CHIP8_CYCLES_PER_TIMER_UPDATE cycles
+ * @param state A pointer to the state for chip 8
+ */
+void chip8_updateTimers(chip8State_t* state);
+
+/**
+ * Whether FX0A is waiting for a key. Until a key is pressed and released no instruction runs, so the frontend can
+ * block on its input and only keep the timers running.
+ * @param state A pointer to the state for chip 8
+ * @return If the chip 8 machine is waiting for a key
+ */
+bool chip8_isWaitingForKey(const chip8State_t* state);
 
 /**
  * Load a rom into the chip 8 machine
+ * The artifact the aot tool compiled for the rom is mapped from CHIP8_AOT_DIR when there is a valid one.
  * @param state A pointer to the state for chip 8
  * @param filePath The file path to the file to be loaded
  * @return If the chip 8 machine was able to load the file specified
  */
 bool chip8_loadGame(chip8State_t* state, const char* filePath);
 
+/**
+ * Copies an already opened rom into the chip 8 machine
+ * Any number of machines can load from the same rom, e.g. one handed out by chip8_romCacheGet. The artifact of a
+ * previously loaded rom is dropped.
+ * @param state A pointer to the state for chip 8
+ * @param rom A pointer to the rom to be loaded
+ * @return If the rom fits in the memory of the chip 8 machine
+ */
+bool chip8_loadRom(chip8State_t* state, const chip8Rom_t* rom);
+
+/**
+ * Lets the machine run the fused runs of an artifact opened for the rom it loaded, replacing the one it had
+ * The machine holds its own reference, so a fleet loading the same rom maps its artifact once and attaches it after
+ * every chip8_loadRom. Only chip8_emulateFrame runs fused runs.
+ * @param state A pointer to the state for chip 8
+ * @param aot A pointer to the artifact of the loaded rom or NULL to drop it
+ */
+void chip8_attachAot(chip8State_t* state, chip8Aot_t* aot);
+
+/**
+ * Returns a row of a display plane
+ * @param state A pointer to the state for chip 8
+ * @param plane The plane, 0 or 1
+ * @param y The row
+ * @return The CHIP8_DISPLAY_WORDS words of the row
+ */
+static inline uint64_t* chip8_displayRow(const chip8State_t* state, int plane, int y) {
+    return &state->display[((size_t)plane * CHIP8_HIRES_HEIGHT + y) * CHIP8_DISPLAY_WORDS];
+}
+
+/**
+ * Unpacks the display into one byte per pixel, row major, holding bit 0 for the first plane and bit 1 for the second
+ * Inline so tools that only link chip8_shared.c can use it as well
+ * @param state A pointer to the state for chip 8
+ * @param pixels Receives width * height bytes, CHIP8_DISPLAY_SIZE bytes is always enough
+ */
+static inline void chip8_unpackDisplay(const chip8State_t* state, uint8_t* pixels) {
+    for (int y = 0; y < state->height; y++) {
+        const uint64_t* first = chip8_displayRow(state, 0, y);
+        const uint64_t* second = chip8_displayRow(state, 1, y);
+        for (int x = 0; x < state->width; x++) {
+            unsigned int shift = 63u - (x & 63u);
+            pixels[y * state->width + x] = (uint8_t)(((first[x >> 6u] >> shift) & 1u) |
+                                                     (((second[x >> 6u] >> shift) & 1u) << 1u));
+        }
+    }
+}
+
 /**
  * Runs the chip 8 machine. Returns early if no rom is loaded in the chip 8 machine.
  * @param state A pointer to the state for chip 8
@@ -242,16 +466,50 @@ void chip8_run(chip8State_t* state);
 
 /**
  * Uses allegro to run the chip 8 machine drawing the output and emulating the machine
+ * Changes to the display are presented at most once per frame of emulated time. While emulation is more than a frame
+ * behind, frames are skipped as decided by state->pacing, or by a pacer of its own without one.
  * @param state A pointer to the state for chip 8
  */
 void chip8_draw(chip8State_t* state);
 
 /**
- * Processes the key press and sets the corresponding key in the chip 8 machine to the given value
+ * Sets a key of the chip 8 keypad and completes a waiting FX0A once the key it saw pressed is released
+ * @param state A pointer to the state for chip 8
+ * @param key The index of the key on the chip 8 keypad
+ * @param value The value to assign to the key
+ */
+void chip8_setKey(chip8State_t* state, int key, int value);
+
+/**
+ * Queues a key event for the chip 8 keypad
+ * Without late latching, and while FX0A is waiting, the key is set right away. With late latching it is set by
+ * chip8_emulateCycle CHIP8_LATE_LATCH_CYCLES instructions before the end of the frame.
+ * @param state A pointer to the state for chip 8
+ * @param key The index of the key on the chip 8 keypad
+ * @param value The value to assign to the key
+ */
+void chip8_queueKey(chip8State_t* state, int key, int value);
+
+/**
+ * Applies queued key events to the keypad in order, stopping before a second event for the same key so every press
+ * is seen by at least one instruction
+ * @param state A pointer to the state for chip 8
+ */
+void chip8_latchKeys(chip8State_t* state);
+
+/**
+ * Looks up the chip 8 keypad key of an allegro keycode
+ * @param keycode The ALLEGRO_KEY_* code of the key
+ * @return The index of the key on the chip 8 keypad or CHIP8_NO_KEY if it isn't mapped
+ */
+int chip8_keycodeToKey(int keycode);
+
+/**
+ * Processes the key press and queues the corresponding key in the chip 8 machine with the given value
  * @param state A pointer to the state for chip 8
- * @param key The character for the key that was pressed
+ * @param keycode The ALLEGRO_KEY_* code of the key that was pressed
  * @param value The value to assign to the corresponding key in the chip 8 machine
  */
-void chip8_processKey(chip8State_t* state, int key, int value);
+void chip8_processKey(chip8State_t* state, int keycode, int value);
 
 #endif //CHIP_8_CHIP8_H
@@ -0,0 +1,809 @@
+#include <stdlib.h>
+#include <string.h>
+#include "chip8.h"
+#include "chip8_analysis.h"
+
+#define CHIP8_ANALYSIS_UNKNOWN_I -1
+
+enum chip8_flowKind chip8_flowOf(uint16_t opcode) {
+    switch (opcode & 0xF000u) {
+        case 0x0000:
+            // the interpreter only looks at the low byte for 00E0 and 00EE and jumps for anything else,
+            // 0000 is zeroed memory rather than a jump into the font
+            if (opcode == 0x0000) {
+                return Chip8_Flow_Invalid;
+            } else if ((opcode & 0x00FFu) == 0x00E0) {
+                return Chip8_Flow_Next;
+            } else if ((opcode & 0x00FFu) == 0x00EE) {
+                return Chip8_Flow_Return;
+            }
+            return Chip8_Flow_Jump;
+        case 0x1000:
+            return Chip8_Flow_Jump;
+        case 0x2000:
+            return Chip8_Flow_Call;
+        case 0x3000:
+        case 0x4000:
+            return Chip8_Flow_Skip;
+        case 0x5000:
+        case 0x9000:
+            return (opcode & 0x000Fu) ? Chip8_Flow_Invalid : Chip8_Flow_Skip;
+        case 0x8000:
+            switch (opcode & 0x000Fu) {
+                case 0x0000:
+                case 0x0001:
+                case 0x0002:
+                case 0x0003:
+                case 0x0004:
+                case 0x0005:
+                case 0x0006:
+                case 0x0007:
+                case 0x000E:
+                    return Chip8_Flow_Next;
+                default:
+                    return Chip8_Flow_Invalid;
+            }
+        case 0xB000:
+            return Chip8_Flow_ComputedJump;
+        case 0xE000:
+            switch (opcode & 0x00FFu) {
+                case 0x009E:
+                case 0x00A1:
+                    return Chip8_Flow_Skip;
+                default:
+                    return Chip8_Flow_Invalid;
+            }
+        case 0xF000:
+            switch (opcode & 0x00FFu) {
+                case 0x0007:
+                case 0x000A:
+                case 0x0015:
+                case 0x0018:
+                case 0x001E:
+                case 0x0029:
+                case 0x0033:
+                case 0x0055:
+                case 0x0065:
+                    return Chip8_Flow_Next;
+                default:
+                    return Chip8_Flow_Invalid;
+            }
+        default:
+            return Chip8_Flow_Next;
+    }
+}
+
+void chip8_disassemble(uint16_t opcode, char* buffer, size_t size) {
+    unsigned int X = (opcode & 0x0F00u) >> 8u;
+    unsigned int Y = (opcode & 0x00F0u) >> 4u;
+    unsigned int N = opcode & 0x000Fu;
+    unsigned int NN = opcode & 0x00FFu;
+    unsigned int NNN = opcode & 0x0FFFu;
+
+    if (chip8_flowOf(opcode) == Chip8_Flow_Invalid) {
+        snprintf(buffer, size, "DW   0x%04X", opcode);
+        return;
+    }
+    switch (opcode & 0xF000u) {
+        case 0x0000:
+            if (NN == 0xE0) {
+                snprintf(buffer, size, "CLS");
+            } else if (NN == 0xEE) {
+                snprintf(buffer, size, "RET");
+            } else {
+                snprintf(buffer, size, "SYS  0x%03X", NNN);
+            }
+            break;
+        case 0x1000:
+            snprintf(buffer, size, "JP   0x%03X", NNN);
+            break;
+        case 0x2000:
+            snprintf(buffer, size, "CALL 0x%03X", NNN);
+            break;
+        case 0x3000:
+            snprintf(buffer, size, "SE   V%X, 0x%02X", X, NN);
+            break;
+        case 0x4000:
+            snprintf(buffer, size, "SNE  V%X, 0x%02X", X, NN);
+            break;
+        case 0x5000:
+            snprintf(buffer, size, "SE   V%X, V%X", X, Y);
+            break;
+        case 0x6000:
+            snprintf(buffer, size, "LD   V%X, 0x%02X", X, NN);
+            break;
+        case 0x7000:
+            snprintf(buffer, size, "ADD  V%X, 0x%02X", X, NN);
+            break;
+        case 0x8000: {
+            static const char* const aluMnemonics[16] = {
+                    "LD  ", "OR  ", "AND ", "XOR ", "ADD ", "SUB ", "SHR ", "SUBN",
+                    NULL, NULL, NULL, NULL, NULL, NULL, "SHL ", NULL
+            };
+            snprintf(buffer, size, "%s V%X, V%X", aluMnemonics[N], X, Y);
+            break;
+        }
+        case 0x9000:
+            snprintf(buffer, size, "SNE  V%X, V%X", X, Y);
+            break;
+        case 0xA000:
+            snprintf(buffer, size, "LD   I, 0x%03X", NNN);
+            break;
+        case 0xB000:
+            snprintf(buffer, size, "JP   V0, 0x%03X", NNN);
+            break;
+        case 0xC000:
+            snprintf(buffer, size, "RND  V%X, 0x%02X", X, NN);
+            break;
+        case 0xD000:
+            snprintf(buffer, size, "DRW  V%X, V%X, %u", X, Y, N);
+            break;
+        case 0xE000:
+            snprintf(buffer, size, "%s V%X", NN == 0x9E ? "SKP " : "SKNP", X);
+            break;
+        default:
+            switch (NN) {
+                case 0x07:
+                    snprintf(buffer, size, "LD   V%X, DT", X);
+                    break;
+                case 0x0A:
+                    snprintf(buffer, size, "LD   V%X, K", X);
+                    break;
+                case 0x15:
+                    snprintf(buffer, size, "LD   DT, V%X", X);
+                    break;
+                case 0x18:
+                    snprintf(buffer, size, "LD   ST, V%X", X);
+                    break;
+                case 0x1E:
+                    snprintf(buffer, size, "ADD  I, V%X", X);
+                    break;
+                case 0x29:
+                    snprintf(buffer, size, "LD   F, V%X", X);
+                    break;
+                case 0x33:
+                    snprintf(buffer, size, "LD   B, V%X", X);
+                    break;
+                case 0x55:
+                    snprintf(buffer, size, "LD   [I], V%X", X);
+                    break;
+                default:
+                    snprintf(buffer, size, "LD   V%X, [I]", X);
+                    break;
+            }
+            break;
+    }
+}
+
+static uint16_t chip8_analysisOpcode(const chip8Analysis_t* analysis, size_t address) {
+    return (analysis->memory[address] << 8u) | analysis->memory[address + 1];
+}
+
+static bool chip8_analysisIsCode(const chip8Analysis_t* analysis, size_t address) {
+    return address + 1 < analysis->memSize && (analysis->flags[address] & CHIP8_ANALYSIS_CODE) != 0;
+}
+
+static void chip8_analysisPush(chip8Analysis_t* analysis, uint16_t* worklist, size_t* count, size_t address,
+                               uint16_t flag) {
+    if (address >= analysis->memSize) {
+        return;
+    }
+    // anything already queued or decoded only needs to be marked as the start of a block
+    if ((analysis->flags[address] & (CHIP8_ANALYSIS_LEADER | CHIP8_ANALYSIS_CODE)) == 0) {
+        worklist[(*count)++] = (uint16_t)address;
+    }
+    analysis->flags[address] |= CHIP8_ANALYSIS_LEADER | flag;
+}
+
+static void chip8_analysisMark(chip8Analysis_t* analysis, size_t start, size_t length, uint16_t flag) {
+    for (size_t i = start; i < start + length && i < analysis->memSize; i++) {
+        analysis->flags[i] |= flag;
+    }
+}
+
+static void chip8_analysisTraverse(chip8Analysis_t* analysis, uint16_t* worklist) {
+    size_t count = 0;
+    chip8_analysisPush(analysis, worklist, &count, CHIP8_PC_START, 0);
+
+    while (count > 0) {
+        size_t address = worklist[--count];
+        bool follow = true;
+        while (follow) {
+            if (address + 1 >= analysis->memSize) {
+                break;
+            }
+            if (analysis->flags[address] & CHIP8_ANALYSIS_CODE) {
+                // fell through into code decoded earlier, so this is where two paths merge
+                analysis->flags[address] |= CHIP8_ANALYSIS_LEADER;
+                break;
+            }
+            uint16_t opcode = chip8_analysisOpcode(analysis, address);
+            enum chip8_flowKind kind = chip8_flowOf(opcode);
+            if (kind == Chip8_Flow_Invalid) {
+                // a skip and the fall through past it can both reach the same word
+                if ((analysis->flags[address] & CHIP8_ANALYSIS_INVALID) == 0) {
+                    analysis->flags[address] |= CHIP8_ANALYSIS_INVALID;
+                    chip8AnalysisSite_t* site = &analysis->invalid[analysis->invalidCount++];
+                    site->instruction = (uint16_t)address;
+                    site->target = opcode;
+                    site->length = 2;
+                }
+                break;
+            }
+            analysis->flags[address] |= CHIP8_ANALYSIS_CODE;
+            analysis->flags[address + 1] |= CHIP8_ANALYSIS_CODE_TAIL;
+
+            uint16_t target = opcode & 0x0FFFu;
+            switch (kind) {
+                case Chip8_Flow_Next:
+                    address += 2;
+                    break;
+                case Chip8_Flow_Jump:
+                    chip8_analysisPush(analysis, worklist, &count, target, 0);
+                    follow = false;
+                    break;
+                case Chip8_Flow_Call:
+                    chip8_analysisPush(analysis, worklist, &count, target, CHIP8_ANALYSIS_SUBROUTINE);
+                    address += 2;
+                    if (address < analysis->memSize) {
+                        analysis->flags[address] |= CHIP8_ANALYSIS_LEADER;
+                    }
+                    break;
+                case Chip8_Flow_Skip:
+                    chip8_analysisPush(analysis, worklist, &count, address + 4, 0);
+                    address += 2;
+                    if (address < analysis->memSize) {
+                        analysis->flags[address] |= CHIP8_ANALYSIS_LEADER;
+                    }
+                    break;
+                case Chip8_Flow_ComputedJump: {
+                    // the only target we can recover is a table of jumps starting at NNN indexed by V0
+                    chip8AnalysisSite_t* site = &analysis->computedJumps[analysis->computedJumpCount++];
+                    site->instruction = (uint16_t)address;
+                    site->target = target;
+                    site->length = 0;
+                    for (size_t entry = target; entry + 1 < analysis->memSize &&
+                                                site->length < CHIP8_ANALYSIS_MAX_JUMP_TABLE; entry += 2) {
+                        if ((chip8_analysisOpcode(analysis, entry) & 0xF000u) != 0x1000) {
+                            break;
+                        }
+                        chip8_analysisPush(analysis, worklist, &count, entry, CHIP8_ANALYSIS_JUMP_TABLE);
+                        site->length++;
+                    }
+                    follow = false;
+                    break;
+                }
+                default:
+                    follow = false;
+                    break;
+            }
+        }
+    }
+}
+
+static void chip8_analysisAddSuccessor(chip8Analysis_t* analysis, chip8BasicBlock_t* block, size_t address) {
+    if (chip8_analysisIsCode(analysis, address) && analysis->blockOf[address] != CHIP8_ANALYSIS_NO_BLOCK) {
+        block->successors[block->successorCount++] = analysis->blockOf[address];
+    }
+}
+
+static bool chip8_analysisBuildBlocks(chip8Analysis_t* analysis) {
+    size_t blockCount = 0;
+    for (size_t address = 0; address < analysis->memSize; address++) {
+        if ((analysis->flags[address] & CHIP8_ANALYSIS_LEADER) && chip8_analysisIsCode(analysis, address)) {
+            analysis->blockOf[address] = (uint16_t)blockCount;
+            blockCount++;
+        }
+    }
+
+    analysis->blocks = calloc(blockCount > 0 ? blockCount : 1, sizeof(chip8BasicBlock_t));
+    if (analysis->blocks == NULL) {
+        return false;
+    }
+    analysis->blockCount = blockCount;
+
+    for (size_t address = 0; address < analysis->memSize; address++) {
+        if (analysis->blockOf[address] == CHIP8_ANALYSIS_NO_BLOCK) {
+            continue;
+        }
+        chip8BasicBlock_t* block = &analysis->blocks[analysis->blockOf[address]];
+        size_t position = address;
+        enum chip8_flowKind kind;
+        while (true) {
+            kind = chip8_flowOf(chip8_analysisOpcode(analysis, position));
+            size_t next = position + 2;
+            if (kind != Chip8_Flow_Next || !chip8_analysisIsCode(analysis, next) ||
+                (analysis->flags[next] & CHIP8_ANALYSIS_LEADER)) {
+                break;
+            }
+            position = next;
+        }
+        block->start = (uint16_t)address;
+        block->last = (uint16_t)position;
+        block->end = (uint16_t)(position + 2);
+        block->exit = kind;
+        block->callee = CHIP8_ANALYSIS_NO_BLOCK;
+    }
+
+    for (size_t i = 0; i < blockCount; i++) {
+        chip8BasicBlock_t* block = &analysis->blocks[i];
+        uint16_t target = chip8_analysisOpcode(analysis, block->last) & 0x0FFFu;
+        switch (block->exit) {
+            case Chip8_Flow_Next:
+                chip8_analysisAddSuccessor(analysis, block, block->last + 2);
+                break;
+            case Chip8_Flow_Jump:
+                chip8_analysisAddSuccessor(analysis, block, target);
+                break;
+            case Chip8_Flow_Call:
+                chip8_analysisAddSuccessor(analysis, block, block->last + 2);
+                if (chip8_analysisIsCode(analysis, target)) {
+                    block->callee = analysis->blockOf[target];
+                }
+                break;
+            case Chip8_Flow_Skip:
+                chip8_analysisAddSuccessor(analysis, block, block->last + 2);
+                chip8_analysisAddSuccessor(analysis, block, block->last + 4);
+                break;
+            default:
+                break;
+        }
+    }
+    return true;
+}
+
+static bool chip8_analysisClassifyData(chip8Analysis_t* analysis) {
+    // every FX33 and FX55 is recorded first and only kept if it lands on code once all code is known
+    size_t writeCount = 0;
+    chip8AnalysisSite_t* writes = calloc(analysis->memSize, sizeof(chip8AnalysisSite_t));
+    if (writes == NULL) {
+        return false;
+    }
+
+    for (size_t i = 0; i < analysis->blockCount; i++) {
+        const chip8BasicBlock_t* block = &analysis->blocks[i];
+        long I = CHIP8_ANALYSIS_UNKNOWN_I;
+        for (size_t position = block->start; position <= block->last; position += 2) {
+            uint16_t opcode = chip8_analysisOpcode(analysis, position);
+            size_t X = (opcode & 0x0F00u) >> 8u;
+            switch (opcode & 0xF000u) {
+                case 0x2000:
+                    // the callee may move I
+                    I = CHIP8_ANALYSIS_UNKNOWN_I;
+                    break;
+                case 0xA000:
+                    I = opcode & 0x0FFFu;
+                    analysis->flags[I] |= CHIP8_ANALYSIS_REFERENCED;
+                    break;
+                case 0xD000:
+                    if (I != CHIP8_ANALYSIS_UNKNOWN_I) {
+                        chip8_analysisMark(analysis, (size_t)I, opcode & 0x000Fu, CHIP8_ANALYSIS_DATA);
+                    }
+                    break;
+                case 0xF000: {
+                    size_t length = 0;
+                    switch (opcode & 0x00FFu) {
+                        case 0x001E:
+                        case 0x0029:
+                            I = CHIP8_ANALYSIS_UNKNOWN_I;
+                            break;
+                        case 0x0065:
+                            if (I != CHIP8_ANALYSIS_UNKNOWN_I) {
+                                chip8_analysisMark(analysis, (size_t)I, X + 1, CHIP8_ANALYSIS_DATA);
+                            }
+                            break;
+                        case 0x0033:
+                            length = 3;
+                            break;
+                        case 0x0055:
+                            length = X + 1;
+                            break;
+                        default:
+                            break;
+                    }
+                    if (length > 0 && I != CHIP8_ANALYSIS_UNKNOWN_I) {
+                        chip8_analysisMark(analysis, (size_t)I, length, CHIP8_ANALYSIS_WRITTEN);
+                        writes[writeCount].instruction = (uint16_t)position;
+                        writes[writeCount].target = (uint16_t)I;
+                        writes[writeCount].length = (uint16_t)length;
+                        writeCount++;
+                    }
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < writeCount; i++) {
+        for (size_t address = writes[i].target;
+             address < (size_t)writes[i].target + writes[i].length && address < analysis->memSize; address++) {
+            if (analysis->flags[address] & (CHIP8_ANALYSIS_CODE | CHIP8_ANALYSIS_CODE_TAIL)) {
+                analysis->selfModifying[analysis->selfModifyingCount++] = writes[i];
+                break;
+            }
+        }
+    }
+    free(writes);
+    return true;
+}
+
+static bool chip8_analysisFindSubroutines(chip8Analysis_t* analysis) {
+    size_t entryCount = 0;
+    for (size_t address = 0; address < analysis->memSize; address++) {
+        if ((analysis->flags[address] & CHIP8_ANALYSIS_SUBROUTINE) && chip8_analysisIsCode(analysis, address)) {
+            entryCount++;
+        }
+    }
+
+    analysis->subroutines = calloc(entryCount > 0 ? entryCount : 1, sizeof(chip8Subroutine_t));
+    uint16_t* stack = malloc((analysis->blockCount + 1) * sizeof(uint16_t));
+    uint16_t* visited = calloc(analysis->blockCount + 1, sizeof(uint16_t));
+    if (analysis->subroutines == NULL || stack == NULL || visited == NULL) {
+        free(stack);
+        free(visited);
+        return false;
+    }
+
+    for (size_t address = 0; address < analysis->memSize; address++) {
+        if (!(analysis->flags[address] & CHIP8_ANALYSIS_SUBROUTINE) || !chip8_analysisIsCode(analysis, address)) {
+            continue;
+        }
+        uint16_t entryBlock = analysis->blockOf[address];
+        // stamp visited blocks with the subroutine number so the array never has to be cleared
+        uint16_t stamp = (uint16_t)(analysis->subroutineCount + 1);
+        chip8Subroutine_t* subroutine = &analysis->subroutines[analysis->subroutineCount++];
+        subroutine->entry = (uint16_t)address;
+        subroutine->low = (uint16_t)address;
+        subroutine->high = (uint16_t)address;
+
+        size_t count = 0;
+        stack[count++] = entryBlock;
+        visited[entryBlock] = stamp;
+        while (count > 0) {
+            const chip8BasicBlock_t* block = &analysis->blocks[stack[--count]];
+            subroutine->blockCount++;
+            if (block->start < subroutine->low) {
+                subroutine->low = block->start;
+            }
+            if (block->end > subroutine->high) {
+                subroutine->high = block->end;
+            }
+            if (block->exit == Chip8_Flow_Return) {
+                subroutine->returns = true;
+            }
+            for (uint8_t i = 0; i < block->successorCount; i++) {
+                if (visited[block->successors[i]] != stamp) {
+                    visited[block->successors[i]] = stamp;
+                    stack[count++] = block->successors[i];
+                }
+            }
+        }
+
+        for (size_t i = 0; i < analysis->blockCount; i++) {
+            if (analysis->blocks[i].exit == Chip8_Flow_Call && analysis->blocks[i].callee == entryBlock) {
+                subroutine->callSites++;
+            }
+        }
+    }
+
+    free(stack);
+    free(visited);
+    return true;
+}
+
+static bool chip8_analysisBitTest(const uint8_t* bits, size_t index) {
+    return (bits[index / 8] & (1u << (index % 8))) != 0;
+}
+
+static void chip8_analysisBitSet(uint8_t* bits, size_t index) {
+    bits[index / 8] |= (uint8_t)(1u << (index % 8));
+}
+
+static int chip8_analysisCompareLoops(const void* a, const void* b) {
+    return (int)((const chip8Loop_t*)a)->header - (int)((const chip8Loop_t*)b)->header;
+}
+
+static bool chip8_analysisFindLoops(chip8Analysis_t* analysis) {
+    size_t blockCount = analysis->blockCount;
+    size_t bitsetSize = blockCount / 8 + 1;
+    bool success = false;
+
+    // predecessors in compressed rows, calls only count as an edge to their return point
+    size_t* predecessorStart = calloc(blockCount + 1, sizeof(size_t));
+    uint16_t* predecessors = NULL;
+    uint8_t* color = calloc(blockCount + 1, sizeof(uint8_t));
+    // the search stack and the loop body walk above it never hold a block twice each
+    uint16_t* stackBlock = malloc(2 * (blockCount + 1) * sizeof(uint16_t));
+    uint8_t* stackEdge = malloc((blockCount + 1) * sizeof(uint8_t));
+    uint16_t* loopOf = malloc((blockCount + 1) * sizeof(uint16_t));
+    uint8_t** bodies = calloc(blockCount + 1, sizeof(uint8_t*));
+    analysis->loops = calloc(blockCount + 1, sizeof(chip8Loop_t));
+    if (predecessorStart == NULL || color == NULL || stackBlock == NULL || stackEdge == NULL || loopOf == NULL ||
+        bodies == NULL || analysis->loops == NULL) {
+        goto cleanup;
+    }
+
+    for (size_t i = 0; i < blockCount; i++) {
+        for (uint8_t j = 0; j < analysis->blocks[i].successorCount; j++) {
+            predecessorStart[analysis->blocks[i].successors[j] + 1]++;
+        }
+        loopOf[i] = CHIP8_ANALYSIS_NO_BLOCK;
+    }
+    for (size_t i = 0; i < blockCount; i++) {
+        predecessorStart[i + 1] += predecessorStart[i];
+    }
+    predecessors = malloc((predecessorStart[blockCount] + 1) * sizeof(uint16_t));
+    size_t* fill = calloc(blockCount + 1, sizeof(size_t));
+    if (predecessors == NULL || fill == NULL) {
+        free(fill);
+        goto cleanup;
+    }
+    for (size_t i = 0; i < blockCount; i++) {
+        for (uint8_t j = 0; j < analysis->blocks[i].successorCount; j++) {
+            uint16_t successor = analysis->blocks[i].successors[j];
+            predecessors[predecessorStart[successor] + fill[successor]++] = (uint16_t)i;
+        }
+    }
+    free(fill);
+
+    // depth first search, an edge to a block still on the stack closes a loop
+    enum { White, Grey, Black };
+    for (size_t root = 0; root < blockCount; root++) {
+        if (color[root] != White) {
+            continue;
+        }
+        size_t depth = 0;
+        stackBlock[depth] = (uint16_t)root;
+        stackEdge[depth] = 0;
+        depth++;
+        color[root] = Grey;
+        while (depth > 0) {
+            uint16_t current = stackBlock[depth - 1];
+            const chip8BasicBlock_t* block = &analysis->blocks[current];
+            if (stackEdge[depth - 1] == block->successorCount) {
+                color[current] = Black;
+                depth--;
+                continue;
+            }
+            uint16_t successor = block->successors[stackEdge[depth - 1]++];
+            if (color[successor] == White) {
+                color[successor] = Grey;
+                stackBlock[depth] = successor;
+                stackEdge[depth] = 0;
+                depth++;
+            } else if (color[successor] == Grey) {
+                // back edge from current to successor, loops sharing a header are merged
+                if (loopOf[successor] == CHIP8_ANALYSIS_NO_BLOCK) {
+                    bodies[analysis->loopCount] = calloc(bitsetSize, sizeof(uint8_t));
+                    if (bodies[analysis->loopCount] == NULL) {
+                        goto cleanup;
+                    }
+                    chip8_analysisBitSet(bodies[analysis->loopCount], successor);
+                    analysis->loops[analysis->loopCount].header = analysis->blocks[successor].start;
+                    analysis->loops[analysis->loopCount].latch = block->last;
+                    loopOf[successor] = (uint16_t)analysis->loopCount;
+                    analysis->loopCount++;
+                }
+                uint8_t* body = bodies[loopOf[successor]];
+                // the body is everything that reaches the latch without going through the header
+                size_t count = 0;
+                if (!chip8_analysisBitTest(body, current)) {
+                    chip8_analysisBitSet(body, current);
+                    stackBlock[depth + count++] = current;
+                }
+                while (count > 0) {
+                    uint16_t member = stackBlock[depth + --count];
+                    for (size_t p = predecessorStart[member]; p < predecessorStart[member + 1]; p++) {
+                        if (!chip8_analysisBitTest(body, predecessors[p])) {
+                            chip8_analysisBitSet(body, predecessors[p]);
+                            stackBlock[depth + count++] = predecessors[p];
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    for (size_t i = 0; i < analysis->loopCount; i++) {
+        chip8Loop_t* loop = &analysis->loops[i];
+        loop->low = loop->header;
+        loop->high = loop->header;
+        loop->depth = 1;
+        loop->innermost = true;
+        for (size_t b = 0; b < blockCount; b++) {
+            if (!chip8_analysisBitTest(bodies[i], b)) {
+                continue;
+            }
+            const chip8BasicBlock_t* block = &analysis->blocks[b];
+            loop->blockCount++;
+            if (block->start < loop->low) {
+                loop->low = block->start;
+            }
+            if (block->end > loop->high) {
+                loop->high = block->end;
+            }
+            if (block->exit == Chip8_Flow_Call) {
+                loop->hasCall = true;
+            }
+            for (size_t position = block->start; position <= block->last; position += 2) {
+                if ((analysis->memory[position] & 0xF0u) == 0xD0u) {
+                    loop->hasDraw = true;
+                }
+            }
+            if (loopOf[b] != CHIP8_ANALYSIS_NO_BLOCK && loopOf[b] != i) {
+                loop->innermost = false;
+                analysis->loops[loopOf[b]].depth++;
+            }
+        }
+    }
+    qsort(analysis->loops, analysis->loopCount, sizeof(chip8Loop_t), chip8_analysisCompareLoops);
+    success = true;
+
+cleanup:
+    if (bodies != NULL) {
+        for (size_t i = 0; i < analysis->loopCount; i++) {
+            free(bodies[i]);
+        }
+    }
+    free(bodies);
+    free(predecessorStart);
+    free(predecessors);
+    free(color);
+    free(stackBlock);
+    free(stackEdge);
+    free(loopOf);
+    return success;
+}
+
+chip8Analysis_t* chip8_analyse(const uint8_t* rom, size_t romSize) {
+    chip8Analysis_t* analysis = calloc(1, sizeof(chip8Analysis_t));
+    if (analysis == NULL) {
+        return NULL;
+    }
+    if (romSize > CHIP8_MAX_ROM_SIZE) {
+        romSize = CHIP8_MAX_ROM_SIZE;
+    }
+
+    analysis->memSize = CHIP8_MEM_SIZE;
+    analysis->memory = calloc(analysis->memSize, sizeof(uint8_t));
+    analysis->flags = calloc(analysis->memSize, sizeof(uint16_t));
+    analysis->blockOf = malloc(analysis->memSize * sizeof(uint16_t));
+    // every address is the site of one instruction at most, code at odd addresses included
+    analysis->selfModifying = calloc(analysis->memSize, sizeof(chip8AnalysisSite_t));
+    analysis->computedJumps = calloc(analysis->memSize, sizeof(chip8AnalysisSite_t));
+    analysis->invalid = calloc(analysis->memSize, sizeof(chip8AnalysisSite_t));
+    uint16_t* worklist = malloc(analysis->memSize * sizeof(uint16_t));
+    if (analysis->memory == NULL || analysis->flags == NULL || analysis->blockOf == NULL ||
+        analysis->selfModifying == NULL || analysis->computedJumps == NULL || analysis->invalid == NULL ||
+        worklist == NULL) {
+        free(worklist);
+        chip8_analysisDel(&analysis);
+        return NULL;
+    }
+    memcpy(&analysis->memory[CHIP8_PC_START], rom, romSize);
+    for (size_t i = 0; i < analysis->memSize; i++) {
+        analysis->blockOf[i] = CHIP8_ANALYSIS_NO_BLOCK;
+    }
+
+    chip8_analysisTraverse(analysis, worklist);
+    free(worklist);
+
+    if (!chip8_analysisBuildBlocks(analysis) || !chip8_analysisClassifyData(analysis) ||
+        !chip8_analysisFindSubroutines(analysis) || !chip8_analysisFindLoops(analysis)) {
+        chip8_analysisDel(&analysis);
+        return NULL;
+    }
+    return analysis;
+}
+
+void chip8_analysisDel(chip8Analysis_t** analysis) {
+    if (analysis != NULL && *analysis != NULL) {
+        free((*analysis)->memory);
+        free((*analysis)->flags);
+        free((*analysis)->blockOf);
+        free((*analysis)->blocks);
+        free((*analysis)->subroutines);
+        free((*analysis)->loops);
+        free((*analysis)->selfModifying);
+        free((*analysis)->computedJumps);
+        free((*analysis)->invalid);
+        free(*analysis);
+        *analysis = NULL;
+    }
+}
+
+void chip8_analysisReport(const chip8Analysis_t* analysis, FILE* out) {
+    size_t codeBytes = 0;
+    size_t dataBytes = 0;
+    size_t romEnd = CHIP8_PC_START;
+    for (size_t address = 0; address < analysis->memSize; address++) {
+        if (analysis->flags[address] & (CHIP8_ANALYSIS_CODE | CHIP8_ANALYSIS_CODE_TAIL)) {
+            codeBytes++;
+        } else if (analysis->flags[address] & CHIP8_ANALYSIS_DATA) {
+            dataBytes++;
+        }
+        if (analysis->memory[address] != 0 || (analysis->flags[address] & CHIP8_ANALYSIS_CODE_TAIL)) {
+            romEnd = address + 1;
+        }
+    }
+    fprintf(out, "%zu bytes of code in %zu basic blocks, %zu bytes of sprite data\n",
+            codeBytes, analysis->blockCount, dataBytes);
+
+    fprintf(out, "\nSubroutines: %zu\n", analysis->subroutineCount);
+    for (size_t i = 0; i < analysis->subroutineCount; i++) {
+        const chip8Subroutine_t* subroutine = &analysis->subroutines[i];
+        fprintf(out, "  0x%03X  spans 0x%03X-0x%03X  %u blocks  %u call sites%s\n", subroutine->entry,
+                subroutine->low, subroutine->high, subroutine->blockCount, subroutine->callSites,
+                subroutine->returns ? "" : "  never returns");
+    }
+
+    fprintf(out, "\nLoops: %zu\n", analysis->loopCount);
+    for (size_t i = 0; i < analysis->loopCount; i++) {
+        const chip8Loop_t* loop = &analysis->loops[i];
+        fprintf(out, "  0x%03X  spans 0x%03X-0x%03X  depth %u  %u blocks  latch 0x%03X%s%s%s\n", loop->header,
+                loop->low, loop->high, loop->depth, loop->blockCount, loop->latch,
+                loop->innermost ? "  innermost" : "", loop->hasCall ? "  calls" : "", loop->hasDraw ? "  draws" : "");
+    }
+
+    // innermost loops run the most instructions per frame, deepest first
+    fprintf(out, "\nHot loop candidates:\n");
+    for (uint16_t depth = (uint16_t)analysis->blockCount; depth > 0; depth--) {
+        for (size_t i = 0; i < analysis->loopCount; i++) {
+            const chip8Loop_t* loop = &analysis->loops[i];
+            if (loop->innermost && loop->depth == depth) {
+                fprintf(out, "  0x%03X  depth %u  %u bytes\n", loop->header, loop->depth,
+                        (unsigned int)(loop->high - loop->low));
+            }
+        }
+    }
+
+    fprintf(out, "\nComputed jumps: %zu\n", analysis->computedJumpCount);
+    for (size_t i = 0; i < analysis->computedJumpCount; i++) {
+        const chip8AnalysisSite_t* site = &analysis->computedJumps[i];
+        fprintf(out, "  0x%03X  base 0x%03X  %u jump table entries\n", site->instruction, site->target,
+                site->length);
+    }
+
+    fprintf(out, "\nSelf-modifying writes: %zu\n", analysis->selfModifyingCount);
+    for (size_t i = 0; i < analysis->selfModifyingCount; i++) {
+        const chip8AnalysisSite_t* site = &analysis->selfModifying[i];
+        fprintf(out, "  0x%03X  writes 0x%03X-0x%03X\n", site->instruction, site->target,
+                site->target + site->length - 1);
+    }
+
+    fprintf(out, "\nInvalid instructions reached: %zu\n", analysis->invalidCount);
+    for (size_t i = 0; i < analysis->invalidCount; i++) {
+        fprintf(out, "  0x%03X  0x%04X\n", analysis->invalid[i].instruction, analysis->invalid[i].target);
+    }
+
+    fprintf(out, "\nListing:\n");
+    char mnemonic[CHIP8_DISASSEMBLY_SIZE];
+    size_t address = CHIP8_PC_START;
+    while (address < romEnd) {
+        uint16_t flags = analysis->flags[address];
+        if (chip8_analysisIsCode(analysis, address)) {
+            if (flags & CHIP8_ANALYSIS_SUBROUTINE) {
+                fprintf(out, "sub_%03zX:\n", address);
+            } else if (flags & CHIP8_ANALYSIS_LEADER) {
+                fprintf(out, "L_%03zX:\n", address);
+            }
+            uint16_t opcode = chip8_analysisOpcode(analysis, address);
+            chip8_disassemble(opcode, mnemonic, sizeof(mnemonic));
+            fprintf(out, "  0x%03zX  %04X  %s%s\n", address, opcode, mnemonic,
+                    (flags & CHIP8_ANALYSIS_WRITTEN) ? "  ; overwritten at runtime" : "");
+            address += 2;
+        } else {
+            // up to 8 bytes of data per line
+            fprintf(out, "  0x%03zX  ", address);
+            size_t start = address;
+            while (address < romEnd && address - start < 8 && !chip8_analysisIsCode(analysis, address)) {
+                fprintf(out, "%02X ", analysis->memory[address]);
+                address++;
+            }
+            fprintf(out, " %s\n", (flags & CHIP8_ANALYSIS_DATA) ? "; sprite data" :
+                                  (flags & CHIP8_ANALYSIS_REFERENCED) ? "; referenced by ANNN" : "; unreached");
+        }
+    }
+}
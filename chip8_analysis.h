@@ -0,0 +1,130 @@
+#ifndef CHIP_8_CHIP8_ANALYSIS_H
+#define CHIP_8_CHIP8_ANALYSIS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+// Flags kept for every address of the analysed memory image
+#define CHIP8_ANALYSIS_CODE 0x01u           // First byte of a reachable instruction
+#define CHIP8_ANALYSIS_CODE_TAIL 0x02u      // Second byte of a reachable instruction
+#define CHIP8_ANALYSIS_DATA 0x04u           // Read through I by DXYN or FX65
+#define CHIP8_ANALYSIS_LEADER 0x08u         // Starts a basic block
+#define CHIP8_ANALYSIS_SUBROUTINE 0x10u     // Target of a 2NNN
+#define CHIP8_ANALYSIS_WRITTEN 0x20u        // Written through I by FX33 or FX55
+#define CHIP8_ANALYSIS_JUMP_TABLE 0x40u     // Entry of a jump table reached through BNNN
+#define CHIP8_ANALYSIS_REFERENCED 0x80u     // Target of an ANNN
+#define CHIP8_ANALYSIS_INVALID 0x100u      // Reachable word that is not an instruction, recorded in invalid
+
+#define CHIP8_ANALYSIS_NO_BLOCK 0xFFFFu
+#define CHIP8_ANALYSIS_MAX_JUMP_TABLE 128
+#define CHIP8_DISASSEMBLY_SIZE 32
+
+enum chip8_flowKind {
+    Chip8_Flow_Next,            // Falls through to the next instruction
+    Chip8_Flow_Jump,            // 1NNN (and 0NNN, which the interpreter treats as a jump)
+    Chip8_Flow_Call,            // 2NNN
+    Chip8_Flow_Return,          // 00EE
+    Chip8_Flow_Skip,            // 3XNN, 4XNN, 5XY0, 9XY0, EX9E and EXA1
+    Chip8_Flow_ComputedJump,    // BNNN
+    Chip8_Flow_Invalid          // Not an instruction the interpreter can decode
+};
+
+typedef struct {
+    uint16_t start;             // Address of the first instruction
+    uint16_t end;               // Address one past the last instruction
+    uint16_t last;              // Address of the last instruction
+    enum chip8_flowKind exit;   // How control leaves the block
+    uint16_t successors[2];     // Block indices control can continue at, the return point comes first for calls
+    uint8_t successorCount;     // Number of valid entries in successors
+    uint16_t callee;            // Block index of the called subroutine or CHIP8_ANALYSIS_NO_BLOCK
+} chip8BasicBlock_t;
+
+typedef struct {
+    uint16_t entry;             // Address of the subroutine
+    uint16_t low;               // Lowest address of any instruction in the subroutine
+    uint16_t high;              // Address one past the highest instruction in the subroutine
+    uint16_t blockCount;        // Number of basic blocks in the subroutine
+    uint16_t callSites;         // Number of 2NNN instructions calling it
+    bool returns;               // Whether a 00EE is reachable from the entry
+} chip8Subroutine_t;
+
+typedef struct {
+    uint16_t header;            // Address of the loop header
+    uint16_t latch;             // Address of the last instruction of the first back edge found
+    uint16_t low;               // Lowest address of any instruction in the loop
+    uint16_t high;              // Address one past the highest instruction in the loop
+    uint16_t blockCount;        // Number of basic blocks in the loop body
+    uint16_t depth;             // 1 for outermost loops
+    bool innermost;             // Whether no other loop is nested inside
+    bool hasCall;               // Whether the body calls a subroutine
+    bool hasDraw;               // Whether the body contains a DXYN
+} chip8Loop_t;
+
+typedef struct {
+    uint16_t instruction;       // Address of the writing or jumping instruction
+    uint16_t target;            // First address written or the base of the jump
+    uint16_t length;            // Number of bytes written or jump table entries found
+} chip8AnalysisSite_t;
+
+typedef struct {
+    size_t memSize;                         // Size of the analysed address space
+    uint8_t* memory;                        // Memory image the rom was analysed in
+    uint16_t* flags;                        // CHIP8_ANALYSIS_* flags for every address
+    uint16_t* blockOf;                      // Block index for each leader address or CHIP8_ANALYSIS_NO_BLOCK
+    chip8BasicBlock_t* blocks;              // Basic blocks ordered by start address
+    size_t blockCount;
+    chip8Subroutine_t* subroutines;         // Subroutines ordered by entry address
+    size_t subroutineCount;
+    chip8Loop_t* loops;                     // Loops ordered by header address
+    size_t loopCount;
+    chip8AnalysisSite_t* selfModifying;     // FX33/FX55 instructions writing over reachable code
+    size_t selfModifyingCount;
+    chip8AnalysisSite_t* computedJumps;     // BNNN instructions
+    size_t computedJumpCount;
+    chip8AnalysisSite_t* invalid;           // Reachable words that are not instructions
+    size_t invalidCount;
+} chip8Analysis_t;
+
+/**
+ * Classifies how an opcode transfers control
+ * @param opcode The opcode to classify
+ * @return The kind of control flow of the opcode
+ */
+enum chip8_flowKind chip8_flowOf(uint16_t opcode);
+
+/**
+ * Writes the mnemonic for an opcode into a buffer
+ * @param opcode The opcode to disassemble
+ * @param buffer The buffer to write to, CHIP8_DISASSEMBLY_SIZE bytes is always enough
+ * @param size The size of the buffer in bytes
+ */
+void chip8_disassemble(uint16_t opcode, char* buffer, size_t size);
+
+/**
+ * Builds the control flow graph of a rom loaded at CHIP8_PC_START
+ * Code is followed from CHIP8_PC_START through jumps, calls, returns and skips. Bytes read through an I set by
+ * ANNN in the same block are classified as data.
+ * @param rom The contents of the rom
+ * @param romSize The size of the rom in bytes
+ * @return A pointer to the analysis or NULL if it could not be allocated
+ */
+chip8Analysis_t* chip8_analyse(const uint8_t* rom, size_t romSize);
+
+/**
+ * Deallocates and frees an analysis
+ * It also nulls the pointer to the object during deletion
+ * @param analysis A pointer to the pointer to be freed of type chip8Analysis_t**
+ */
+void chip8_analysisDel(chip8Analysis_t** analysis);
+
+/**
+ * Writes a report of the subroutines, loop nests, computed jumps and self-modifying writes followed by a
+ * disassembly listing with block labels
+ * @param analysis A pointer to the analysis
+ * @param out The stream to write to
+ */
+void chip8_analysisReport(const chip8Analysis_t* analysis, FILE* out);
+
+#endif //CHIP_8_CHIP8_ANALYSIS_H
@@ -0,0 +1,200 @@
+#include <stdlib.h>
+#include <string.h>
+#include "chip8.h"
+#include "chip8_analysis.h"
+
+// instructions a fused run can hold, anything else needs the checks emulateCycle does between instructions
+static bool chip8_aotIsFusable(uint16_t opcode) {
+    switch (opcode & 0xF000u) {
+        case 0x6000:
+        case 0x7000:
+        case 0xA000:
+            return true;
+        case 0x8000: {
+            uint8_t operation = opcode & 0x000Fu;
+            return operation <= 0x7 || operation == 0xE;
+        }
+        case 0xF000:
+            return (opcode & 0x00FFu) == 0x001E || (opcode & 0x00FFu) == 0x0029;
+        default:
+            return false;
+    }
+}
+
+void chip8_aotPath(const char* directory, uint64_t romHash, char* buffer, size_t size) {
+    snprintf(buffer, size, "%s\\%016llx%s", directory, (unsigned long long)romHash, CHIP8_AOT_EXTENSION);
+}
+
+// checks that an artifact belongs to the rom and that every part of it lies inside the file
+static bool chip8_aotValidate(const uint8_t* data, size_t size, const chip8Rom_t* rom) {
+    if (size < sizeof(chip8AotHeader_t)) {
+        return false;
+    }
+    const chip8AotHeader_t* header = (const chip8AotHeader_t*)data;
+    if (memcmp(header->magic, CHIP8_AOT_MAGIC, CHIP8_AOT_MAGIC_SIZE) != 0 || header->version != CHIP8_AOT_VERSION ||
+        header->size != size || header->romHash != rom->hash || header->romSize != rom->size) {
+        return false;
+    }
+    uint64_t streamEnd = (uint64_t)header->streamOffset + header->romSize * sizeof(chip8AotInstruction_t);
+    uint64_t blocksEnd = (uint64_t)header->blocksOffset + header->blockCount * sizeof(chip8AotBlock_t);
+    uint64_t romEnd = (uint64_t)header->romOffset + header->romSize;
+    if (streamEnd > size || blocksEnd > size || romEnd > size ||
+        header->streamOffset % sizeof(uint32_t) != 0 || header->blocksOffset % sizeof(uint16_t) != 0) {
+        return false;
+    }
+    // the hash only finds the artifact, the rom itself decides whether it applies
+    return memcmp(data + header->romOffset, rom->data, rom->size) == 0;
+}
+
+chip8Aot_t* chip8_aotOpen(const char* directory, const chip8Rom_t* rom) {
+    char path[CHIP8_AOT_PATH_SIZE];
+    chip8_aotPath(directory, rom->hash, path, sizeof(path));
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        // roms that were never compiled run as they always did
+        return NULL;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart < (LONGLONG)sizeof(chip8AotHeader_t)) {
+        fprintf(stderr, "Ignoring truncated artifact %s\n", path);
+        CloseHandle(file);
+        return NULL;
+    }
+
+    // the view keeps the mapping alive so both handles can be closed once it exists
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (mapping == NULL) {
+        fprintf(stderr, "Failed to map artifact: %lu\n", GetLastError());
+        return NULL;
+    }
+    const uint8_t* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (data == NULL) {
+        fprintf(stderr, "Failed to map view of artifact: %lu\n", GetLastError());
+        return NULL;
+    }
+    if (!chip8_aotValidate(data, (size_t)fileSize.QuadPart, rom)) {
+        fprintf(stderr, "Ignoring stale artifact %s\n", path);
+        UnmapViewOfFile(data);
+        return NULL;
+    }
+
+    chip8Aot_t* aot = calloc(1, sizeof(chip8Aot_t));
+    if (aot == NULL) {
+        UnmapViewOfFile(data);
+        return NULL;
+    }
+    aot->data = data;
+    aot->header = (const chip8AotHeader_t*)data;
+    aot->stream = (const chip8AotInstruction_t*)(data + aot->header->streamOffset);
+    aot->blocks = (const chip8AotBlock_t*)(data + aot->header->blocksOffset);
+    aot->romSize = aot->header->romSize;
+    aot->references = 1;
+    return aot;
+}
+
+chip8Aot_t* chip8_aotRetain(chip8Aot_t* aot) {
+    InterlockedIncrement(&aot->references);
+    return aot;
+}
+
+void chip8_aotClose(chip8Aot_t** aot) {
+    if (aot != NULL && *aot != NULL) {
+        // machines of a fleet drop their reference on their own threads once their program writes over code
+        if (InterlockedDecrement(&(*aot)->references) == 0) {
+            UnmapViewOfFile((*aot)->data);
+            (*aot)->data = NULL;
+            free(*aot);
+        }
+        *aot = NULL;
+    }
+}
+
+chip8Aot_t* chip8_aotCompile(const char* directory, const chip8Rom_t* rom) {
+    chip8Analysis_t* analysis = chip8_analyse(rom->data, rom->size);
+    if (analysis == NULL) {
+        fprintf(stderr, "Failed to analyse rom\n");
+        return NULL;
+    }
+
+    size_t romSize = rom->size;
+    size_t streamOffset = sizeof(chip8AotHeader_t);
+    size_t blocksOffset = streamOffset + romSize * sizeof(chip8AotInstruction_t);
+    size_t romOffset = blocksOffset + analysis->blockCount * sizeof(chip8AotBlock_t);
+    size_t size = romOffset + romSize;
+    uint8_t* data = calloc(1, size);
+    if (data == NULL) {
+        fprintf(stderr, "Failed to allocate memory for artifact\n");
+        chip8_analysisDel(&analysis);
+        return NULL;
+    }
+    chip8AotHeader_t* header = (chip8AotHeader_t*)data;
+    chip8AotInstruction_t* stream = (chip8AotInstruction_t*)(data + streamOffset);
+    chip8AotBlock_t* blocks = (chip8AotBlock_t*)(data + blocksOffset);
+    memcpy(header->magic, CHIP8_AOT_MAGIC, CHIP8_AOT_MAGIC_SIZE);
+    header->version = CHIP8_AOT_VERSION;
+    header->size = (uint32_t)size;
+    header->romHash = rom->hash;
+    header->romSize = (uint32_t)romSize;
+    header->blockCount = (uint32_t)analysis->blockCount;
+    header->streamOffset = (uint32_t)streamOffset;
+    header->blocksOffset = (uint32_t)blocksOffset;
+    header->romOffset = (uint32_t)romOffset;
+    memcpy(data + romOffset, rom->data, romSize);
+
+    // walk backwards so every run can extend the one starting at the next instruction, the analysis only covers
+    // the memory of the original machine, anything past it is fetched as usual
+    for (size_t offset = romSize; offset-- > 0;) {
+        size_t address = CHIP8_PC_START + offset;
+        if (address >= analysis->memSize) {
+            continue;
+        }
+        chip8AotInstruction_t* entry = &stream[offset];
+        if (analysis->flags[address] & CHIP8_ANALYSIS_CODE_TAIL) {
+            entry->flags |= CHIP8_AOT_CODE_TAIL;
+        }
+        if ((analysis->flags[address] & CHIP8_ANALYSIS_CODE) == 0 || offset + 1 >= romSize) {
+            continue;
+        }
+        entry->flags |= CHIP8_AOT_CODE;
+        entry->opcode = (uint16_t)(rom->data[offset] << 8u | rom->data[offset + 1]);
+        if (!chip8_aotIsFusable(entry->opcode)) {
+            continue;
+        }
+        uint8_t next = offset + 2 < romSize && (stream[offset + 2].flags & CHIP8_AOT_CODE) ? stream[offset + 2].run : 0;
+        entry->run = (uint8_t)(next < CHIP8_AOT_MAX_RUN ? next + 1 : CHIP8_AOT_MAX_RUN);
+        if (entry->run > 1) {
+            header->fusedCount++;
+        }
+    }
+    for (size_t i = 0; i < analysis->blockCount; i++) {
+        const chip8BasicBlock_t* block = &analysis->blocks[i];
+        blocks[i].start = block->start;
+        blocks[i].end = block->end;
+        blocks[i].successorCount = block->successorCount;
+        blocks[i].exit = (uint8_t)block->exit;
+        for (int s = 0; s < block->successorCount; s++) {
+            blocks[i].successors[s] = analysis->blocks[block->successors[s]].start;
+        }
+    }
+    chip8_analysisDel(&analysis);
+
+    // written next to the artifact and moved over it, so processes loading the rom never see half a file
+    char path[CHIP8_AOT_PATH_SIZE];
+    char temporaryPath[CHIP8_AOT_PATH_SIZE + 16];
+    chip8_aotPath(directory, rom->hash, path, sizeof(path));
+    snprintf(temporaryPath, sizeof(temporaryPath), "%s.%lu", path, GetCurrentProcessId());
+    FILE* file = fopen(temporaryPath, "wb");
+    bool written = file != NULL && fwrite(data, 1, size, file) == size;
+    if (file != NULL && fclose(file) != 0) {
+        written = false;
+    }
+    free(data);
+    if (!written || !MoveFileExA(temporaryPath, path, MOVEFILE_REPLACE_EXISTING)) {
+        fprintf(stderr, "Failed to write artifact %s\n", path);
+        remove(temporaryPath);
+        return NULL;
+    }
+    return chip8_aotOpen(directory, rom);
+}
@@ -0,0 +1,121 @@
+#ifndef CHIP_8_CHIP8_AOT_H
+#define CHIP_8_CHIP8_AOT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <windows.h>
+#include "chip8_rom.h"
+
+#define CHIP8_AOT_MAGIC "C8AOT\0\0"     // 8 bytes with the terminator
+#define CHIP8_AOT_MAGIC_SIZE 8
+#define CHIP8_AOT_VERSION 1             // Bumped whenever the layout or the meaning of an entry changes
+#define CHIP8_AOT_EXTENSION ".c8aot"
+#define CHIP8_AOT_PATH_SIZE 512
+#define CHIP8_AOT_MAX_RUN 255           // Longest fused run an entry can describe
+#define CHIP8_AOT_ROM_START 0x200       // CHIP8_PC_START
+
+// Flags of an entry of the instruction stream
+#define CHIP8_AOT_CODE 0x01u            // First byte of an instruction the analysis found reachable
+#define CHIP8_AOT_CODE_TAIL 0x02u       // Second byte of a reachable instruction
+
+/*
+ * Layout of an artifact, every offset is from the start of the file and every integer is in the byte order of the
+ * machine that wrote it, artifacts are a local cache and not meant to be moved between machines
+ *   chip8AotHeader_t
+ *   romSize chip8AotInstruction_t, one per byte of the rom, the entry of address A is at A - CHIP8_AOT_ROM_START
+ *   blockCount chip8AotBlock_t ordered by start address
+ *   romSize bytes of the rom the artifact was compiled from
+ */
+
+typedef struct {
+    char magic[CHIP8_AOT_MAGIC_SIZE];
+    uint32_t version;
+    uint32_t size;              // Size of the whole artifact in bytes
+    uint64_t romHash;           // chip8_romHash of the rom, also the name of the artifact
+    uint32_t romSize;
+    uint32_t blockCount;
+    uint32_t fusedCount;        // Addresses a fused run of more than one instruction starts at
+    uint32_t streamOffset;
+    uint32_t blocksOffset;
+    uint32_t romOffset;
+} chip8AotHeader_t;
+
+typedef struct {
+    uint16_t opcode;            // Opcode at the address as loaded, valid for code addresses
+    uint8_t flags;              // CHIP8_AOT_* flags
+    uint8_t run;                // Instructions from here on that neither branch, wait, draw, read the timers or
+                                // keys nor touch memory, so they can run without the checks between cycles
+} chip8AotInstruction_t;
+
+typedef struct {
+    uint16_t start;             // Address of the first instruction
+    uint16_t end;               // Address one past the last instruction
+    uint16_t successors[2];     // Addresses control can continue at, see chip8BasicBlock_t
+    uint8_t successorCount;
+    uint8_t exit;               // enum chip8_flowKind of the last instruction
+} chip8AotBlock_t;
+
+typedef struct {
+    const uint8_t* data;        // Read-only view of the artifact file
+    const chip8AotHeader_t* header;
+    const chip8AotInstruction_t* stream;
+    const chip8AotBlock_t* blocks;
+    uint32_t romSize;           // Number of entries in stream
+    volatile LONG references;   // Holders of the artifact, machines of a fleet share one mapping
+} chip8Aot_t;
+
+/**
+ * Writes the file path of the artifact of a rom into a buffer
+ * @param directory The directory artifacts are kept in
+ * @param romHash The chip8_romHash of the rom
+ * @param buffer The buffer to write to, CHIP8_AOT_PATH_SIZE bytes is always enough for short directories
+ * @param size The size of the buffer in bytes
+ */
+void chip8_aotPath(const char* directory, uint64_t romHash, char* buffer, size_t size);
+
+/**
+ * Analyses a rom and writes its artifact to the directory, named after the hash of the rom
+ * @param directory The directory artifacts are kept in, it has to exist
+ * @param rom A pointer to the rom
+ * @return A pointer to the compiled artifact, opened from the written file, or NULL if it could not be written
+ */
+chip8Aot_t* chip8_aotCompile(const char* directory, const chip8Rom_t* rom);
+
+/**
+ * Maps the artifact of a rom if one was compiled, with a single read-only view of the file
+ * A missing artifact is not an error. One that does not match the rom byte for byte or was written by another
+ * version is ignored with a message, the rom then runs without it.
+ * @param directory The directory artifacts are kept in
+ * @param rom A pointer to the rom
+ * @return A pointer to the artifact or NULL if there is no valid one
+ */
+chip8Aot_t* chip8_aotOpen(const char* directory, const chip8Rom_t* rom);
+
+/**
+ * Adds a holder to an artifact, it stays mapped until every holder closed it
+ * @param aot A pointer to the artifact
+ * @return The same artifact
+ */
+chip8Aot_t* chip8_aotRetain(chip8Aot_t* aot);
+
+/**
+ * Lets go of an artifact, which is unmapped and freed once its last holder let go
+ * It also nulls the pointer to the object during deletion
+ * @param aot A pointer to the pointer to be freed of type chip8Aot_t**
+ */
+void chip8_aotClose(chip8Aot_t** aot);
+
+/**
+ * Returns the instruction stream entry of an address or NULL if the address is outside the rom
+ * @param aot A pointer to the artifact
+ * @param address The address
+ * @return A pointer to the entry
+ */
+static inline const chip8AotInstruction_t* chip8_aotAt(const chip8Aot_t* aot, uint16_t address) {
+    // addresses below the rom wrap around to offsets past its end
+    uint16_t offset = (uint16_t)(address - CHIP8_AOT_ROM_START);
+    return offset < aot->romSize ? &aot->stream[offset] : NULL;
+}
+
+#endif //CHIP_8_CHIP8_AOT_H
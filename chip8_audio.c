@@ -0,0 +1,91 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "chip8_audio.h"
+
+chip8Audio_t* chip8_audioInit(void) {
+    if (!al_restore_default_mixer()) {
+        fprintf(stderr, "Failed to create the default mixer!\n");
+        return NULL;
+    }
+
+    ALLEGRO_AUDIO_STREAM* stream = al_create_audio_stream(CHIP8_AUDIO_FRAGMENTS, CHIP8_AUDIO_FRAGMENT_SAMPLES,
+                                                          CHIP8_AUDIO_FREQUENCY, ALLEGRO_AUDIO_DEPTH_FLOAT32,
+                                                          ALLEGRO_CHANNEL_CONF_1);
+    if (stream == NULL) {
+        fprintf(stderr, "Failed to create audio stream!\n");
+        return NULL;
+    }
+    if (!al_attach_audio_stream_to_mixer(stream, al_get_default_mixer())) {
+        fprintf(stderr, "Failed to attach audio stream!\n");
+        al_destroy_audio_stream(stream);
+        return NULL;
+    }
+
+    chip8Audio_t* audio = calloc(1, sizeof(chip8Audio_t));
+    audio->stream = stream;
+    audio->phase = 0.0;
+    audio->gain = 0.0f;
+    return audio;
+}
+
+void chip8_audioDel(chip8Audio_t** audio) {
+    if (audio != NULL && *audio != NULL) {
+        al_destroy_audio_stream((*audio)->stream);
+        (*audio)->stream = NULL;
+        free(*audio);
+        *audio = NULL;
+    }
+}
+
+ALLEGRO_EVENT_SOURCE* chip8_audioEventSource(chip8Audio_t* audio) {
+    return al_get_audio_stream_event_source(audio->stream);
+}
+
+void chip8_audioFillFragment(chip8Audio_t* audio, bool toneOn) {
+    float* buffer = al_get_audio_stream_fragment(audio->stream);
+    if (buffer == NULL) {
+        return;
+    }
+
+    float target = toneOn ? CHIP8_AUDIO_VOLUME : 0.0f;
+    float step = CHIP8_AUDIO_VOLUME / CHIP8_AUDIO_RAMP_SAMPLES;
+    // the phase covers one period of the square wave or the whole pattern
+    double increment = audio->usePattern ? audio->patternRate / CHIP8_AUDIO_PATTERN_BITS / CHIP8_AUDIO_FREQUENCY
+                                         : CHIP8_AUDIO_TONE_HZ / CHIP8_AUDIO_FREQUENCY;
+    for (int i = 0; i < CHIP8_AUDIO_FRAGMENT_SAMPLES; i++) {
+        if (audio->gain < target) {
+            audio->gain = audio->gain + step > target ? target : audio->gain + step;
+        } else if (audio->gain > target) {
+            audio->gain = audio->gain - step < target ? target : audio->gain - step;
+        }
+        bool high;
+        if (audio->usePattern) {
+            int bit = (int)(audio->phase * CHIP8_AUDIO_PATTERN_BITS);
+            high = (audio->pattern[bit >> 3] & (0x80u >> (bit & 7))) != 0;
+        } else {
+            high = audio->phase < 0.5;
+        }
+        buffer[i] = high ? audio->gain : -audio->gain;
+        audio->phase += increment;
+        if (audio->phase >= 1.0) {
+            audio->phase -= 1.0;
+        }
+    }
+    al_set_audio_stream_fragment(audio->stream, buffer);
+}
+
+void chip8_audioSetPattern(chip8Audio_t* audio, const uint8_t* pattern, uint8_t pitch) {
+    memcpy(audio->pattern, pattern, CHIP8_AUDIO_PATTERN_BYTES);
+    audio->patternRate = CHIP8_AUDIO_PATTERN_RATE * pow(2.0, ((double)pitch - 64.0) / 48.0);
+    if (!audio->usePattern) {
+        // the phase meant one period of the square wave until now
+        audio->phase = 0.0;
+        audio->usePattern = true;
+    }
+}
+
+void chip8_audioSetPlaying(chip8Audio_t* audio, bool playing) {
+    al_set_audio_stream_playing(audio->stream, playing);
+}
@@ -0,0 +1,71 @@
+#ifndef CHIP_8_CHIP8_AUDIO_H
+#define CHIP_8_CHIP8_AUDIO_H
+
+#include <allegro5/allegro_audio.h>
+#include <stdbool.h>
+
+#define CHIP8_AUDIO_FREQUENCY 44100
+#define CHIP8_AUDIO_FRAGMENTS 4
+#define CHIP8_AUDIO_FRAGMENT_SAMPLES 256
+#define CHIP8_AUDIO_TONE_HZ 440.0
+#define CHIP8_AUDIO_VOLUME 0.25f
+#define CHIP8_AUDIO_RAMP_SAMPLES 64
+#define CHIP8_AUDIO_PATTERN_BYTES 16
+#define CHIP8_AUDIO_PATTERN_BITS (CHIP8_AUDIO_PATTERN_BYTES * 8)
+#define CHIP8_AUDIO_PATTERN_RATE 4000.0     // One bit samples per second at pitch 64
+
+typedef struct {
+    ALLEGRO_AUDIO_STREAM* stream;   // Stream the tone is generated into
+    double phase;                   // Position within the current square wave period, between 0 and 1
+    float gain;                     // Current amplitude, ramped towards the target to avoid clicks
+    bool usePattern;                // Whether the XO-CHIP pattern plays instead of the square wave
+    uint8_t pattern[CHIP8_AUDIO_PATTERN_BYTES]; // XO-CHIP pattern, most significant bit first
+    double patternRate;             // Bits of the pattern played per second
+} chip8Audio_t;
+
+/**
+ * Initializes and returns the audio backend, a mono stream of CHIP8_AUDIO_FRAGMENTS small fragments attached to the
+ * default mixer. Allegro audio must already be installed.
+ * @return A pointer to the created chip8Audio_t struct or NULL if no stream could be created
+ */
+chip8Audio_t* chip8_audioInit(void);
+
+/**
+ * Destroys the audio stream and frees the audio backend
+ * It also nulls the pointer to the object during deletion
+ * @param audio A pointer to the pointer to be freed of type chip8Audio_t**
+ */
+void chip8_audioDel(chip8Audio_t** audio);
+
+/**
+ * Returns the event source raising ALLEGRO_EVENT_AUDIO_STREAM_FRAGMENT whenever a fragment needs to be filled
+ * @param audio A pointer to the audio backend
+ * @return The event source of the audio stream
+ */
+ALLEGRO_EVENT_SOURCE* chip8_audioEventSource(chip8Audio_t* audio);
+
+/**
+ * Generates the next fragment of the stream. The tone is continuous across fragments and fades in and out over
+ * CHIP8_AUDIO_RAMP_SAMPLES, so toggling it never clicks.
+ * @param audio A pointer to the audio backend
+ * @param toneOn Whether the sound timer is running
+ */
+void chip8_audioFillFragment(chip8Audio_t* audio, bool toneOn);
+
+/**
+ * Replaces the square wave with an XO-CHIP audio pattern, played in a loop one bit per sample of
+ * CHIP8_AUDIO_PATTERN_RATE * 2^((pitch - 64) / 48) samples per second
+ * @param audio A pointer to the audio backend
+ * @param pattern The CHIP8_AUDIO_PATTERN_BYTES bytes of the pattern
+ * @param pitch The pitch set by FX3A
+ */
+void chip8_audioSetPattern(chip8Audio_t* audio, const uint8_t* pattern, uint8_t pitch);
+
+/**
+ * Starts or pauses the stream. A paused stream stops requesting fragments.
+ * @param audio A pointer to the audio backend
+ * @param playing Whether the stream should play
+ */
+void chip8_audioSetPlaying(chip8Audio_t* audio, bool playing);
+
+#endif //CHIP_8_CHIP8_AUDIO_H
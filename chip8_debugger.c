@@ -0,0 +1,328 @@
+#include <stdlib.h>
+#include "chip8_debugger.h"
+#include "chip8_analysis.h"
+
+const char* const chip8_conditionNames[CHIP8_CONDITIONS] = {"", "==", "!=", "<", ">", "<=", ">="};
+
+static uint16_t chip8_debuggerOpcodeAt(const chip8State_t* state, uint16_t address) {
+    return (uint16_t)(state->memory[address & state->memMask] << 8u | state->memory[(address + 1u) & state->memMask]);
+}
+
+static bool chip8_debuggerConditionHolds(const chip8Breakpoint_t* breakpoint, uint8_t value) {
+    switch (breakpoint->condition) {
+        case Chip8_Condition_Equal:
+            return value == breakpoint->value;
+        case Chip8_Condition_NotEqual:
+            return value != breakpoint->value;
+        case Chip8_Condition_Less:
+            return value < breakpoint->value;
+        case Chip8_Condition_Greater:
+            return value > breakpoint->value;
+        case Chip8_Condition_LessEqual:
+            return value <= breakpoint->value;
+        case Chip8_Condition_GreaterEqual:
+            return value >= breakpoint->value;
+        default:
+            return true;
+    }
+}
+
+static enum chip8_decodeState chip8_debuggerTrap(chip8State_t* state, uint16_t opcode);
+
+// points the dispatch entry of every class a breakpoint or watchpoint can stop at the trap
+static void chip8_debuggerPatch(chip8Debugger_t* debugger) {
+    chip8State_t* state = debugger->state;
+    bool trapped[CHIP8_DISPATCH_SIZE] = {false};
+    for (int i = 0; i < CHIP8_DEBUGGER_BREAKPOINTS; i++) {
+        if (debugger->breakpoints[i].used) {
+            trapped[chip8_debuggerOpcodeAt(state, debugger->breakpoints[i].address) >> 12u] = true;
+        }
+    }
+    for (int i = 0; i < CHIP8_DEBUGGER_WATCHPOINTS; i++) {
+        if (debugger->watchpoints[i].used) {
+            // FX33 and FX55
+            trapped[0xF] = true;
+        }
+    }
+    for (int i = 0; i < CHIP8_DISPATCH_SIZE; i++) {
+        state->dispatch[i] = trapped[i] ? &chip8_debuggerTrap : debugger->original[i];
+    }
+}
+
+static void chip8_debuggerClearBreakpoint(chip8Debugger_t* debugger, int index) {
+    chip8Breakpoint_t* breakpoint = &debugger->breakpoints[index];
+    breakpoint->used = false;
+    debugger->armed[breakpoint->address & debugger->state->memMask]--;
+}
+
+static int chip8_debuggerBreakpointHit(const chip8Debugger_t* debugger) {
+    const chip8State_t* state = debugger->state;
+    for (int i = 0; i < CHIP8_DEBUGGER_BREAKPOINTS; i++) {
+        const chip8Breakpoint_t* breakpoint = &debugger->breakpoints[i];
+        if (breakpoint->used && (breakpoint->address & state->memMask) == (state->PC & state->memMask) &&
+            (breakpoint->SP == CHIP8_DEBUGGER_ANY_SP || breakpoint->SP == state->SP) &&
+            chip8_debuggerConditionHolds(breakpoint, state->V[breakpoint->reg])) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int chip8_debuggerWatchpointHit(chip8Debugger_t* debugger, uint16_t opcode) {
+    const chip8State_t* state = debugger->state;
+    uint16_t length;
+    if ((opcode & 0x00FFu) == 0x33) {
+        length = 3;
+    } else if ((opcode & 0x00FFu) == 0x55) {
+        length = ((opcode & 0x0F00u) >> 8u) + 1;
+    } else {
+        return -1;
+    }
+    for (uint16_t offset = 0; offset < length; offset++) {
+        // the write wraps around memory the same way the instruction does
+        uint16_t address = (uint16_t)((state->I + offset) & state->memMask);
+        for (int i = 0; i < CHIP8_DEBUGGER_WATCHPOINTS; i++) {
+            const chip8Watchpoint_t* watchpoint = &debugger->watchpoints[i];
+            if (watchpoint->used && address >= watchpoint->address &&
+                address - watchpoint->address < watchpoint->length) {
+                debugger->watchAddress = address;
+                return i;
+            }
+        }
+    }
+    return -1;
+}
+
+static enum chip8_decodeState chip8_debuggerStop(chip8Debugger_t* debugger, enum chip8_stopReason reason, int hit) {
+    debugger->stopped = true;
+    debugger->reason = reason;
+    debugger->hit = hit;
+    debugger->stopInstruction = debugger->state->instructions;
+    debugger->stopPC = debugger->state->PC;
+    for (int i = 0; i < CHIP8_DEBUGGER_BREAKPOINTS; i++) {
+        if (debugger->breakpoints[i].used && debugger->breakpoints[i].temporary) {
+            chip8_debuggerClearBreakpoint(debugger, i);
+        }
+    }
+    // code may have been rewritten since the breakpoints were set
+    chip8_debuggerPatch(debugger);
+    return Chip8_Decode_State_Break;
+}
+
+// only ever called for the opcode classes a breakpoint or watchpoint can stop
+static enum chip8_decodeState chip8_debuggerTrap(chip8State_t* state, uint16_t opcode) {
+    chip8Debugger_t* debugger = state->debugger;
+    // the instruction execution stopped or resumed at runs when it resumes
+    if (state->instructions != debugger->stopInstruction || state->PC != debugger->stopPC) {
+        if (debugger->armed[state->PC & state->memMask] > 0) {
+            int hit = chip8_debuggerBreakpointHit(debugger);
+            if (hit >= 0) {
+                return chip8_debuggerStop(debugger, Chip8_Stop_Breakpoint, hit);
+            }
+        }
+        if ((opcode & 0xF000u) == 0xF000) {
+            int hit = chip8_debuggerWatchpointHit(debugger, opcode);
+            if (hit >= 0) {
+                return chip8_debuggerStop(debugger, Chip8_Stop_Watchpoint, hit);
+            }
+        }
+    }
+    return (*debugger->original[opcode >> 12u])(state, opcode);
+}
+
+chip8Debugger_t* chip8_debuggerInit(chip8State_t* state) {
+    chip8Debugger_t* debugger = calloc(1, sizeof(chip8Debugger_t));
+
+    debugger->state = state;
+    for (int i = 0; i < CHIP8_DISPATCH_SIZE; i++) {
+        debugger->original[i] = state->dispatch[i];
+    }
+    debugger->armed = calloc(state->memSize, sizeof(uint8_t));
+    // nothing has stopped yet, every instruction is checked
+    debugger->stopInstruction = UINT64_MAX;
+    debugger->stopPC = 0;
+    debugger->stopped = false;
+    debugger->reason = Chip8_Stop_None;
+    debugger->hit = -1;
+    state->debugger = debugger;
+
+    return debugger;
+}
+
+void chip8_debuggerDel(chip8Debugger_t** debugger) {
+    if (debugger != NULL && *debugger != NULL) {
+        chip8State_t* state = (*debugger)->state;
+        for (int i = 0; i < CHIP8_DISPATCH_SIZE; i++) {
+            state->dispatch[i] = (*debugger)->original[i];
+        }
+        state->debugger = NULL;
+        free((*debugger)->armed);
+        free(*debugger);
+        *debugger = NULL;
+    }
+}
+
+static int chip8_debuggerSetBreakpoint(chip8Debugger_t* debugger, uint16_t address, enum chip8_condition condition,
+                                       uint8_t reg, uint8_t value, bool temporary, int16_t SP) {
+    for (int i = 0; i < CHIP8_DEBUGGER_BREAKPOINTS; i++) {
+        chip8Breakpoint_t* breakpoint = &debugger->breakpoints[i];
+        if (!breakpoint->used) {
+            breakpoint->used = true;
+            breakpoint->address = address & debugger->state->memMask;
+            breakpoint->condition = condition;
+            breakpoint->reg = reg & 0x0Fu;
+            breakpoint->value = value;
+            breakpoint->temporary = temporary;
+            breakpoint->SP = SP;
+            debugger->armed[breakpoint->address]++;
+            chip8_debuggerPatch(debugger);
+            return i;
+        }
+    }
+    return -1;
+}
+
+int chip8_debuggerAddBreakpoint(chip8Debugger_t* debugger, uint16_t address, enum chip8_condition condition,
+                                uint8_t reg, uint8_t value) {
+    return chip8_debuggerSetBreakpoint(debugger, address, condition, reg, value, false, CHIP8_DEBUGGER_ANY_SP);
+}
+
+bool chip8_debuggerRemoveBreakpoint(chip8Debugger_t* debugger, int index) {
+    if (index < 0 || index >= CHIP8_DEBUGGER_BREAKPOINTS || !debugger->breakpoints[index].used) {
+        return false;
+    }
+    chip8_debuggerClearBreakpoint(debugger, index);
+    chip8_debuggerPatch(debugger);
+    return true;
+}
+
+int chip8_debuggerAddWatchpoint(chip8Debugger_t* debugger, uint16_t address, uint16_t length) {
+    for (int i = 0; i < CHIP8_DEBUGGER_WATCHPOINTS; i++) {
+        chip8Watchpoint_t* watchpoint = &debugger->watchpoints[i];
+        if (!watchpoint->used) {
+            watchpoint->used = true;
+            watchpoint->address = address & debugger->state->memMask;
+            watchpoint->length = length > 0 ? length : 1;
+            chip8_debuggerPatch(debugger);
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool chip8_debuggerRemoveWatchpoint(chip8Debugger_t* debugger, int index) {
+    if (index < 0 || index >= CHIP8_DEBUGGER_WATCHPOINTS || !debugger->watchpoints[index].used) {
+        return false;
+    }
+    debugger->watchpoints[index].used = false;
+    chip8_debuggerPatch(debugger);
+    return true;
+}
+
+static void chip8_debuggerResume(chip8Debugger_t* debugger) {
+    // whatever stopped at PC, a trap, a step or nothing at all, its instruction runs first
+    debugger->stopInstruction = debugger->state->instructions;
+    debugger->stopPC = debugger->state->PC;
+    debugger->stopped = false;
+    debugger->reason = Chip8_Stop_None;
+    debugger->hit = -1;
+}
+
+bool chip8_debuggerContinue(chip8Debugger_t* debugger, uint64_t maxCycles) {
+    chip8_debuggerResume(debugger);
+    for (uint64_t i = 0; i < maxCycles; i++) {
+        if (!chip8_emulateCycle(debugger->state)) {
+            return false;
+        }
+        if (debugger->stopped) {
+            return true;
+        }
+    }
+    // ran out of cycles, a step over that did not return yet is abandoned
+    for (int i = 0; i < CHIP8_DEBUGGER_BREAKPOINTS; i++) {
+        if (debugger->breakpoints[i].used && debugger->breakpoints[i].temporary) {
+            chip8_debuggerClearBreakpoint(debugger, i);
+        }
+    }
+    chip8_debuggerPatch(debugger);
+    return true;
+}
+
+bool chip8_debuggerStep(chip8Debugger_t* debugger) {
+    chip8_debuggerResume(debugger);
+    return chip8_emulateCycle(debugger->state);
+}
+
+bool chip8_debuggerStepOver(chip8Debugger_t* debugger, uint64_t maxCycles) {
+    chip8State_t* state = debugger->state;
+    if (state->waitingForKey || (chip8_debuggerOpcodeAt(state, state->PC) & 0xF000u) != 0x2000) {
+        return chip8_debuggerStep(debugger);
+    }
+    // 00EE comes back to the instruction after the call at the same stack depth, recursion goes deeper first
+    if (chip8_debuggerSetBreakpoint(debugger, (uint16_t)(state->PC + 2), Chip8_Condition_Always, 0, 0, true,
+                                    (int16_t)state->SP) < 0) {
+        fprintf(stderr, "Every breakpoint is in use\n");
+        return chip8_debuggerStep(debugger);
+    }
+    return chip8_debuggerContinue(debugger, maxCycles);
+}
+
+void chip8_debuggerPrintRegisters(const chip8Debugger_t* debugger, FILE* out) {
+    const chip8State_t* state = debugger->state;
+    for (int i = 0; i < CHIP8_REGISTERS_SIZE; i++) {
+        fprintf(out, "V%X=%02X%s", i, state->V[i], i % 8 == 7 ? "\n" : " ");
+    }
+    fprintf(out, "I=%04X PC=%04X SP=%X DT=%02X ST=%02X", state->I, state->PC, state->SP, state->delay, state->sound);
+    if (state->waitingForKey) {
+        fprintf(out, " waiting for a key into V%X", state->waitRegister);
+    }
+    fprintf(out, "\n%llu instructions, %llu frames\n", (unsigned long long)state->instructions,
+            (unsigned long long)state->frames);
+}
+
+void chip8_debuggerPrintStack(const chip8Debugger_t* debugger, FILE* out) {
+    const chip8State_t* state = debugger->state;
+    if (state->SP == 0) {
+        fprintf(out, "stack is empty\n");
+        return;
+    }
+    for (int i = state->SP - 1; i >= 0; i--) {
+        // the stack holds the address of the 2NNN, 00EE returns past it
+        fprintf(out, "#%-2d called from 0x%04X, returns to 0x%04X\n", state->SP - 1 - i, state->stack[i],
+                (state->stack[i] + 2) & state->memMask);
+    }
+}
+
+void chip8_debuggerPrintDisassembly(const chip8Debugger_t* debugger, uint16_t address, int count, FILE* out) {
+    const chip8State_t* state = debugger->state;
+    char mnemonic[CHIP8_DISASSEMBLY_SIZE];
+    for (int i = 0; i < count; i++) {
+        uint16_t at = (uint16_t)((address + 2 * i) & state->memMask);
+        uint16_t opcode = chip8_debuggerOpcodeAt(state, at);
+        chip8_disassemble(opcode, mnemonic, sizeof(mnemonic));
+        fprintf(out, "%s%c 0x%04X  %04X  %s\n", at == (state->PC & state->memMask) ? "=>" : "  ",
+                debugger->armed[at] > 0 ? '*' : ' ', at, opcode, mnemonic);
+    }
+}
+
+void chip8_debuggerPrintPoints(const chip8Debugger_t* debugger, FILE* out) {
+    for (int i = 0; i < CHIP8_DEBUGGER_BREAKPOINTS; i++) {
+        const chip8Breakpoint_t* breakpoint = &debugger->breakpoints[i];
+        if (!breakpoint->used || breakpoint->temporary) {
+            continue;
+        }
+        fprintf(out, "breakpoint %d at 0x%04X", i, breakpoint->address);
+        if (breakpoint->condition != Chip8_Condition_Always) {
+            fprintf(out, " if V%X %s %02X", breakpoint->reg, chip8_conditionNames[breakpoint->condition],
+                    breakpoint->value);
+        }
+        fprintf(out, "\n");
+    }
+    for (int i = 0; i < CHIP8_DEBUGGER_WATCHPOINTS; i++) {
+        const chip8Watchpoint_t* watchpoint = &debugger->watchpoints[i];
+        if (watchpoint->used) {
+            fprintf(out, "watchpoint %d on 0x%04X-0x%04X\n", i, watchpoint->address,
+                    watchpoint->address + watchpoint->length - 1);
+        }
+    }
+}
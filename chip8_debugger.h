@@ -0,0 +1,164 @@
+#ifndef CHIP_8_CHIP8_DEBUGGER_H
+#define CHIP_8_CHIP8_DEBUGGER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "chip8.h"
+
+#define CHIP8_DEBUGGER_BREAKPOINTS 32
+#define CHIP8_DEBUGGER_WATCHPOINTS 16
+#define CHIP8_DEBUGGER_ANY_SP -1
+#define CHIP8_CONDITIONS 7
+
+enum chip8_condition{ Chip8_Condition_Always, Chip8_Condition_Equal, Chip8_Condition_NotEqual, Chip8_Condition_Less,
+                      Chip8_Condition_Greater, Chip8_Condition_LessEqual, Chip8_Condition_GreaterEqual };
+
+// the operator of every condition, empty for Chip8_Condition_Always
+extern const char* const chip8_conditionNames[CHIP8_CONDITIONS];
+
+enum chip8_stopReason{ Chip8_Stop_None, Chip8_Stop_Breakpoint, Chip8_Stop_Watchpoint };
+
+typedef struct {
+    bool used;
+    uint16_t address;           // Address of the instruction to stop before
+    enum chip8_condition condition; // Comparison of V[reg] with value that has to hold to stop
+    uint8_t reg;
+    uint8_t value;
+    bool temporary;             // Removed on the next stop, step over uses these
+    int16_t SP;                 // Stack pointer to stop at or CHIP8_DEBUGGER_ANY_SP
+} chip8Breakpoint_t;
+
+typedef struct {
+    bool used;
+    uint16_t address;           // First watched byte
+    uint16_t length;            // Number of watched bytes
+} chip8Watchpoint_t;
+
+typedef struct chip8Debugger {
+    chip8State_t* state;        // The machine the debugger is attached to
+    chip8DecodeFn_t original[CHIP8_DISPATCH_SIZE]; // Dispatch table of the machine before it was patched
+    chip8Breakpoint_t breakpoints[CHIP8_DEBUGGER_BREAKPOINTS];
+    chip8Watchpoint_t watchpoints[CHIP8_DEBUGGER_WATCHPOINTS];
+    uint8_t* armed;             // Breakpoints per address, memSize entries
+    uint64_t stopInstruction;   // Instruction count when execution last stopped or resumed
+    uint16_t stopPC;            // PC when execution last stopped or resumed, traps let that instruction through
+    bool stopped;               // Whether a trap stopped execution since it resumed
+    enum chip8_stopReason reason;
+    int hit;                    // Index of the breakpoint or watchpoint that stopped execution
+    uint16_t watchAddress;      // The watched address the stopping instruction was about to write
+} chip8Debugger_t;
+
+/**
+ * Initializes a debugger and attaches it to a machine
+ * Breakpoints and watchpoints replace the dispatch table entries of the opcode classes they can stop, every other
+ * class keeps calling its decode function directly. Without any breakpoints the machine runs exactly as fast as
+ * without a debugger.
+ * @param state A pointer to the state for chip 8
+ * @return A pointer to the created chip8Debugger_t struct
+ */
+chip8Debugger_t* chip8_debuggerInit(chip8State_t* state);
+
+/**
+ * Detaches a debugger from its machine, restoring the dispatch table, and frees it
+ * It also nulls the pointer to the object during deletion
+ * @param debugger A pointer to the pointer to be freed of type chip8Debugger_t**
+ */
+void chip8_debuggerDel(chip8Debugger_t** debugger);
+
+/**
+ * Adds a breakpoint that stops before the instruction at an address is executed
+ * The opcode class is taken from the instruction at the address when the breakpoint is added and whenever execution
+ * stops, a breakpoint on code rewritten to another class in between is missed.
+ * @param debugger A pointer to the debugger
+ * @param address The address of the instruction
+ * @param condition Chip8_Condition_Always or the comparison of V[reg] with value that has to hold to stop
+ * @param reg The register compared by the condition
+ * @param value The value compared by the condition
+ * @return The index of the breakpoint or -1 if every breakpoint is in use
+ */
+int chip8_debuggerAddBreakpoint(chip8Debugger_t* debugger, uint16_t address, enum chip8_condition condition,
+                                uint8_t reg, uint8_t value);
+
+/**
+ * Removes a breakpoint
+ * @param debugger A pointer to the debugger
+ * @param index The index returned by chip8_debuggerAddBreakpoint
+ * @return If there was a breakpoint with the index
+ */
+bool chip8_debuggerRemoveBreakpoint(chip8Debugger_t* debugger, int index);
+
+/**
+ * Adds a watchpoint that stops before FX33 or FX55 writes to any of the watched bytes
+ * @param debugger A pointer to the debugger
+ * @param address The first watched byte
+ * @param length The number of watched bytes
+ * @return The index of the watchpoint or -1 if every watchpoint is in use
+ */
+int chip8_debuggerAddWatchpoint(chip8Debugger_t* debugger, uint16_t address, uint16_t length);
+
+/**
+ * Removes a watchpoint
+ * @param debugger A pointer to the debugger
+ * @param index The index returned by chip8_debuggerAddWatchpoint
+ * @return If there was a watchpoint with the index
+ */
+bool chip8_debuggerRemoveWatchpoint(chip8Debugger_t* debugger, int index);
+
+/**
+ * Runs cycles until a breakpoint or watchpoint stops execution
+ * The instruction at PC runs even if a breakpoint is set on it, so continuing after a stop or a step makes progress.
+ * @param debugger A pointer to the debugger
+ * @param maxCycles The number of cycles to run at most
+ * @return If every cycle was successful
+ */
+bool chip8_debuggerContinue(chip8Debugger_t* debugger, uint64_t maxCycles);
+
+/**
+ * Runs a single cycle, which executes the instruction at PC unless FX0A is waiting for a key
+ * @param debugger A pointer to the debugger
+ * @return If the cycle was successful
+ */
+bool chip8_debuggerStep(chip8Debugger_t* debugger);
+
+/**
+ * Runs a whole subroutine if the instruction at PC is 2NNN and a single cycle otherwise
+ * The subroutine runs until it returns to the same stack depth, or until another breakpoint stops it.
+ * @param debugger A pointer to the debugger
+ * @param maxCycles The number of cycles to run at most
+ * @return If every cycle was successful
+ */
+bool chip8_debuggerStepOver(chip8Debugger_t* debugger, uint64_t maxCycles);
+
+/**
+ * Writes the registers, I, PC, SP and the timers
+ * @param debugger A pointer to the debugger
+ * @param out The stream to write to
+ */
+void chip8_debuggerPrintRegisters(const chip8Debugger_t* debugger, FILE* out);
+
+/**
+ * Writes the return addresses on the stack, innermost first
+ * @param debugger A pointer to the debugger
+ * @param out The stream to write to
+ */
+void chip8_debuggerPrintStack(const chip8Debugger_t* debugger, FILE* out);
+
+/**
+ * Writes the disassembly of consecutive instructions, marking PC and breakpoints
+ * @param debugger A pointer to the debugger
+ * @param address The address of the first instruction
+ * @param count The number of instructions
+ * @param out The stream to write to
+ */
+void chip8_debuggerPrintDisassembly(const chip8Debugger_t* debugger, uint16_t address, int count, FILE* out);
+
+/**
+ * Writes the breakpoints and watchpoints
+ * @param debugger A pointer to the debugger
+ * @param out The stream to write to
+ */
+void chip8_debuggerPrintPoints(const chip8Debugger_t* debugger, FILE* out);
+
+#endif //CHIP_8_CHIP8_DEBUGGER_H
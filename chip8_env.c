@@ -0,0 +1,313 @@
+#include <stdlib.h>
+#include <string.h>
+#include "chip8_env.h"
+
+static int32_t chip8_envRead(const chip8State_t* state, uint16_t address, enum chip8_envValue format) {
+    const uint8_t* memory = state->memory;
+    uint32_t mask = state->memMask;
+    switch (format) {
+        case Chip8_Env_Value_Word:
+            return memory[address & mask] << 8u | memory[(address + 1u) & mask];
+        case Chip8_Env_Value_Bcd:
+            return memory[address & mask] * 100 + memory[(address + 1u) & mask] * 10 + memory[(address + 2u) & mask];
+        default:
+            return memory[address & mask];
+    }
+}
+
+static float chip8_envScore(const chip8Env_t* env, const chip8State_t* state) {
+    float score = 0.0f;
+    for (int i = 0; i < env->rewardCount; i++) {
+        score += env->rewards[i].weight * (float)chip8_envRead(state, env->rewards[i].address, env->rewards[i].format);
+    }
+    return score;
+}
+
+static bool chip8_envIsDone(const chip8Env_t* env, const chip8State_t* state) {
+    for (int i = 0; i < env->doneCount; i++) {
+        if (chip8_envRead(state, env->dones[i].address, env->dones[i].format) == env->dones[i].value) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void chip8_envObserve(const chip8Env_t* env, const chip8State_t* state, uint8_t* observation) {
+    if (env->observation == Chip8_Env_Observation_Packed) {
+        memcpy(observation, state->display, CHIP8_ENV_PACKED_SIZE);
+        return;
+    }
+    int width = chip8_envObservationWidth(env);
+    int height = chip8_envObservationHeight(env);
+    // a low resolution display on a machine with a high resolution one fills the observation with 2x2 pixels
+    int scale = width / state->width;
+    for (int y = 0; y < height; y++) {
+        int row = y / scale;
+        const uint64_t* first = chip8_displayRow(state, 0, row);
+        const uint64_t* second = chip8_displayRow(state, 1, row);
+        uint8_t* out = &observation[(size_t)y * width];
+        for (int x = 0; x < width; x++) {
+            int column = x / scale;
+            unsigned shift = 63u - (column & 63u);
+            out[x] = (uint8_t)(((first[column >> 6u] >> shift) & 1u) | ((second[column >> 6u] >> shift) & 1u) << 1u);
+        }
+    }
+}
+
+// starts a new episode, the generator is reseeded so an episode only depends on the seed, the instance and its number
+static void chip8_envResetInstance(chip8Env_t* env, int index) {
+    chip8EnvInstance_t* instance = &env->instances[index];
+    chip8_reset(instance->state);
+    chip8_loadRom(instance->state, env->rom);
+    chip8_attachAot(instance->state, env->aot);
+    instance->state->vipTiming = env->vipTiming;
+    uint32_t seed = env->seed ^ (uint32_t)index * 0x9E3779B9u ^ instance->episodes * 0x85EBCA6Bu;
+    chip8_seedRandom(instance->state, seed);
+    instance->keys = 0;
+    instance->frames = 0;
+    instance->episodes++;
+    instance->score = chip8_envScore(env, instance->state);
+}
+
+static void chip8_envStepInstance(chip8Env_t* env, int index) {
+    chip8EnvInstance_t* instance = &env->instances[index];
+    chip8State_t* state = instance->state;
+    uint16_t keys = env->actions != NULL ? env->actions[index] : 0;
+    // only changes are queued, so FX0A sees every press and release
+    uint16_t changed = keys ^ instance->keys;
+    for (int key = 0; changed != 0; key++, changed >>= 1u) {
+        if (changed & 1u) {
+            chip8_queueKey(state, key, (keys >> key) & 1u);
+        }
+    }
+    instance->keys = keys;
+
+    enum chip8_envDone done = Chip8_Env_Done_None;
+    for (int frame = 0; frame < env->frameSkip && done == Chip8_Env_Done_None; frame++) {
+        if (!(env->vipTiming ? chip8_emulateVipFrame(state) : chip8_emulateFrame(state))) {
+            done = Chip8_Env_Done_Fault;
+        } else if (chip8_envIsDone(env, state)) {
+            done = Chip8_Env_Done_Terminated;
+        } else if (++instance->frames == env->maxFrames) {
+            done = Chip8_Env_Done_Truncated;
+        }
+        state->drawFlag = false;
+    }
+    float score = chip8_envScore(env, state);
+    if (env->rewardsOut != NULL) {
+        env->rewardsOut[index] = score - instance->score;
+    }
+    instance->score = score;
+    if (env->donesOut != NULL) {
+        env->donesOut[index] = (uint8_t)done;
+    }
+    if (done != Chip8_Env_Done_None) {
+        chip8_envResetInstance(env, index);
+    }
+    if (env->observations != NULL) {
+        chip8_envObserve(env, state, &env->observations[index * chip8_envObservationSize(env)]);
+    }
+}
+
+static void chip8_envRunSlice(chip8EnvWorker_t* worker) {
+    for (int i = worker->first; i < worker->first + worker->count; i++) {
+        chip8_envStepInstance(worker->env, i);
+    }
+}
+
+static DWORD WINAPI chip8_envWork(LPVOID parameter) {
+    chip8EnvWorker_t* worker = parameter;
+    while (1) {
+        WaitForSingleObject(worker->start, INFINITE);
+        if (worker->env->stopping) {
+            return 0;
+        }
+        chip8_envRunSlice(worker);
+        ReleaseSemaphore(worker->env->finished, 1, NULL);
+    }
+}
+
+// runs every slice, the calling thread takes the first one
+static void chip8_envRunAll(chip8Env_t* env) {
+    for (int i = 1; i < env->workerCount; i++) {
+        SetEvent(env->workers[i].start);
+    }
+    chip8_envRunSlice(&env->workers[0]);
+    for (int i = 1; i < env->workerCount; i++) {
+        WaitForSingleObject(env->finished, INFINITE);
+    }
+}
+
+chip8Env_t* chip8_envInit(const char* romPath, int machine, int instanceCount, int workerCount, int frameSkip,
+                          uint32_t seed) {
+    if (instanceCount < 1 || frameSkip < 1 || machine < Chip8_Machine_Chip8 || machine > Chip8_Machine_XoChip) {
+        fprintf(stderr, "Invalid environment parameters\n");
+        return NULL;
+    }
+    chip8Rom_t* rom = chip8_romOpen(romPath, CHIP8_XO_MAX_ROM_SIZE);
+    if (rom == NULL) {
+        return NULL;
+    }
+    if (workerCount < 1) {
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        workerCount = (int)info.dwNumberOfProcessors;
+    }
+    if (workerCount > CHIP8_ENV_MAX_WORKERS) {
+        workerCount = CHIP8_ENV_MAX_WORKERS;
+    }
+    if (workerCount > instanceCount) {
+        workerCount = instanceCount;
+    }
+
+    chip8Env_t* env = calloc(1, sizeof(chip8Env_t));
+    env->rom = rom;
+    env->aot = chip8_aotOpen(CHIP8_AOT_DIR, rom);
+    env->machine = (enum chip8_machine)machine;
+    env->instanceCount = instanceCount;
+    env->frameSkip = frameSkip;
+    env->seed = seed;
+    env->observation = Chip8_Env_Observation_Unpacked;
+    env->instances = calloc((size_t)instanceCount, sizeof(chip8EnvInstance_t));
+    for (int i = 0; i < instanceCount; i++) {
+        env->instances[i].state = chip8_initMachine(env->machine, NULL);
+        if (!chip8_loadRom(env->instances[i].state, rom)) {
+            env->workerCount = 0;
+            chip8_envDel(&env);
+            return NULL;
+        }
+    }
+
+    // contiguous slices, the first instanceCount % workerCount workers take one more
+    env->workerCount = workerCount;
+    env->finished = CreateSemaphoreA(NULL, 0, CHIP8_ENV_MAX_WORKERS, NULL);
+    int first = 0;
+    for (int i = 0; i < workerCount; i++) {
+        chip8EnvWorker_t* worker = &env->workers[i];
+        worker->env = env;
+        worker->first = first;
+        worker->count = instanceCount / workerCount + (i < instanceCount % workerCount ? 1 : 0);
+        first += worker->count;
+        if (i > 0) {
+            worker->start = CreateEventA(NULL, FALSE, FALSE, NULL);
+            worker->thread = CreateThread(NULL, 0, chip8_envWork, worker, 0, NULL);
+            if (worker->thread == NULL) {
+                fprintf(stderr, "Failed to start environment worker %d\n", i);
+                CloseHandle(worker->start);
+                env->workerCount = i;
+                chip8_envDel(&env);
+                return NULL;
+            }
+        }
+    }
+    for (int i = 0; i < instanceCount; i++) {
+        chip8_envResetInstance(env, i);
+    }
+    return env;
+}
+
+void chip8_envDel(chip8Env_t** env) {
+    if (env != NULL && *env != NULL) {
+        chip8Env_t* batch = *env;
+        InterlockedExchange(&batch->stopping, 1);
+        for (int i = 1; i < batch->workerCount; i++) {
+            SetEvent(batch->workers[i].start);
+            WaitForSingleObject(batch->workers[i].thread, INFINITE);
+            CloseHandle(batch->workers[i].thread);
+            CloseHandle(batch->workers[i].start);
+        }
+        if (batch->finished != NULL) {
+            CloseHandle(batch->finished);
+        }
+        for (int i = 0; i < batch->instanceCount; i++) {
+            if (batch->instances[i].state != NULL) {
+                chip8_del(&batch->instances[i].state);
+            }
+        }
+        free(batch->instances);
+        chip8_aotClose(&batch->aot);
+        chip8_romClose(&batch->rom);
+        free(batch);
+        *env = NULL;
+    }
+}
+
+bool chip8_envAddReward(chip8Env_t* env, uint16_t address, int format, float weight) {
+    if (env->rewardCount == CHIP8_ENV_MAX_REWARDS) {
+        fprintf(stderr, "Too many reward values\n");
+        return false;
+    }
+    env->rewards[env->rewardCount].address = address;
+    env->rewards[env->rewardCount].format = (enum chip8_envValue)format;
+    env->rewards[env->rewardCount].weight = weight;
+    env->rewardCount++;
+    // the next step rewards changes from here on
+    for (int i = 0; i < env->instanceCount; i++) {
+        env->instances[i].score = chip8_envScore(env, env->instances[i].state);
+    }
+    return true;
+}
+
+bool chip8_envAddDone(chip8Env_t* env, uint16_t address, int format, int32_t value) {
+    if (env->doneCount == CHIP8_ENV_MAX_DONES) {
+        fprintf(stderr, "Too many done conditions\n");
+        return false;
+    }
+    env->dones[env->doneCount].address = address;
+    env->dones[env->doneCount].format = (enum chip8_envValue)format;
+    env->dones[env->doneCount].value = value;
+    env->doneCount++;
+    return true;
+}
+
+void chip8_envSetMaxFrames(chip8Env_t* env, uint32_t maxFrames) {
+    env->maxFrames = maxFrames;
+}
+
+void chip8_envSetVipTiming(chip8Env_t* env, bool vipTiming) {
+    env->vipTiming = vipTiming;
+    for (int i = 0; i < env->instanceCount; i++) {
+        env->instances[i].state->vipTiming = vipTiming;
+    }
+}
+
+void chip8_envSetObservation(chip8Env_t* env, int observation) {
+    env->observation = (enum chip8_envObservation)observation;
+}
+
+size_t chip8_envObservationSize(const chip8Env_t* env) {
+    if (env->observation == Chip8_Env_Observation_Packed) {
+        return CHIP8_ENV_PACKED_SIZE;
+    }
+    return (size_t)chip8_envObservationWidth(env) * chip8_envObservationHeight(env);
+}
+
+int chip8_envObservationWidth(const chip8Env_t* env) {
+    return env->machine == Chip8_Machine_Chip8 ? CHIP8_GRAPHICS_WIDTH : CHIP8_HIRES_WIDTH;
+}
+
+int chip8_envObservationHeight(const chip8Env_t* env) {
+    return env->machine == Chip8_Machine_Chip8 ? CHIP8_GRAPHICS_HEIGHT : CHIP8_HIRES_HEIGHT;
+}
+
+void chip8_envReset(chip8Env_t* env, uint8_t* observations) {
+    for (int i = 0; i < env->instanceCount; i++) {
+        env->instances[i].episodes = 0;
+        chip8_envResetInstance(env, i);
+        if (observations != NULL) {
+            chip8_envObserve(env, env->instances[i].state, &observations[i * chip8_envObservationSize(env)]);
+        }
+    }
+}
+
+void chip8_envStep(chip8Env_t* env, const uint16_t* actions, uint8_t* observations, float* rewards, uint8_t* dones) {
+    env->actions = actions;
+    env->observations = observations;
+    env->rewardsOut = rewards;
+    env->donesOut = dones;
+    chip8_envRunAll(env);
+}
+
+chip8State_t* chip8_envState(chip8Env_t* env, int instance) {
+    return env->instances[instance].state;
+}
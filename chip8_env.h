@@ -0,0 +1,211 @@
+#ifndef CHIP_8_CHIP8_ENV_H
+#define CHIP_8_CHIP8_ENV_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "chip8.h"
+
+// built into chip8_env.dll the functions below are exported for ctypes or cffi, every argument is a plain C type
+#ifdef CHIP8_ENV_EXPORTS
+#define CHIP8_ENV_API __declspec(dllexport)
+#else
+#define CHIP8_ENV_API
+#endif
+
+#define CHIP8_ENV_MAX_WORKERS 64
+#define CHIP8_ENV_MAX_REWARDS 8
+#define CHIP8_ENV_MAX_DONES 8
+// packed observations are the display words of every plane, see chip8State_t.display
+#define CHIP8_ENV_PACKED_SIZE (CHIP8_DISPLAY_PLANES * CHIP8_HIRES_HEIGHT * CHIP8_DISPLAY_WORDS * sizeof(uint64_t))
+
+enum chip8_envObservation {
+    Chip8_Env_Observation_Packed,   // CHIP8_ENV_PACKED_SIZE bytes, the display as the machine keeps it
+    Chip8_Env_Observation_Unpacked  // One byte per pixel as chip8_unpackDisplay writes it, see chip8_envObservationSize
+};
+
+// how a value a reward or done condition reads is stored in memory
+enum chip8_envValue {
+    Chip8_Env_Value_Byte,
+    Chip8_Env_Value_Word,           // Big endian, like the machine's own addresses
+    Chip8_Env_Value_Bcd             // Three decimal digits as FX33 stores them
+};
+
+// written to the done flags of every step, the instance has already been reset when it is not None
+enum chip8_envDone {
+    Chip8_Env_Done_None,
+    Chip8_Env_Done_Terminated,      // A done condition matched
+    Chip8_Env_Done_Truncated,       // The episode reached the frame limit
+    Chip8_Env_Done_Fault            // The machine ran into an invalid instruction
+};
+
+typedef struct {
+    uint16_t address;
+    enum chip8_envValue format;
+    float weight;               // The reward of a step is the change of the weighted sum of every value
+} chip8EnvReward_t;
+
+typedef struct {
+    uint16_t address;
+    enum chip8_envValue format;
+    int32_t value;              // The episode ends once the value at address equals it
+} chip8EnvDone_t;
+
+typedef struct {
+    chip8State_t* state;
+    uint16_t keys;              // Keys held down, bit N for key N
+    float score;                // Weighted sum of the reward values at the end of the last step
+    uint32_t frames;            // Frames of the running episode
+    uint32_t episodes;          // Episodes started, mixed into the seed of every reset
+} chip8EnvInstance_t;
+
+struct chip8Env;
+
+typedef struct {
+    struct chip8Env* env;
+    int first;                  // First instance of the slice the worker steps
+    int count;
+    HANDLE thread;
+    HANDLE start;               // Signalled when a step or shutdown is ready for the worker
+} chip8EnvWorker_t;
+
+typedef struct chip8Env {
+    chip8Rom_t* rom;            // Mapped for as long as the environment lives, every reset loads from it
+    chip8Aot_t* aot;            // Artifact of the rom every reset attaches or NULL without a valid one
+    enum chip8_machine machine;
+    int instanceCount;
+    chip8EnvInstance_t* instances;
+    int workerCount;
+    chip8EnvWorker_t workers[CHIP8_ENV_MAX_WORKERS]; // The first slice is stepped by the calling thread
+    HANDLE finished;            // Released once by every worker thread that is done with a step
+    volatile LONG stopping;
+    int frameSkip;              // Frames emulated by every step
+    bool vipTiming;             // Whether frames are emulated with chip8_emulateVipFrame
+    uint32_t maxFrames;         // Frames after which an episode is truncated, 0 for no limit
+    uint32_t seed;
+    enum chip8_envObservation observation;
+    chip8EnvReward_t rewards[CHIP8_ENV_MAX_REWARDS];
+    int rewardCount;
+    chip8EnvDone_t dones[CHIP8_ENV_MAX_DONES];
+    int doneCount;
+    // arguments of the running step, read by the workers
+    const uint16_t* actions;
+    uint8_t* observations;
+    float* rewardsOut;
+    uint8_t* donesOut;
+} chip8Env_t;
+
+/**
+ * Initializes and returns a batch of machines running the same rom, ready to be stepped together
+ * The instances are split into contiguous slices, one per worker. Stepping allocates nothing.
+ * @param romPath The file path of the rom
+ * @param machine The enum chip8_machine every instance emulates
+ * @param instanceCount The number of instances
+ * @param workerCount The number of threads stepping them including the caller's, 0 for one per processor
+ * @param frameSkip The number of frames every step emulates
+ * @param seed The seed the random generator of every instance and episode is derived from
+ * @return A pointer to the created chip8Env_t struct or NULL if the rom could not be loaded
+ */
+CHIP8_ENV_API chip8Env_t* chip8_envInit(const char* romPath, int machine, int instanceCount, int workerCount,
+                                        int frameSkip, uint32_t seed);
+
+/**
+ * Stops the workers and frees the environment and its instances
+ * It also nulls the pointer to the object during deletion
+ * @param env A pointer to the pointer to be freed of type chip8Env_t**
+ */
+CHIP8_ENV_API void chip8_envDel(chip8Env_t** env);
+
+/**
+ * Adds a value to the score, the reward of a step is how much the weighted score changed
+ * @param env A pointer to the environment
+ * @param address The address of the value in memory
+ * @param format The enum chip8_envValue the value is stored as
+ * @param weight The factor of the value in the score, negative for penalties like lost lives
+ * @return If there was room for another value
+ */
+CHIP8_ENV_API bool chip8_envAddReward(chip8Env_t* env, uint16_t address, int format, float weight);
+
+/**
+ * Adds a condition that ends an episode, any one that matches after a frame ends it
+ * @param env A pointer to the environment
+ * @param address The address of the value in memory
+ * @param format The enum chip8_envValue the value is stored as
+ * @param value The value that ends the episode, e.g. 0 for a lives counter
+ * @return If there was room for another condition
+ */
+CHIP8_ENV_API bool chip8_envAddDone(chip8Env_t* env, uint16_t address, int format, int32_t value);
+
+/**
+ * Sets the number of frames after which an episode is truncated
+ * @param env A pointer to the environment
+ * @param maxFrames The number of frames, 0 for no limit
+ */
+CHIP8_ENV_API void chip8_envSetMaxFrames(chip8Env_t* env, uint32_t maxFrames);
+
+/**
+ * Sets whether frames are emulated with the COSMAC VIP timing of chip8_emulateVipFrame
+ * @param env A pointer to the environment
+ * @param vipTiming Whether to use COSMAC VIP timing
+ */
+CHIP8_ENV_API void chip8_envSetVipTiming(chip8Env_t* env, bool vipTiming);
+
+/**
+ * Sets what the observation of an instance holds
+ * @param env A pointer to the environment
+ * @param observation The enum chip8_envObservation to write
+ */
+CHIP8_ENV_API void chip8_envSetObservation(chip8Env_t* env, int observation);
+
+/**
+ * Returns the size in bytes of the observation of one instance, the observations of all instances are contiguous
+ * Unpacked observations are as large as the largest display of the machine, a low resolution display on a machine
+ * that also has a high resolution one is scaled up to fill it.
+ * @param env A pointer to the environment
+ * @return The size in bytes
+ */
+CHIP8_ENV_API size_t chip8_envObservationSize(const chip8Env_t* env);
+
+/**
+ * Returns the width in pixels of unpacked observations
+ * @param env A pointer to the environment
+ * @return The width in pixels
+ */
+CHIP8_ENV_API int chip8_envObservationWidth(const chip8Env_t* env);
+
+/**
+ * Returns the height in pixels of unpacked observations
+ * @param env A pointer to the environment
+ * @return The height in pixels
+ */
+CHIP8_ENV_API int chip8_envObservationHeight(const chip8Env_t* env);
+
+/**
+ * Starts a new episode on every instance and writes their first observations
+ * @param env A pointer to the environment
+ * @param observations instanceCount observations of chip8_envObservationSize bytes or NULL
+ */
+CHIP8_ENV_API void chip8_envReset(chip8Env_t* env, uint8_t* observations);
+
+/**
+ * Steps every instance by frameSkip frames with the keys of its action held down
+ * An instance whose episode ends is reset right away, its observation is the first one of the new episode and its
+ * reward is the last one of the old episode.
+ * @param env A pointer to the environment
+ * @param actions instanceCount key masks, bit N holds down key N for the whole step
+ * @param observations instanceCount observations of chip8_envObservationSize bytes or NULL
+ * @param rewards instanceCount rewards or NULL
+ * @param dones instanceCount enum chip8_envDone values or NULL
+ */
+CHIP8_ENV_API void chip8_envStep(chip8Env_t* env, const uint16_t* actions, uint8_t* observations, float* rewards,
+                                 uint8_t* dones);
+
+/**
+ * Returns the machine of an instance, for reading memory or registers between steps
+ * @param env A pointer to the environment
+ * @param instance The index of the instance
+ * @return A pointer to the state of the instance
+ */
+CHIP8_ENV_API chip8State_t* chip8_envState(chip8Env_t* env, int instance);
+
+#endif //CHIP_8_CHIP8_ENV_H
@@ -0,0 +1,115 @@
+#include <stdlib.h>
+#include "chip8_latency.h"
+
+chip8Latency_t* chip8_latencyInit(void) {
+    chip8Latency_t* latency = calloc(1, sizeof(chip8Latency_t));
+    latency->buckets = calloc(CHIP8_LATENCY_BUCKETS, sizeof(uint64_t));
+    return latency;
+}
+
+void chip8_latencyDel(chip8Latency_t** latency) {
+    if (latency != NULL && *latency != NULL) {
+        free((*latency)->buckets);
+        free(*latency);
+        *latency = NULL;
+    }
+}
+
+void chip8_latencyInput(chip8Latency_t* latency, double timestamp, uint64_t event) {
+    if (latency->count == CHIP8_LATENCY_PENDING) {
+        // the oldest press never showed up on screen
+        latency->first = (latency->first + 1) % CHIP8_LATENCY_PENDING;
+        latency->count--;
+        latency->dropped++;
+    }
+    chip8LatencyInput_t* input = &latency->pending[(latency->first + latency->count) % CHIP8_LATENCY_PENDING];
+    input->timestamp = timestamp;
+    input->event = event;
+    input->draws = 0;
+    input->applied = false;
+    latency->count++;
+}
+
+void chip8_latencyObserve(chip8Latency_t* latency, uint64_t keysApplied, uint64_t draws) {
+    for (size_t i = 0; i < latency->count; i++) {
+        chip8LatencyInput_t* input = &latency->pending[(latency->first + i) % CHIP8_LATENCY_PENDING];
+        if (input->event >= keysApplied) {
+            // keys are applied in order, nothing after this one is applied either
+            break;
+        }
+        if (!input->applied) {
+            input->applied = true;
+            input->draws = draws;
+        }
+    }
+}
+
+void chip8_latencyPresent(chip8Latency_t* latency, double timestamp, uint64_t draws) {
+    while (latency->count > 0) {
+        chip8LatencyInput_t* input = &latency->pending[latency->first];
+        // anything applied later can only have been drawn later
+        if (!input->applied || input->draws >= draws) {
+            break;
+        }
+        double seconds = timestamp > input->timestamp ? timestamp - input->timestamp : 0.0;
+        size_t bucket = (size_t)(seconds / CHIP8_LATENCY_BUCKET_SECS);
+        if (bucket >= CHIP8_LATENCY_BUCKETS) {
+            bucket = CHIP8_LATENCY_BUCKETS - 1;
+        }
+        latency->buckets[bucket]++;
+        latency->samples++;
+        latency->total += seconds;
+        if (seconds > latency->worst) {
+            latency->worst = seconds;
+        }
+        latency->first = (latency->first + 1) % CHIP8_LATENCY_PENDING;
+        latency->count--;
+    }
+}
+
+double chip8_latencyBucketPercentile(const uint64_t* buckets, size_t bucketCount, double bucketSecs,
+                                     double percentile) {
+    uint64_t samples = 0;
+    for (size_t i = 0; i < bucketCount; i++) {
+        samples += buckets[i];
+    }
+    if (samples == 0) {
+        return 0.0;
+    }
+    // rank of the sample the percentile falls on, counting from 1
+    uint64_t rank = (uint64_t)(percentile / 100.0 * (double)samples + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (size_t i = 0; i < bucketCount; i++) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return (double)(i + 1) * bucketSecs;
+        }
+    }
+    return (double)bucketCount * bucketSecs;
+}
+
+double chip8_latencyPercentile(const chip8Latency_t* latency, double percentile) {
+    return chip8_latencyBucketPercentile(latency->buckets, CHIP8_LATENCY_BUCKETS, CHIP8_LATENCY_BUCKET_SECS,
+                                         percentile);
+}
+
+void chip8_latencyReport(const chip8Latency_t* latency, FILE* out) {
+    fprintf(out, "%llu key presses presented, %llu never presented\n", (unsigned long long)latency->samples,
+            (unsigned long long)latency->dropped + latency->count);
+    if (latency->samples == 0) {
+        return;
+    }
+    fprintf(out, "mean %.2f ms  p50 %.1f ms  p95 %.1f ms  p99 %.1f ms  max %.2f ms\n",
+            1000.0 * latency->total / (double)latency->samples, 1000.0 * chip8_latencyPercentile(latency, 50.0),
+            1000.0 * chip8_latencyPercentile(latency, 95.0), 1000.0 * chip8_latencyPercentile(latency, 99.0),
+            1000.0 * latency->worst);
+    for (size_t i = 0; i < CHIP8_LATENCY_BUCKETS; i++) {
+        if (latency->buckets[i] != 0) {
+            fprintf(out, "  < %6.1f ms  %llu\n", 1000.0 * (double)(i + 1) * CHIP8_LATENCY_BUCKET_SECS,
+                    (unsigned long long)latency->buckets[i]);
+        }
+    }
+}
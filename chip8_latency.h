@@ -0,0 +1,97 @@
+#ifndef CHIP_8_CHIP8_LATENCY_H
+#define CHIP_8_CHIP8_LATENCY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#define CHIP8_LATENCY_PENDING 64
+#define CHIP8_LATENCY_BUCKET_SECS 0.0005    // Width of a histogram bucket
+#define CHIP8_LATENCY_BUCKETS 1000          // Covers 500 ms, anything slower lands in the last bucket
+
+typedef struct {
+    double timestamp;           // Host monotonic time the key event was received, in seconds
+    uint64_t event;             // Sequence number of the key event, see chip8State_t.keyEvents
+    uint64_t draws;             // Display changes made before the key event was applied
+    bool applied;               // Whether the key event has reached the keypad of the machine
+} chip8LatencyInput_t;
+
+typedef struct {
+    chip8LatencyInput_t pending[CHIP8_LATENCY_PENDING]; // Key presses waiting for a frame, oldest first
+    size_t first;               // Index of the oldest pending key press
+    size_t count;               // Number of pending key presses
+    uint64_t* buckets;          // Key presses per CHIP8_LATENCY_BUCKET_SECS of latency
+    uint64_t samples;           // Key presses that reached the screen
+    uint64_t dropped;           // Key presses that were still pending when the ring was full
+    double total;               // Sum of all latencies in seconds
+    double worst;               // Largest latency in seconds
+} chip8Latency_t;
+
+/**
+ * Initializes and returns an input latency tracker
+ * @return A pointer to the created chip8Latency_t struct
+ */
+chip8Latency_t* chip8_latencyInit(void);
+
+/**
+ * Deallocates and frees an input latency tracker
+ * It also nulls the pointer to the object during deletion
+ * @param latency A pointer to the pointer to be freed of type chip8Latency_t**
+ */
+void chip8_latencyDel(chip8Latency_t** latency);
+
+/**
+ * Starts tracking a key press
+ * @param latency A pointer to the tracker
+ * @param timestamp The host monotonic time the key event was received, in seconds
+ * @param event The sequence number the machine gives the key event
+ */
+void chip8_latencyInput(chip8Latency_t* latency, double timestamp, uint64_t event);
+
+/**
+ * Notes which of the tracked key presses the machine has applied
+ * Has to run whenever keys may have been applied and before the next instruction, i.e. after every cycle and key event
+ * @param latency A pointer to the tracker
+ * @param keysApplied The number of key events the machine has applied
+ * @param draws The number of display changes the machine had made when it last applied keys
+ */
+void chip8_latencyObserve(chip8Latency_t* latency, uint64_t keysApplied, uint64_t draws);
+
+/**
+ * Records the latency of every tracked key press the presented frame reflects, which are those applied before an
+ * instruction that changed the display
+ * @param latency A pointer to the tracker
+ * @param timestamp The host monotonic time the frame was presented, in seconds
+ * @param draws The number of display changes the machine has made
+ */
+void chip8_latencyPresent(chip8Latency_t* latency, double timestamp, uint64_t draws);
+
+/**
+ * Returns a percentile of the samples counted in a histogram of equally wide buckets, the last of which holds
+ * everything slower
+ * @param buckets The number of samples per bucket
+ * @param bucketCount The number of buckets
+ * @param bucketSecs The width of a bucket in seconds
+ * @param percentile The percentile between 0 and 100
+ * @return The upper bound of the bucket holding the percentile in seconds, 0 without samples
+ */
+double chip8_latencyBucketPercentile(const uint64_t* buckets, size_t bucketCount, double bucketSecs,
+                                     double percentile);
+
+/**
+ * Returns a percentile of the recorded latencies
+ * @param latency A pointer to the tracker
+ * @param percentile The percentile between 0 and 100
+ * @return The upper bound of the histogram bucket holding the percentile in seconds, 0 without samples
+ */
+double chip8_latencyPercentile(const chip8Latency_t* latency, double percentile);
+
+/**
+ * Writes the p50/p95/p99 latencies and the histogram of every non-empty bucket
+ * @param latency A pointer to the tracker
+ * @param out The stream to write to
+ */
+void chip8_latencyReport(const chip8Latency_t* latency, FILE* out);
+
+#endif //CHIP_8_CHIP8_LATENCY_H
@@ -0,0 +1,116 @@
+#include <stdlib.h>
+#include <string.h>
+#include "chip8_latency.h"
+#include "chip8_pacing.h"
+
+chip8Pacing_t* chip8_pacingInit(double interval) {
+    chip8Pacing_t* pacing = calloc(1, sizeof(chip8Pacing_t));
+    pacing->interval = interval;
+    pacing->presented = calloc(CHIP8_PACING_FRAME_SIZE, sizeof(uint8_t));
+    pacing->held = calloc(CHIP8_PACING_FRAME_SIZE, sizeof(uint8_t));
+    pacing->buckets = calloc(CHIP8_PACING_BUCKETS, sizeof(uint64_t));
+    return pacing;
+}
+
+void chip8_pacingDel(chip8Pacing_t** pacing) {
+    if (pacing != NULL && *pacing != NULL) {
+        free((*pacing)->presented);
+        free((*pacing)->held);
+        free((*pacing)->buckets);
+        free(*pacing);
+        *pacing = NULL;
+    }
+}
+
+bool chip8_pacingDue(const chip8Pacing_t* pacing, double now) {
+    return now >= pacing->next;
+}
+
+// whether a pixel lit in the held display is lit neither now nor on the screen, so skipping it would lose it
+static bool chip8_pacingLosesHeld(const chip8Pacing_t* pacing, const uint8_t* pixels, uint16_t width,
+                                  uint16_t height) {
+    if (pacing->heldWidth != width || pacing->heldHeight != height ||
+        pacing->heldWidth != pacing->presentedWidth || pacing->heldHeight != pacing->presentedHeight) {
+        // the resolution changed in between, nothing on the held display is on the others
+        return true;
+    }
+    uint8_t lost = 0;
+    for (size_t i = 0; i < (size_t)width * height; i++) {
+        lost |= pacing->held[i] & ~pixels[i] & ~pacing->presented[i];
+    }
+    return lost != 0;
+}
+
+enum chip8_pacingAction chip8_pacingDecide(chip8Pacing_t* pacing, const uint8_t* pixels, uint16_t width,
+                                           uint16_t height, double now, double backlog) {
+    pacing->next = now + pacing->interval;
+    if (backlog > pacing->backlogWorst) {
+        pacing->backlogWorst = backlog;
+    }
+    if (pacing->holding && chip8_pacingLosesHeld(pacing, pixels, width, height)) {
+        return Chip8_Pacing_Action_PresentHeld;
+    }
+    if (backlog > pacing->interval) {
+        memcpy(pacing->held, pixels, (size_t)width * height);
+        pacing->heldWidth = width;
+        pacing->heldHeight = height;
+        pacing->holding = true;
+        pacing->skipped++;
+        return Chip8_Pacing_Action_Skip;
+    }
+    return Chip8_Pacing_Action_Present;
+}
+
+void chip8_pacingPresented(chip8Pacing_t* pacing, const uint8_t* pixels, uint16_t width, uint16_t height,
+                           uint64_t draws, double start, double end) {
+    if (pixels == pacing->held) {
+        pacing->late++;
+    } else {
+        pacing->presents++;
+        // the last change before every present is the one it shows, the ones before were folded into it
+        if (draws > pacing->drawsAtPresent + 1) {
+            pacing->coalesced += draws - pacing->drawsAtPresent - 1;
+        }
+        pacing->drawsAtPresent = draws;
+    }
+    memcpy(pacing->presented, pixels, (size_t)width * height);
+    pacing->presentedWidth = width;
+    pacing->presentedHeight = height;
+    pacing->holding = false;
+
+    if (pacing->lastPresent > 0.0) {
+        double frame = start - pacing->lastPresent;
+        size_t bucket = (size_t)(frame / CHIP8_PACING_BUCKET_SECS);
+        pacing->buckets[bucket < CHIP8_PACING_BUCKETS ? bucket : CHIP8_PACING_BUCKETS - 1]++;
+        pacing->frameTotal += frame;
+        if (frame > pacing->frameWorst) {
+            pacing->frameWorst = frame;
+        }
+    }
+    pacing->lastPresent = start;
+    pacing->presentTotal += end - start;
+    if (end - start > pacing->presentWorst) {
+        pacing->presentWorst = end - start;
+    }
+}
+
+double chip8_pacingPercentile(const chip8Pacing_t* pacing, double percentile) {
+    return chip8_latencyBucketPercentile(pacing->buckets, CHIP8_PACING_BUCKETS, CHIP8_PACING_BUCKET_SECS, percentile);
+}
+
+void chip8_pacingReport(const chip8Pacing_t* pacing, FILE* out) {
+    uint64_t total = pacing->presents + pacing->late;
+    fprintf(out, "%llu presents, %llu of them late for a skipped frame, %llu intervals skipped, "
+                 "%llu display changes coalesced\n", (unsigned long long)total, (unsigned long long)pacing->late,
+            (unsigned long long)pacing->skipped, (unsigned long long)pacing->coalesced);
+    fprintf(out, "worst emulation backlog %.1f ms\n", 1000.0 * pacing->backlogWorst);
+    if (total < 2) {
+        return;
+    }
+    fprintf(out, "frame time mean %.2f ms  p50 %.0f ms  p95 %.0f ms  p99 %.0f ms  max %.2f ms\n",
+            1000.0 * pacing->frameTotal / (double)(total - 1), 1000.0 * chip8_pacingPercentile(pacing, 50.0),
+            1000.0 * chip8_pacingPercentile(pacing, 95.0), 1000.0 * chip8_pacingPercentile(pacing, 99.0),
+            1000.0 * pacing->frameWorst);
+    fprintf(out, "present mean %.2f ms  max %.2f ms\n", 1000.0 * pacing->presentTotal / (double)total,
+            1000.0 * pacing->presentWorst);
+}
@@ -0,0 +1,110 @@
+#ifndef CHIP_8_CHIP8_PACING_H
+#define CHIP_8_CHIP8_PACING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#define CHIP8_PACING_FRAME_SIZE 8192        // Pixels of the largest display, CHIP8_DISPLAY_SIZE
+#define CHIP8_PACING_BUCKET_SECS 0.001      // Width of a frame time histogram bucket
+#define CHIP8_PACING_BUCKETS 250            // Covers 250 ms, anything slower lands in the last bucket
+
+enum chip8_pacingAction {
+    Chip8_Pacing_Action_Present,            // Present the current display
+    Chip8_Pacing_Action_Skip,               // Keep emulating, the display is held until the next interval
+    Chip8_Pacing_Action_PresentHeld         // Present the held display, the current one waits for the next interval
+};
+
+typedef struct {
+    double interval;            // Display interval in seconds, at most one present or skip happens per interval
+    double next;                // Host monotonic time the next interval starts, in seconds
+    double lastPresent;         // Host monotonic time the last present started, 0 before the first
+    uint8_t* presented;         // Unpacked display of the last present
+    uint16_t presentedWidth;
+    uint16_t presentedHeight;
+    uint8_t* held;              // Unpacked display of the last skipped interval
+    uint16_t heldWidth;
+    uint16_t heldHeight;
+    bool holding;               // Whether held is a skipped display nothing was presented after yet
+    uint64_t drawsAtPresent;    // Display changes the machine had made at the last present
+    uint64_t* buckets;          // Presents per CHIP8_PACING_BUCKET_SECS of time since the previous one
+    uint64_t presents;          // Presents of the current display
+    uint64_t late;              // Presents of a held display that would have been lost otherwise
+    uint64_t skipped;           // Intervals skipped because emulation was behind
+    uint64_t coalesced;         // Display changes that were folded into a present with later ones
+    double frameTotal;          // Sum of the times between presents in seconds
+    double frameWorst;          // Largest time between presents in seconds
+    double presentTotal;        // Sum of the time presents took in seconds
+    double presentWorst;        // Largest time a present took in seconds
+    double backlogWorst;        // Largest emulation backlog seen at a decision in seconds
+} chip8Pacing_t;
+
+/**
+ * Initializes and returns a presentation pacer
+ * @param interval The display interval in seconds
+ * @return A pointer to the created chip8Pacing_t struct
+ */
+chip8Pacing_t* chip8_pacingInit(double interval);
+
+/**
+ * Deallocates and frees a presentation pacer
+ * It also nulls the pointer to the object during deletion
+ * @param pacing A pointer to the pointer to be freed of type chip8Pacing_t**
+ */
+void chip8_pacingDel(chip8Pacing_t** pacing);
+
+/**
+ * Returns whether a display interval has passed since the last present or skip, changes made before then are
+ * coalesced into the next present
+ * @param pacing A pointer to the pacer
+ * @param now The host monotonic time in seconds
+ * @return If the changed display should be decided on now
+ */
+bool chip8_pacingDue(const chip8Pacing_t* pacing, double now);
+
+/**
+ * Decides what to do with a changed display at the start of an interval
+ * The display is skipped while emulation is more than an interval behind its target. A skipped display is held and
+ * presented late if pixels lit in it are neither on the next display nor on the screen, so a pixel that is lit at
+ * the start of an interval is never skipped over.
+ * @param pacing A pointer to the pacer
+ * @param pixels The unpacked current display
+ * @param width The width of the current display in pixels
+ * @param height The height of the current display in pixels
+ * @param now The host monotonic time in seconds
+ * @param backlog How far emulation is behind its instructions per second target, in seconds
+ * @return What to present, if anything
+ */
+enum chip8_pacingAction chip8_pacingDecide(chip8Pacing_t* pacing, const uint8_t* pixels, uint16_t width,
+                                           uint16_t height, double now, double backlog);
+
+/**
+ * Records a present of the current display or of the held one
+ * @param pacing A pointer to the pacer
+ * @param pixels The unpacked display that was presented
+ * @param width The width of the display in pixels
+ * @param height The height of the display in pixels
+ * @param draws The number of display changes the machine has made, the held display ignores it
+ * @param start The host monotonic time the present started, in seconds
+ * @param end The host monotonic time the present finished, in seconds
+ */
+void chip8_pacingPresented(chip8Pacing_t* pacing, const uint8_t* pixels, uint16_t width, uint16_t height,
+                           uint64_t draws, double start, double end);
+
+/**
+ * Returns a percentile of the times between presents
+ * @param pacing A pointer to the pacer
+ * @param percentile The percentile between 0 and 100
+ * @return The upper bound of the histogram bucket holding the percentile in seconds, 0 without two presents
+ */
+double chip8_pacingPercentile(const chip8Pacing_t* pacing, double percentile);
+
+/**
+ * Writes the present, skip and coalescing counts, the p50/p95/p99 frame times and the cost of presenting
+ * @param pacing A pointer to the pacer
+ * @param out The stream to write to
+ */
+void chip8_pacingReport(const chip8Pacing_t* pacing, FILE* out);
+
+#endif //CHIP_8_CHIP8_PACING_H
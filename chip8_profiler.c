@@ -0,0 +1,253 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "chip8.h"
+
+static uint32_t chip8_profilerHash(uint32_t parent, uint16_t entry) {
+    uint32_t hash = parent * 2654435761u ^ entry * 40503u;
+    return hash ^ (hash >> 15u);
+}
+
+static bool chip8_profilerGrow(chip8Profiler_t* profiler) {
+    chip8ProfilerNode_t* nodes = realloc(profiler->nodes, 2 * profiler->nodeCapacity * sizeof(chip8ProfilerNode_t));
+    if (nodes == NULL) {
+        return false;
+    }
+    profiler->nodes = nodes;
+    profiler->nodeCapacity *= 2;
+
+    // keep the lookup table at most half full
+    uint32_t* lookup = calloc(2 * profiler->nodeCapacity, sizeof(uint32_t));
+    if (lookup == NULL) {
+        return false;
+    }
+    free(profiler->lookup);
+    profiler->lookup = lookup;
+    profiler->lookupCapacity = 2 * profiler->nodeCapacity;
+    for (uint32_t i = 1; i < profiler->nodeCount; i++) {
+        uint32_t slot = chip8_profilerHash(nodes[i].parent, nodes[i].entry) & (profiler->lookupCapacity - 1);
+        while (lookup[slot] != 0) {
+            slot = (slot + 1) & (profiler->lookupCapacity - 1);
+        }
+        lookup[slot] = i + 1;
+    }
+    return true;
+}
+
+static uint32_t chip8_profilerChild(chip8Profiler_t* profiler, uint32_t parent, uint16_t entry) {
+    uint32_t mask = profiler->lookupCapacity - 1;
+    uint32_t slot = chip8_profilerHash(parent, entry) & mask;
+    while (profiler->lookup[slot] != 0) {
+        const chip8ProfilerNode_t* node = &profiler->nodes[profiler->lookup[slot] - 1];
+        if (node->parent == parent && node->entry == entry) {
+            return profiler->lookup[slot] - 1;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    if (profiler->nodeCount == profiler->nodeCapacity) {
+        if (!chip8_profilerGrow(profiler)) {
+            // out of memory, attribute the rest to the caller
+            return parent;
+        }
+        return chip8_profilerChild(profiler, parent, entry);
+    }
+    uint32_t index = profiler->nodeCount++;
+    profiler->nodes[index].parent = parent;
+    profiler->nodes[index].entry = entry;
+    profiler->nodes[index].samples = 0;
+    profiler->lookup[slot] = index + 1;
+    return index;
+}
+
+chip8Profiler_t* chip8_profilerInit(uint32_t sampleInterval, uint32_t memSize) {
+    chip8Profiler_t* profiler = calloc(1, sizeof(chip8Profiler_t));
+
+    profiler->sampleInterval = sampleInterval > 0 ? sampleInterval : 1;
+    profiler->countdown = profiler->sampleInterval;
+    profiler->memSize = memSize;
+    profiler->addressMask = (uint16_t)(memSize - 1u);
+    profiler->executions = calloc(memSize, sizeof(uint64_t));
+    profiler->calls = calloc(memSize, sizeof(uint64_t));
+    profiler->inclusive = calloc(memSize, sizeof(uint64_t));
+    profiler->exclusive = calloc(memSize, sizeof(uint64_t));
+    profiler->draws = calloc(memSize, sizeof(uint64_t));
+    profiler->drawRows = calloc(memSize, sizeof(uint64_t));
+    // one frame for the main program plus one per stack entry
+    profiler->frames = calloc(CHIP8_STACK_SIZE + 1, sizeof(uint32_t));
+    profiler->frameStart = calloc(CHIP8_STACK_SIZE + 1, sizeof(uint64_t));
+    profiler->depth = 0;
+
+    profiler->nodeCapacity = CHIP8_PROFILER_INITIAL_NODES;
+    profiler->nodes = calloc(profiler->nodeCapacity, sizeof(chip8ProfilerNode_t));
+    profiler->lookupCapacity = 2 * profiler->nodeCapacity;
+    profiler->lookup = calloc(profiler->lookupCapacity, sizeof(uint32_t));
+    profiler->nodes[CHIP8_PROFILER_ROOT].parent = CHIP8_PROFILER_ROOT;
+    profiler->nodes[CHIP8_PROFILER_ROOT].entry = CHIP8_PC_START;
+    profiler->nodeCount = 1;
+    profiler->frames[0] = CHIP8_PROFILER_ROOT;
+
+    return profiler;
+}
+
+void chip8_profilerDel(chip8Profiler_t** profiler) {
+    if (profiler != NULL && *profiler != NULL) {
+        free((*profiler)->executions);
+        free((*profiler)->calls);
+        free((*profiler)->inclusive);
+        free((*profiler)->exclusive);
+        free((*profiler)->draws);
+        free((*profiler)->drawRows);
+        free((*profiler)->frames);
+        free((*profiler)->frameStart);
+        free((*profiler)->nodes);
+        free((*profiler)->lookup);
+        free(*profiler);
+        *profiler = NULL;
+    }
+}
+
+void chip8_profilerRecord(chip8Profiler_t* profiler, uint16_t PC, uint16_t opcode, uint16_t previousSP, uint16_t SP,
+                          uint16_t nextPC) {
+    // BNNN and stepping past the last instruction leave PC beyond the end of memory, where it wraps around
+    PC &= profiler->addressMask;
+    nextPC &= profiler->addressMask;
+    profiler->instructions++;
+    if (--profiler->countdown == 0) {
+        profiler->countdown = profiler->sampleInterval;
+        profiler->samples++;
+        uint32_t node = profiler->frames[profiler->depth];
+        profiler->executions[PC]++;
+        profiler->nodes[node].samples++;
+        if (profiler->depth > 0) {
+            profiler->exclusive[profiler->nodes[node].entry]++;
+        }
+        if ((opcode & 0xF000u) == 0xD000) {
+            profiler->draws[PC]++;
+            profiler->drawRows[PC] += opcode & 0x000Fu;
+        }
+    }
+
+    if (SP > previousSP && profiler->depth < CHIP8_STACK_SIZE) {
+        // 2NNN, nextPC is the subroutine entry
+        profiler->calls[nextPC]++;
+        uint32_t child = chip8_profilerChild(profiler, profiler->frames[profiler->depth], nextPC);
+        profiler->depth++;
+        profiler->frames[profiler->depth] = child;
+        profiler->frameStart[profiler->depth] = profiler->samples;
+    } else if (SP < previousSP && profiler->depth > 0) {
+        // 00EE, everything sampled since the matching call belongs to the subroutine
+        uint16_t entry = profiler->nodes[profiler->frames[profiler->depth]].entry;
+        profiler->inclusive[entry] += profiler->samples - profiler->frameStart[profiler->depth];
+        profiler->depth--;
+    }
+}
+
+void chip8_profilerWriteFolded(const chip8Profiler_t* profiler, FILE* out) {
+    uint16_t path[CHIP8_STACK_SIZE + 1];
+    for (uint32_t i = 0; i < profiler->nodeCount; i++) {
+        if (profiler->nodes[i].samples == 0) {
+            continue;
+        }
+        // walk up to the root, then print from the root down
+        int length = 0;
+        uint32_t node = i;
+        while (node != CHIP8_PROFILER_ROOT && length < CHIP8_STACK_SIZE) {
+            path[length++] = profiler->nodes[node].entry;
+            node = profiler->nodes[node].parent;
+        }
+        fprintf(out, "main");
+        for (int j = length - 1; j >= 0; j--) {
+            fprintf(out, ";sub_%03X", path[j]);
+        }
+        fprintf(out, " %llu\n", (unsigned long long)profiler->nodes[i].samples);
+    }
+}
+
+static int chip8_profilerTopAddresses(const uint64_t* counts, uint32_t memSize, uint16_t* top, int rows) {
+    int found = 0;
+    for (uint32_t address = 0; address < memSize; address++) {
+        if (counts[address] == 0) {
+            continue;
+        }
+        // insertion into the short sorted list of the hottest addresses
+        int position = found < rows ? found++ : rows;
+        while (position > 0 && counts[top[position - 1]] < counts[address]) {
+            if (position < rows) {
+                top[position] = top[position - 1];
+            }
+            position--;
+        }
+        if (position < rows) {
+            top[position] = (uint16_t)address;
+        }
+    }
+    return found;
+}
+
+void chip8_profilerWriteReport(const chip8Profiler_t* profiler, FILE* out) {
+    uint16_t top[CHIP8_PROFILER_REPORT_ROWS];
+    double total = profiler->samples > 0 ? (double)profiler->samples : 1.0;
+
+    fprintf(out, "%llu instructions, %llu samples (every %u)\n", (unsigned long long)profiler->instructions,
+            (unsigned long long)profiler->samples, profiler->sampleInterval);
+
+    fprintf(out, "\nHottest addresses:\n");
+    int rows = chip8_profilerTopAddresses(profiler->executions, profiler->memSize, top, CHIP8_PROFILER_REPORT_ROWS);
+    for (int i = 0; i < rows; i++) {
+        fprintf(out, "  0x%03X  %12llu  %5.1f%%\n", top[i], (unsigned long long)profiler->executions[top[i]],
+                100.0 * (double)profiler->executions[top[i]] / total);
+    }
+
+    fprintf(out, "\nSubroutines by inclusive samples:\n");
+    rows = chip8_profilerTopAddresses(profiler->inclusive, profiler->memSize, top, CHIP8_PROFILER_REPORT_ROWS);
+    for (int i = 0; i < rows; i++) {
+        fprintf(out, "  0x%03X  %10llu calls  inclusive %12llu %5.1f%%  exclusive %12llu %5.1f%%\n", top[i],
+                (unsigned long long)profiler->calls[top[i]],
+                (unsigned long long)profiler->inclusive[top[i]], 100.0 * (double)profiler->inclusive[top[i]] / total,
+                (unsigned long long)profiler->exclusive[top[i]], 100.0 * (double)profiler->exclusive[top[i]] / total);
+    }
+
+    fprintf(out, "\nSprite draw sites:\n");
+    rows = chip8_profilerTopAddresses(profiler->draws, profiler->memSize, top, CHIP8_PROFILER_REPORT_ROWS);
+    for (int i = 0; i < rows; i++) {
+        fprintf(out, "  0x%03X  %12llu draws  %12llu rows\n", top[i], (unsigned long long)profiler->draws[top[i]],
+                (unsigned long long)profiler->drawRows[top[i]]);
+    }
+}
+
+void chip8_profilerWriteHeatmap(const chip8Profiler_t* profiler, FILE* out, int cellSize) {
+    int rows = (int)(profiler->memSize / CHIP8_HEATMAP_COLUMNS);
+    uint64_t hottest = 0;
+    for (uint32_t i = 0; i < profiler->memSize; i++) {
+        if (profiler->executions[i] > hottest) {
+            hottest = profiler->executions[i];
+        }
+    }
+    double scale = hottest > 0 ? log1p((double)hottest) : 1.0;
+
+    fprintf(out, "P6\n%d %d\n255\n", CHIP8_HEATMAP_COLUMNS * cellSize, rows * cellSize);
+    uint8_t* line = malloc((size_t)CHIP8_HEATMAP_COLUMNS * cellSize * 3);
+    if (line == NULL) {
+        return;
+    }
+    for (int row = 0; row < rows; row++) {
+        for (int column = 0; column < CHIP8_HEATMAP_COLUMNS; column++) {
+            // log scale from black through red and yellow to white
+            double heat = log1p((double)profiler->executions[row * CHIP8_HEATMAP_COLUMNS + column]) / scale;
+            double red = fmin(1.0, heat * 3.0);
+            double green = fmin(1.0, fmax(0.0, heat * 3.0 - 1.0));
+            double blue = fmin(1.0, fmax(0.0, heat * 3.0 - 2.0));
+            for (int x = 0; x < cellSize; x++) {
+                uint8_t* pixel = &line[(column * cellSize + x) * 3];
+                pixel[0] = (uint8_t)(red * 255.0);
+                pixel[1] = (uint8_t)(green * 255.0);
+                pixel[2] = (uint8_t)(blue * 255.0);
+            }
+        }
+        for (int y = 0; y < cellSize; y++) {
+            fwrite(line, 3, (size_t)CHIP8_HEATMAP_COLUMNS * cellSize, out);
+        }
+    }
+    free(line);
+}
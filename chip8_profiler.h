@@ -0,0 +1,95 @@
+#ifndef CHIP_8_CHIP8_PROFILER_H
+#define CHIP_8_CHIP8_PROFILER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#define CHIP8_PROFILER_INITIAL_NODES 256
+#define CHIP8_PROFILER_ROOT 0
+#define CHIP8_PROFILER_REPORT_ROWS 20
+#define CHIP8_HEATMAP_COLUMNS 64
+
+typedef struct {
+    uint32_t parent;            // Node of the caller, the root is its own parent
+    uint16_t entry;             // Address of the subroutine this frame is running
+    uint64_t samples;           // Samples taken while this exact call stack was active
+} chip8ProfilerNode_t;
+
+typedef struct {
+    uint32_t sampleInterval;    // 1 counts every instruction, N counts every Nth
+    uint32_t memSize;           // Number of addresses counted, the memory size of the profiled machine
+    uint16_t addressMask;       // memSize - 1, wraps addresses past the end of memory the way the machine does
+    uint32_t countdown;         // Instructions left until the next sample
+    uint64_t instructions;      // Instructions executed while attached
+    uint64_t samples;           // Samples taken while attached
+    uint64_t* executions;       // Samples per PC
+    uint64_t* calls;            // Calls per subroutine entry
+    uint64_t* inclusive;        // Samples per subroutine entry, including its callees
+    uint64_t* exclusive;        // Samples per subroutine entry, excluding its callees
+    uint64_t* draws;            // Executed DXYN per call site
+    uint64_t* drawRows;         // Sprite rows drawn per DXYN call site
+    uint32_t* frames;           // Shadow call stack of nodes, frames[0] is the root
+    uint64_t* frameStart;       // Sample count when each frame of the shadow stack was entered
+    uint16_t depth;             // Index of the active frame in the shadow stack
+    chip8ProfilerNode_t* nodes; // Call stack trie, one node per distinct stack
+    uint32_t nodeCount;
+    uint32_t nodeCapacity;
+    uint32_t* lookup;           // Open addressing table from (parent, entry) to node + 1
+    uint32_t lookupCapacity;
+} chip8Profiler_t;
+
+/**
+ * Initializes and returns a profiler
+ * Profiling is only compiled into chip8_emulateCycle when CHIP8_PROFILE is defined, otherwise attaching does nothing
+ * @param sampleInterval 1 to count every instruction exactly, N to count every Nth
+ * @param memSize The memory size of the profiled machine
+ * @return A pointer to the created chip8Profiler_t struct
+ */
+chip8Profiler_t* chip8_profilerInit(uint32_t sampleInterval, uint32_t memSize);
+
+/**
+ * Deallocates and frees a profiler
+ * It also nulls the pointer to the object during deletion
+ * @param profiler A pointer to the pointer to be freed of type chip8Profiler_t**
+ */
+void chip8_profilerDel(chip8Profiler_t** profiler);
+
+/**
+ * Records an executed instruction
+ * Calls and returns are detected from the change of the stack pointer so the shadow stack stays exact when sampling
+ * @param profiler A pointer to the profiler
+ * @param PC The address the instruction was fetched from
+ * @param opcode The instruction that was executed
+ * @param previousSP The stack pointer before the instruction
+ * @param SP The stack pointer after the instruction
+ * @param nextPC The program counter after the instruction
+ */
+void chip8_profilerRecord(chip8Profiler_t* profiler, uint16_t PC, uint16_t opcode, uint16_t previousSP, uint16_t SP,
+                          uint16_t nextPC);
+
+/**
+ * Writes the samples of every distinct call stack in folded format, one "main;sub_2C8;sub_344 42" line per stack,
+ * which flamegraph.pl and speedscope read directly
+ * @param profiler A pointer to the profiler
+ * @param out The stream to write to
+ */
+void chip8_profilerWriteFolded(const chip8Profiler_t* profiler, FILE* out);
+
+/**
+ * Writes the hottest addresses, the inclusive and exclusive samples of every subroutine and every sprite draw site
+ * @param profiler A pointer to the profiler
+ * @param out The stream to write to
+ */
+void chip8_profilerWriteReport(const chip8Profiler_t* profiler, FILE* out);
+
+/**
+ * Writes the samples per address as a CHIP8_HEATMAP_COLUMNS wide binary PPM image, one cell per byte of memory
+ * @param profiler A pointer to the profiler
+ * @param out The stream to write to, opened in binary mode
+ * @param cellSize The width and height of each cell in pixels
+ */
+void chip8_profilerWriteHeatmap(const chip8Profiler_t* profiler, FILE* out, int cellSize);
+
+#endif //CHIP_8_CHIP8_PROFILER_H
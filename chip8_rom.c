@@ -0,0 +1,130 @@
+#include <stdlib.h>
+#include <string.h>
+#include "chip8.h"
+
+#define CHIP8_FNV_OFFSET_BASIS 0xCBF29CE484222325ull
+#define CHIP8_FNV_PRIME 0x100000001B3ull
+
+chip8Rom_t* chip8_romOpen(const char* filePath, size_t maxSize) {
+    HANDLE file = CreateFileA(filePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        fprintf(stderr, "Failed to open file: %lu\n", GetLastError());
+        return NULL;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize)) {
+        fprintf(stderr, "Failed to get file size: %lu\n", GetLastError());
+        CloseHandle(file);
+        return NULL;
+    }
+    if (fileSize.QuadPart == 0) {
+        fprintf(stderr, "File size is 0!\n");
+        CloseHandle(file);
+        return NULL;
+    }
+    if ((uint64_t)fileSize.QuadPart > maxSize) {
+        fprintf(stderr, "File too large!\n");
+        CloseHandle(file);
+        return NULL;
+    }
+
+    // the view keeps the mapping alive so both handles can be closed once it exists
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (mapping == NULL) {
+        fprintf(stderr, "Failed to map file: %lu\n", GetLastError());
+        return NULL;
+    }
+    const uint8_t* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (data == NULL) {
+        fprintf(stderr, "Failed to map view of file: %lu\n", GetLastError());
+        return NULL;
+    }
+
+    chip8Rom_t* rom = calloc(1, sizeof(chip8Rom_t));
+    char* path = malloc(strlen(filePath) + 1);
+    if (rom == NULL || path == NULL) {
+        fprintf(stderr, "Failed to allocate memory for ROM\n");
+        UnmapViewOfFile(data);
+        free(rom);
+        free(path);
+        return NULL;
+    }
+    strcpy(path, filePath);
+
+    rom->path = path;
+    rom->data = data;
+    rom->size = (size_t)fileSize.QuadPart;
+    rom->hash = chip8_romHash(data, rom->size);
+    return rom;
+}
+
+void chip8_romClose(chip8Rom_t** rom) {
+    if (rom != NULL && *rom != NULL) {
+        UnmapViewOfFile((*rom)->data);
+        (*rom)->data = NULL;
+        free((*rom)->path);
+        (*rom)->path = NULL;
+        free(*rom);
+        *rom = NULL;
+    }
+}
+
+uint64_t chip8_romHash(const uint8_t* data, size_t size) {
+    uint64_t hash = CHIP8_FNV_OFFSET_BASIS;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= CHIP8_FNV_PRIME;
+    }
+    return hash;
+}
+
+chip8RomCache_t* chip8_romCacheInit(void) {
+    chip8RomCache_t* cache = calloc(1, sizeof(chip8RomCache_t));
+    cache->roms = calloc(CHIP8_ROM_CACHE_INITIAL_CAPACITY, sizeof(chip8Rom_t*));
+    cache->count = 0;
+    cache->capacity = CHIP8_ROM_CACHE_INITIAL_CAPACITY;
+    return cache;
+}
+
+void chip8_romCacheDel(chip8RomCache_t** cache) {
+    if (cache != NULL && *cache != NULL) {
+        for (size_t i = 0; i < (*cache)->count; i++) {
+            chip8_romClose(&(*cache)->roms[i]);
+        }
+        free((*cache)->roms);
+        (*cache)->roms = NULL;
+        free(*cache);
+        *cache = NULL;
+    }
+}
+
+const chip8Rom_t* chip8_romCacheGet(chip8RomCache_t* cache, const char* filePath) {
+    for (size_t i = 0; i < cache->count; i++) {
+        if (strcmp(cache->roms[i]->path, filePath) == 0) {
+            return cache->roms[i];
+        }
+    }
+
+    if (cache->count == cache->capacity) {
+        chip8Rom_t** roms = realloc(cache->roms, cache->capacity * 2 * sizeof(chip8Rom_t*));
+        if (roms == NULL) {
+            fprintf(stderr, "Failed to grow ROM cache\n");
+            return NULL;
+        }
+        cache->roms = roms;
+        cache->capacity *= 2;
+    }
+
+    // chip8_loadRom checks the size against the memory of the machine it is loaded into
+    chip8Rom_t* rom = chip8_romOpen(filePath, CHIP8_XO_MAX_ROM_SIZE);
+    if (rom == NULL) {
+        return NULL;
+    }
+    cache->roms[cache->count] = rom;
+    cache->count++;
+    return rom;
+}
@@ -0,0 +1,68 @@
+#ifndef CHIP_8_CHIP8_ROM_H
+#define CHIP_8_CHIP8_ROM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define CHIP8_ROM_CACHE_INITIAL_CAPACITY 16
+
+typedef struct {
+    char* path;           // Path the rom was opened from
+    const uint8_t* data;  // Read-only view of the rom file
+    size_t size;          // Size of the rom in bytes
+    uint64_t hash;        // FNV-1a hash of the rom contents
+} chip8Rom_t;
+
+typedef struct {
+    chip8Rom_t** roms;    // Roms mapped so far
+    size_t count;         // Number of roms in the cache
+    size_t capacity;      // Number of roms the cache can hold before growing
+} chip8RomCache_t;
+
+/**
+ * Memory maps a rom file read-only and validates its size
+ * @param filePath The file path to the rom to be opened
+ * @param maxSize The largest rom size accepted in bytes
+ * @return A pointer to the opened rom or NULL if it could not be opened
+ */
+chip8Rom_t* chip8_romOpen(const char* filePath, size_t maxSize);
+
+/**
+ * Unmaps and frees a rom
+ * It also nulls the pointer to the object during deletion
+ * @param rom A pointer to the pointer to be freed of type chip8Rom_t**
+ */
+void chip8_romClose(chip8Rom_t** rom);
+
+/**
+ * Computes the 64 bit FNV-1a hash of a buffer
+ * @param data The buffer to hash
+ * @param size The size of the buffer in bytes
+ * @return The hash of the buffer
+ */
+uint64_t chip8_romHash(const uint8_t* data, size_t size);
+
+/**
+ * Initializes and returns an empty rom cache
+ * The cache is not thread safe, it should be filled before instances are handed to other threads
+ * @return A pointer to the created chip8RomCache_t struct
+ */
+chip8RomCache_t* chip8_romCacheInit(void);
+
+/**
+ * Unmaps every rom in the cache and frees the cache
+ * It also nulls the pointer to the object during deletion
+ * @param cache A pointer to the pointer to be freed of type chip8RomCache_t**
+ */
+void chip8_romCacheDel(chip8RomCache_t** cache);
+
+/**
+ * Returns the cached rom for the file path, mapping it on first use
+ * @param cache A pointer to the rom cache
+ * @param filePath The file path to the rom
+ * @return A pointer to the cached rom or NULL if it could not be opened
+ */
+const chip8Rom_t* chip8_romCacheGet(chip8RomCache_t* cache, const char* filePath);
+
+#endif //CHIP_8_CHIP8_ROM_H
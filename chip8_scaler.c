@@ -0,0 +1,324 @@
+#include <stdlib.h>
+#include <string.h>
+#include "chip8.h"
+#include "chip8_scaler.h"
+
+// the vector kernels are compiled with target attributes so the rest of the build needs no -m flags
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CHIP8_SCALER_X86
+#include <immintrin.h>
+#endif
+
+#define CHIP8_SCALER_FILTERED_SIZE (CHIP8_SCALER_MAX_WIDTH * CHIP8_SCALER_MAX_FACTOR * \
+                                    CHIP8_SCALER_MAX_HEIGHT * CHIP8_SCALER_MAX_FACTOR)
+
+static const char* chip8_scalerIsaNames[] = {"scalar", "sse2", "avx2"};
+
+// writes factor copies of the color of every level, one output row
+static void chip8_scalerExpandScalar(const uint8_t* levels, int count, const uint32_t* colors, int factor,
+                                     uint32_t* out) {
+    for (int i = 0; i < count; i++) {
+        uint32_t color = colors[levels[i]];
+        for (int j = 0; j < factor; j++) {
+            *out++ = color;
+        }
+    }
+}
+
+// keeps the brighter of the new level and the faded old one, returns if any pixel is still fading
+static bool chip8_scalerBlendScalar(const uint8_t* levels, uint8_t* glow, int count, uint8_t persistence) {
+    bool fading = false;
+    for (int i = 0; i < count; i++) {
+        uint8_t faded = (uint8_t)((glow[i] * persistence) >> 8u);
+        glow[i] = faded > levels[i] ? faded : levels[i];
+        fading |= glow[i] != levels[i];
+    }
+    return fading;
+}
+
+#ifdef CHIP8_SCALER_X86
+__attribute__((target("sse2")))
+static void chip8_scalerExpandSse2(const uint8_t* levels, int count, const uint32_t* colors, int factor,
+                                   uint32_t* out) {
+    for (int i = 0; i < count; i++) {
+        uint32_t* run = out + i * factor;
+        __m128i color = _mm_set1_epi32((int)colors[levels[i]]);
+        int j = 0;
+        // the last vector may spill into the next runs, which are written afterwards
+        if ((count - i - 1) * factor >= 3) {
+            for (; j < factor; j += 4) {
+                _mm_storeu_si128((__m128i*)(run + j), color);
+            }
+            continue;
+        }
+        for (; j + 4 <= factor; j += 4) {
+            _mm_storeu_si128((__m128i*)(run + j), color);
+        }
+        for (; j < factor; j++) {
+            run[j] = colors[levels[i]];
+        }
+    }
+}
+
+__attribute__((target("sse2")))
+static bool chip8_scalerBlendSse2(const uint8_t* levels, uint8_t* glow, int count, uint8_t persistence) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i keep = _mm_set1_epi16(persistence);
+    __m128i changed = zero;
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i old = _mm_loadu_si128((const __m128i*)(glow + i));
+        __m128i level = _mm_loadu_si128((const __m128i*)(levels + i));
+        __m128i low = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(old, zero), keep), 8);
+        __m128i high = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(old, zero), keep), 8);
+        __m128i blended = _mm_max_epu8(_mm_packus_epi16(low, high), level);
+        _mm_storeu_si128((__m128i*)(glow + i), blended);
+        changed = _mm_or_si128(changed, _mm_xor_si128(blended, level));
+    }
+    bool fading = _mm_movemask_epi8(_mm_cmpeq_epi8(changed, zero)) != 0xFFFF;
+    return chip8_scalerBlendScalar(levels + i, glow + i, count - i, persistence) || fading;
+}
+
+__attribute__((target("avx2")))
+static void chip8_scalerExpandAvx2(const uint8_t* levels, int count, const uint32_t* colors, int factor,
+                                   uint32_t* out) {
+    for (int i = 0; i < count; i++) {
+        uint32_t* run = out + i * factor;
+        __m256i color = _mm256_set1_epi32((int)colors[levels[i]]);
+        int j = 0;
+        // the last vector may spill into the next runs, which are written afterwards
+        if ((count - i - 1) * factor >= 7) {
+            for (; j < factor; j += 8) {
+                _mm256_storeu_si256((__m256i*)(run + j), color);
+            }
+            continue;
+        }
+        for (; j + 8 <= factor; j += 8) {
+            _mm256_storeu_si256((__m256i*)(run + j), color);
+        }
+        for (; j < factor; j++) {
+            run[j] = colors[levels[i]];
+        }
+    }
+}
+
+__attribute__((target("avx2")))
+static bool chip8_scalerBlendAvx2(const uint8_t* levels, uint8_t* glow, int count, uint8_t persistence) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i keep = _mm256_set1_epi16(persistence);
+    __m256i changed = zero;
+    int i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i old = _mm256_loadu_si256((const __m256i*)(glow + i));
+        __m256i level = _mm256_loadu_si256((const __m256i*)(levels + i));
+        // unpack and pack both work within 128 bit lanes, so the bytes come back in order
+        __m256i low = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(old, zero), keep), 8);
+        __m256i high = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(old, zero), keep), 8);
+        __m256i blended = _mm256_max_epu8(_mm256_packus_epi16(low, high), level);
+        _mm256_storeu_si256((__m256i*)(glow + i), blended);
+        changed = _mm256_or_si256(changed, _mm256_xor_si256(blended, level));
+    }
+    bool fading = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(changed, zero)) != 0xFFFFFFFFu;
+    return chip8_scalerBlendScalar(levels + i, glow + i, count - i, persistence) || fading;
+}
+#endif
+
+bool chip8_scalerSupports(enum chip8_scalerIsa isa) {
+    switch (isa) {
+        case Chip8_Scaler_Isa_Scalar:
+            return true;
+#ifdef CHIP8_SCALER_X86
+        case Chip8_Scaler_Isa_Sse2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("sse2");
+        case Chip8_Scaler_Isa_Avx2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+const char* chip8_scalerIsaName(enum chip8_scalerIsa isa) {
+    return chip8_scalerIsaNames[isa];
+}
+
+chip8Scaler_t* chip8_scalerInit(enum chip8_scalerFilter filter, int outputWidth, int outputHeight,
+                                uint8_t persistence, bool scanlines) {
+    chip8Scaler_t* scaler = calloc(1, sizeof(chip8Scaler_t));
+
+    scaler->filter = filter;
+    scaler->isa = Chip8_Scaler_Isa_Scalar;
+    if (chip8_scalerSupports(Chip8_Scaler_Isa_Avx2)) {
+        scaler->isa = Chip8_Scaler_Isa_Avx2;
+    } else if (chip8_scalerSupports(Chip8_Scaler_Isa_Sse2)) {
+        scaler->isa = Chip8_Scaler_Isa_Sse2;
+    }
+    scaler->outputWidth = outputWidth;
+    scaler->outputHeight = outputHeight;
+    scaler->persistence = persistence;
+    scaler->scanlines = scanlines;
+    scaler->fading = false;
+    for (int i = 0; i < CHIP8_SCALER_LEVELS; i++) {
+        uint32_t dim = (uint32_t)(i * CHIP8_SCALER_SCANLINE_LEVEL) >> 8u;
+        // gray with an opaque alpha, the same in R, G, B, A byte order on any little endian host
+        scaler->colors[i] = 0xFF000000u | (uint32_t)i * 0x010101u;
+        scaler->dimColors[i] = 0xFF000000u | dim * 0x010101u;
+    }
+    scaler->source = calloc(CHIP8_SCALER_MAX_WIDTH * CHIP8_SCALER_MAX_HEIGHT, sizeof(uint8_t));
+    scaler->edges = calloc(CHIP8_SCALER_FILTERED_SIZE, sizeof(uint8_t));
+    scaler->glow = calloc(CHIP8_SCALER_FILTERED_SIZE, sizeof(uint8_t));
+    scaler->glowWidth = 0;
+    scaler->glowHeight = 0;
+
+    return scaler;
+}
+
+void chip8_scalerDel(chip8Scaler_t** scaler) {
+    if (scaler != NULL && *scaler != NULL) {
+        free((*scaler)->source);
+        free((*scaler)->edges);
+        free((*scaler)->glow);
+        free(*scaler);
+        *scaler = NULL;
+    }
+}
+
+// Scale2x (EPX), a pixel takes the color of two matching neighbours that meet at its corner
+static void chip8_scalerScale2x(const uint8_t* pixels, int width, int height, uint8_t* out) {
+    for (int y = 0; y < height; y++) {
+        const uint8_t* row = pixels + y * width;
+        const uint8_t* above = y > 0 ? row - width : row;
+        const uint8_t* below = y + 1 < height ? row + width : row;
+        uint8_t* top = out + (2 * y) * (2 * width);
+        uint8_t* bottom = top + 2 * width;
+        for (int x = 0; x < width; x++) {
+            uint8_t P = row[x];
+            uint8_t A = above[x];
+            uint8_t D = below[x];
+            uint8_t C = row[x > 0 ? x - 1 : x];
+            uint8_t B = row[x + 1 < width ? x + 1 : x];
+            top[2 * x] = C == A && C != D && A != B ? A : P;
+            top[2 * x + 1] = A == B && A != C && B != D ? B : P;
+            bottom[2 * x] = D == C && D != B && C != A ? C : P;
+            bottom[2 * x + 1] = B == D && B != A && D != C ? D : P;
+        }
+    }
+}
+
+// Scale3x (AdvMAME3x), the same rule with the edge centres only taking a corner color along a straight edge
+static void chip8_scalerScale3x(const uint8_t* pixels, int width, int height, uint8_t* out) {
+    for (int y = 0; y < height; y++) {
+        const uint8_t* row = pixels + y * width;
+        const uint8_t* above = y > 0 ? row - width : row;
+        const uint8_t* below = y + 1 < height ? row + width : row;
+        uint8_t* first = out + (3 * y) * (3 * width);
+        uint8_t* second = first + 3 * width;
+        uint8_t* third = second + 3 * width;
+        for (int x = 0; x < width; x++) {
+            int left = x > 0 ? x - 1 : x;
+            int right = x + 1 < width ? x + 1 : x;
+            uint8_t A = above[left], B = above[x], C = above[right];
+            uint8_t D = row[left], E = row[x], F = row[right];
+            uint8_t G = below[left], H = below[x], I = below[right];
+            bool topLeft = D == B && B != F && D != H;
+            bool topRight = B == F && B != D && F != H;
+            bool bottomLeft = D == H && D != B && H != F;
+            bool bottomRight = H == F && D != H && B != F;
+            first[3 * x] = topLeft ? D : E;
+            first[3 * x + 1] = (topLeft && E != C) || (topRight && E != A) ? B : E;
+            first[3 * x + 2] = topRight ? F : E;
+            second[3 * x] = (topLeft && E != G) || (bottomLeft && E != A) ? D : E;
+            second[3 * x + 1] = E;
+            second[3 * x + 2] = (topRight && E != I) || (bottomRight && E != C) ? F : E;
+            third[3 * x] = bottomLeft ? D : E;
+            third[3 * x + 1] = (bottomLeft && E != I) || (bottomRight && E != G) ? H : E;
+            third[3 * x + 2] = bottomRight ? F : E;
+        }
+    }
+}
+
+void chip8_scalerRun(chip8Scaler_t* scaler, const uint8_t* pixels, int width, int height, uint8_t* out, int pitch,
+                     int* scaledWidth, int* scaledHeight) {
+    // the edge filter is a fixed factor, nearest neighbour makes up the rest
+    int filterFactor = scaler->filter == Chip8_Scaler_Filter_Scale3x ? 3 :
+                       scaler->filter == Chip8_Scaler_Filter_Scale2x ? 2 : 1;
+    int scale = scaler->outputWidth / width < scaler->outputHeight / height ?
+                scaler->outputWidth / width : scaler->outputHeight / height;
+    if (scale < filterFactor) {
+        filterFactor = 1;
+    }
+    int factor = scale / filterFactor > 0 ? scale / filterFactor : 1;
+    int filteredWidth = width * filterFactor;
+    int filteredHeight = height * filterFactor;
+    int count = filteredWidth * filteredHeight;
+
+    // every palette index has its own brightness, so the edge filters find the same edges in brightness
+    for (int i = 0; i < width * height; i++) {
+        scaler->source[i] = chip8_palette[pixels[i] & (CHIP8_PALETTE_SIZE - 1u)];
+    }
+    if (filterFactor == 3) {
+        chip8_scalerScale3x(scaler->source, width, height, scaler->edges);
+    } else if (filterFactor == 2) {
+        chip8_scalerScale2x(scaler->source, width, height, scaler->edges);
+    } else {
+        memcpy(scaler->edges, scaler->source, (size_t)count);
+    }
+
+    const uint8_t* levels = scaler->edges;
+    scaler->fading = false;
+    if (scaler->persistence > 0) {
+        if (filteredWidth != scaler->glowWidth || filteredHeight != scaler->glowHeight) {
+            // the afterglow of another resolution does not line up with the new pixels
+            memcpy(scaler->glow, scaler->edges, (size_t)count);
+            scaler->glowWidth = filteredWidth;
+            scaler->glowHeight = filteredHeight;
+        } else {
+#ifdef CHIP8_SCALER_X86
+            if (scaler->isa == Chip8_Scaler_Isa_Avx2) {
+                scaler->fading = chip8_scalerBlendAvx2(scaler->edges, scaler->glow, count, scaler->persistence);
+            } else if (scaler->isa == Chip8_Scaler_Isa_Sse2) {
+                scaler->fading = chip8_scalerBlendSse2(scaler->edges, scaler->glow, count, scaler->persistence);
+            } else
+#endif
+            scaler->fading = chip8_scalerBlendScalar(scaler->edges, scaler->glow, count, scaler->persistence);
+        }
+        levels = scaler->glow;
+    }
+
+    void (*expand)(const uint8_t*, int, const uint32_t*, int, uint32_t*) = &chip8_scalerExpandScalar;
+#ifdef CHIP8_SCALER_X86
+    if (scaler->isa == Chip8_Scaler_Isa_Avx2) {
+        expand = &chip8_scalerExpandAvx2;
+    } else if (scaler->isa == Chip8_Scaler_Isa_Sse2) {
+        expand = &chip8_scalerExpandSse2;
+    }
+#endif
+    // scanlines need a dark row between bright ones
+    bool scanlines = scaler->scanlines && filterFactor * factor > 1;
+    // a display larger than the output is cut off at its right and bottom edges
+    int columns = filteredWidth * factor <= scaler->outputWidth ? filteredWidth : scaler->outputWidth / factor;
+    int rows = filteredHeight * factor <= scaler->outputHeight ? filteredHeight * factor : scaler->outputHeight;
+    size_t rowBytes = (size_t)columns * factor * sizeof(uint32_t);
+    for (int y = 0; y * factor < rows; y++) {
+        // every output row of a filtered row is either bright or dim, expand each once and copy it to the rest
+        uint8_t* first = out + (ptrdiff_t)(y * factor) * pitch;
+        uint8_t* bright = NULL;
+        uint8_t* dim = NULL;
+        for (int row = 0; row < factor && y * factor + row < rows; row++) {
+            uint8_t* target = first + (ptrdiff_t)row * pitch;
+            bool dark = scanlines && (y * factor + row) % 2 == 1;
+            uint8_t** source = dark ? &dim : &bright;
+            if (*source == NULL) {
+                expand(levels + y * filteredWidth, columns, dark ? scaler->dimColors : scaler->colors, factor,
+                       (uint32_t*)target);
+                *source = target;
+            } else {
+                memcpy(target, *source, rowBytes);
+            }
+        }
+    }
+    *scaledWidth = columns * factor;
+    *scaledHeight = rows;
+}
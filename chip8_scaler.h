@@ -0,0 +1,86 @@
+#ifndef CHIP_8_CHIP8_SCALER_H
+#define CHIP_8_CHIP8_SCALER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define CHIP8_SCALER_LEVELS 256
+#define CHIP8_SCALER_MAX_WIDTH 128      // CHIP8_HIRES_WIDTH, the widest display of any machine
+#define CHIP8_SCALER_MAX_HEIGHT 64      // CHIP8_HIRES_HEIGHT
+#define CHIP8_SCALER_MAX_FACTOR 3       // Largest edge filter, Scale3x
+#define CHIP8_SCALER_SCANLINE_LEVEL 160 // Brightness of scanline rows out of 256
+
+enum chip8_scalerFilter{ Chip8_Scaler_Filter_Nearest, Chip8_Scaler_Filter_Scale2x, Chip8_Scaler_Filter_Scale3x };
+
+// instruction sets the kernels are compiled for, the best one the processor supports is picked at init
+enum chip8_scalerIsa{ Chip8_Scaler_Isa_Scalar, Chip8_Scaler_Isa_Sse2, Chip8_Scaler_Isa_Avx2 };
+
+typedef struct {
+    enum chip8_scalerFilter filter;
+    enum chip8_scalerIsa isa;
+    int outputWidth;            // Size of the image the frontend shows, the display is scaled to fit
+    int outputHeight;
+    uint8_t persistence;        // Fraction out of 256 of its brightness a pixel keeps each frame, 0 turns it off
+    bool scanlines;             // Whether every other output row is dimmed
+    bool fading;                // Whether the last frame still showed the afterglow of pixels that are off
+    uint32_t colors[CHIP8_SCALER_LEVELS];   // RGBA of every brightness
+    uint32_t dimColors[CHIP8_SCALER_LEVELS]; // RGBA of every brightness on a scanline row
+    uint8_t* source;            // Brightness of every pixel of the display
+    uint8_t* edges;             // Brightness of the display after the edge filter
+    uint8_t* glow;              // Brightness of every filtered pixel including the afterglow
+    int glowWidth;              // Size of the filtered image the afterglow belongs to
+    int glowHeight;
+} chip8Scaler_t;
+
+/**
+ * Initializes and returns a scaler turning the display into an RGBA image
+ * The image is the display scaled by the largest integer that fits the output size, the edge filters round that
+ * down to a multiple of their own factor.
+ * @param filter The edge smoothing filter, Chip8_Scaler_Filter_Nearest for plain square pixels
+ * @param outputWidth The width of the image in pixels
+ * @param outputHeight The height of the image in pixels
+ * @param persistence The fraction out of 256 of its brightness a pixel keeps each frame, 0 for none
+ * @param scanlines Whether every other output row is dimmed
+ * @return A pointer to the created chip8Scaler_t struct
+ */
+chip8Scaler_t* chip8_scalerInit(enum chip8_scalerFilter filter, int outputWidth, int outputHeight,
+                                uint8_t persistence, bool scanlines);
+
+/**
+ * Deallocates and frees a scaler
+ * It also nulls the pointer to the object during deletion
+ * @param scaler A pointer to the pointer to be freed of type chip8Scaler_t**
+ */
+void chip8_scalerDel(chip8Scaler_t** scaler);
+
+/**
+ * Returns whether the processor can run the kernels of an instruction set
+ * @param isa The instruction set
+ * @return If the kernels can run
+ */
+bool chip8_scalerSupports(enum chip8_scalerIsa isa);
+
+/**
+ * Returns the name of an instruction set
+ * @param isa The instruction set
+ * @return A static string
+ */
+const char* chip8_scalerIsaName(enum chip8_scalerIsa isa);
+
+/**
+ * Scales a frame of the display into an RGBA image
+ * Only the top left outputWidth by outputHeight pixels are written and only as far as the scaled display reaches.
+ * @param scaler A pointer to the scaler
+ * @param pixels One palette index per pixel, as written by chip8_unpackDisplay
+ * @param width The width of the display
+ * @param height The height of the display
+ * @param out The first byte of the image, 4 bytes per pixel in R, G, B, A order
+ * @param pitch The distance between the rows of the image in bytes, negative for bottom up images
+ * @param scaledWidth Set to the width of the scaled display
+ * @param scaledHeight Set to the height of the scaled display
+ */
+void chip8_scalerRun(chip8Scaler_t* scaler, const uint8_t* pixels, int width, int height, uint8_t* out, int pitch,
+                     int* scaledWidth, int* scaledHeight);
+
+#endif //CHIP_8_CHIP8_SCALER_H
@@ -0,0 +1,126 @@
+#include <stdlib.h>
+#include <string.h>
+#include "chip8.h"
+#include "chip8_shared.h"
+
+chip8Shared_t* chip8_sharedInit(const char* name) {
+    chip8Shared_t* shared = calloc(1, sizeof(chip8Shared_t));
+    if (name != NULL) {
+        snprintf(shared->name, CHIP8_SHARED_NAME_SIZE, "%s", name);
+    } else {
+        snprintf(shared->name, CHIP8_SHARED_NAME_SIZE, CHIP8_SHARED_NAME_FORMAT, GetCurrentProcessId());
+    }
+
+    shared->mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0,
+                                         sizeof(chip8SharedLayout_t), shared->name);
+    if (shared->mapping == NULL) {
+        fprintf(stderr, "Failed to create shared memory %s: %lu\n", shared->name, GetLastError());
+        free(shared);
+        return NULL;
+    }
+    shared->layout = MapViewOfFile(shared->mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(chip8SharedLayout_t));
+    if (shared->layout == NULL) {
+        fprintf(stderr, "Failed to map shared memory %s: %lu\n", shared->name, GetLastError());
+        CloseHandle(shared->mapping);
+        free(shared);
+        return NULL;
+    }
+
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    memset(shared->layout, 0, sizeof(chip8SharedLayout_t));
+    shared->layout->size = sizeof(chip8SharedLayout_t);
+    shared->layout->width = CHIP8_HIRES_WIDTH;
+    shared->layout->height = CHIP8_HIRES_HEIGHT;
+    shared->layout->ticksPerSecond = (uint64_t)frequency.QuadPart;
+    shared->layout->version = CHIP8_SHARED_VERSION;
+    // readers check the magic last, so it is written once everything else is in place
+    MemoryBarrier();
+    shared->layout->magic = CHIP8_SHARED_MAGIC;
+    return shared;
+}
+
+void chip8_sharedDel(chip8Shared_t** shared) {
+    if (shared != NULL && *shared != NULL) {
+        UnmapViewOfFile((*shared)->layout);
+        (*shared)->layout = NULL;
+        CloseHandle((*shared)->mapping);
+        (*shared)->mapping = NULL;
+        free(*shared);
+        *shared = NULL;
+    }
+}
+
+void chip8_sharedPublish(chip8Shared_t* shared, const chip8State_t* state) {
+    chip8SharedLayout_t* layout = shared->layout;
+    LONG back = 1 - layout->current;
+    chip8SharedSnapshot_t* snapshot = &layout->snapshots[back];
+
+    // odd sequence while writing, readers of the front snapshot only retry if they straddle two publishes
+    InterlockedIncrement(&layout->sequence);
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    snapshot->frame = state->frames;
+    snapshot->instructions = state->instructions;
+    snapshot->publishTicks = (uint64_t)now.QuadPart;
+    // summed here rather than with chip8_faultCount, readers link this file without chip8.c
+    snapshot->faults = 0;
+    for (int i = 0; i < CHIP8_DISPATCH_SIZE; i++) {
+        snapshot->faults += state->faults[i];
+    }
+    snapshot->PC = state->PC;
+    snapshot->I = state->I;
+    snapshot->SP = state->SP;
+    memcpy(snapshot->stack, state->stack, sizeof(snapshot->stack));
+    memcpy(snapshot->V, state->V, sizeof(snapshot->V));
+    memcpy(snapshot->keys, state->keys, sizeof(snapshot->keys));
+    snapshot->delay = state->delay;
+    snapshot->sound = state->sound;
+    snapshot->waitingForKey = state->waitingForKey;
+    snapshot->machine = (uint8_t)state->machine;
+    snapshot->width = state->width;
+    snapshot->height = state->height;
+    chip8_unpackDisplay(state, snapshot->gfx);
+    InterlockedExchange(&layout->current, back);
+    InterlockedIncrement(&layout->sequence);
+}
+
+const chip8SharedLayout_t* chip8_sharedOpen(const char* name) {
+    HANDLE mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name);
+    if (mapping == NULL) {
+        fprintf(stderr, "Failed to open shared memory %s: %lu\n", name, GetLastError());
+        return NULL;
+    }
+    const chip8SharedLayout_t* layout = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, sizeof(chip8SharedLayout_t));
+    CloseHandle(mapping);
+    if (layout == NULL) {
+        fprintf(stderr, "Failed to map shared memory %s: %lu\n", name, GetLastError());
+        return NULL;
+    }
+    if (layout->magic != CHIP8_SHARED_MAGIC || layout->version != CHIP8_SHARED_VERSION ||
+        layout->size != sizeof(chip8SharedLayout_t)) {
+        fprintf(stderr, "Shared memory %s has an incompatible layout\n", name);
+        UnmapViewOfFile(layout);
+        return NULL;
+    }
+    return layout;
+}
+
+void chip8_sharedClose(const chip8SharedLayout_t* layout) {
+    UnmapViewOfFile(layout);
+}
+
+const chip8SharedSnapshot_t* chip8_sharedBegin(const chip8SharedLayout_t* layout, LONG* sequence) {
+    *sequence = layout->sequence;
+    MemoryBarrier();
+    if (*sequence & 1) {
+        return NULL;
+    }
+    return &layout->snapshots[layout->current];
+}
+
+bool chip8_sharedValidate(const chip8SharedLayout_t* layout, LONG sequence) {
+    MemoryBarrier();
+    // one complete publish only rewrote the other snapshot, the one after that may be overwriting this one
+    return (LONG)(layout->sequence - sequence) <= 2;
+}
@@ -0,0 +1,110 @@
+#ifndef CHIP_8_CHIP8_SHARED_H
+#define CHIP_8_CHIP8_SHARED_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <windows.h>
+
+#define CHIP8_SHARED_MAGIC 0x38504843u  // "CHP8"
+#define CHIP8_SHARED_VERSION 3u
+#define CHIP8_SHARED_NAME_SIZE 64
+#define CHIP8_SHARED_NAME_FORMAT "Local\\chip8_%lu"
+#define CHIP8_SHARED_REGISTERS 16
+#define CHIP8_SHARED_STACK 16
+#define CHIP8_SHARED_KEYS 16
+#define CHIP8_SHARED_GFX_SIZE 8192
+
+// Everything is fixed width and ordered largest first so readers built by other compilers see the same layout
+typedef struct {
+    uint64_t frame;                             // Timer updates emulated so far
+    uint64_t instructions;                      // Instructions executed so far
+    uint64_t publishTicks;                      // QueryPerformanceCounter value when the snapshot was published
+    uint64_t faults;                            // Memory accesses that wrapped past the end of memory so far
+    uint16_t PC;
+    uint16_t I;
+    uint16_t SP;
+    uint16_t stack[CHIP8_SHARED_STACK];
+    uint8_t V[CHIP8_SHARED_REGISTERS];
+    uint8_t keys[CHIP8_SHARED_KEYS];
+    uint8_t delay;
+    uint8_t sound;
+    uint8_t waitingForKey;
+    uint8_t machine;                            // enum chip8_machine
+    uint16_t width;                             // Width of gfx in pixels, changes when the resolution does
+    uint16_t height;                            // Height of gfx in pixels
+    uint8_t gfx[CHIP8_SHARED_GFX_SIZE];         // One byte per pixel, row major, bit 0 and 1 for the two planes
+} chip8SharedSnapshot_t;
+
+typedef struct {
+    uint32_t magic;                             // CHIP8_SHARED_MAGIC
+    uint32_t version;                           // CHIP8_SHARED_VERSION
+    uint32_t size;                              // sizeof(chip8SharedLayout_t)
+    uint32_t width;                             // Largest width of gfx in pixels
+    uint32_t height;                            // Largest height of gfx in pixels
+    volatile LONG sequence;                     // Odd while a snapshot is being published
+    volatile LONG current;                      // Index of the most recent complete snapshot
+    uint32_t reserved;
+    uint64_t ticksPerSecond;                    // QueryPerformanceFrequency of the publisher
+    chip8SharedSnapshot_t snapshots[2];         // The publisher always writes the one readers are not pointed at
+} chip8SharedLayout_t;
+
+typedef struct chip8Shared {
+    char name[CHIP8_SHARED_NAME_SIZE];          // Name of the file mapping
+    HANDLE mapping;                             // Handle keeping the mapping alive
+    chip8SharedLayout_t* layout;                // Mapped view of the segment
+} chip8Shared_t;
+
+struct chip8State;
+
+/**
+ * Creates a named shared memory segment the state of a machine is published into
+ * @param name The name of the segment or NULL for CHIP8_SHARED_NAME_FORMAT with the process id
+ * @return A pointer to the created chip8Shared_t struct or NULL if the segment could not be created
+ */
+chip8Shared_t* chip8_sharedInit(const char* name);
+
+/**
+ * Unmaps the segment and frees the publisher
+ * It also nulls the pointer to the object during deletion
+ * @param shared A pointer to the pointer to be freed of type chip8Shared_t**
+ */
+void chip8_sharedDel(chip8Shared_t** shared);
+
+/**
+ * Copies the state into the back snapshot and flips readers over to it. Makes no system calls.
+ * @param shared A pointer to the publisher
+ * @param state A pointer to the state for chip 8
+ */
+void chip8_sharedPublish(chip8Shared_t* shared, const struct chip8State* state);
+
+/**
+ * Maps an existing segment read-only and checks its layout
+ * @param name The name of the segment
+ * @return The mapped layout or NULL if it does not exist or was written by an incompatible version
+ */
+const chip8SharedLayout_t* chip8_sharedOpen(const char* name);
+
+/**
+ * Unmaps a segment opened with chip8_sharedOpen
+ * @param layout The mapped layout
+ */
+void chip8_sharedClose(const chip8SharedLayout_t* layout);
+
+/**
+ * Starts a zero-copy read. The returned snapshot can be read in place and is consistent if chip8_sharedValidate
+ * returns true for the returned sequence afterwards.
+ * @param layout The mapped layout
+ * @param sequence Receives the sequence number to validate with
+ * @return The most recent snapshot or NULL while one is being published
+ */
+const chip8SharedSnapshot_t* chip8_sharedBegin(const chip8SharedLayout_t* layout, LONG* sequence);
+
+/**
+ * Checks that the snapshot returned by chip8_sharedBegin was not overwritten while it was read
+ * @param layout The mapped layout
+ * @param sequence The sequence number returned by chip8_sharedBegin
+ * @return If everything read since chip8_sharedBegin is consistent
+ */
+bool chip8_sharedValidate(const chip8SharedLayout_t* layout, LONG sequence);
+
+#endif //CHIP_8_CHIP8_SHARED_H
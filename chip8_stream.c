@@ -0,0 +1,371 @@
+#include <stdlib.h>
+#include <string.h>
+#include "chip8_stream.h"
+
+static void chip8_streamPut16(uint8_t* out, uint16_t value) {
+    out[0] = (uint8_t)value;
+    out[1] = (uint8_t)(value >> 8u);
+}
+
+static void chip8_streamPut32(uint8_t* out, uint32_t value) {
+    chip8_streamPut16(out, (uint16_t)value);
+    chip8_streamPut16(out + 2, (uint16_t)(value >> 16u));
+}
+
+// run-length encodes current XOR reference, a NULL reference encodes a keyframe
+static size_t chip8_streamEncode(const uint8_t* current, const uint8_t* reference, uint8_t* out) {
+    uint8_t delta[CHIP8_STREAM_FRAME_BYTES];
+    for (size_t i = 0; i < CHIP8_STREAM_FRAME_BYTES; i++) {
+        delta[i] = reference != NULL ? current[i] ^ reference[i] : current[i];
+    }
+    size_t length = 0;
+    size_t i = 0;
+    while (i < CHIP8_STREAM_FRAME_BYTES) {
+        size_t run = 0;
+        while (i + run < CHIP8_STREAM_FRAME_BYTES && run < CHIP8_STREAM_RUN_MAX && delta[i + run] == 0) {
+            run++;
+        }
+        if (run > 0) {
+            out[length++] = (uint8_t)(run - 1);
+            i += run;
+            continue;
+        }
+        // a lone zero costs less inside the literal than as a run of its own
+        size_t start = i;
+        while (i < CHIP8_STREAM_FRAME_BYTES && i - start < CHIP8_STREAM_RUN_MAX &&
+               !(delta[i] == 0 && (i + 1 == CHIP8_STREAM_FRAME_BYTES || delta[i + 1] == 0))) {
+            i++;
+        }
+        out[length++] = (uint8_t)(0x80u | (i - start - 1));
+        memcpy(&out[length], &delta[start], i - start);
+        length += i - start;
+    }
+    return length;
+}
+
+// queues a frame for a viewer unless it is too far behind, which costs it the frame and makes it wait for a keyframe
+static void chip8_streamQueue(chip8Stream_t* stream, chip8StreamClient_t* client, const uint8_t* header,
+                              const uint8_t* payload, size_t payloadLength) {
+    size_t size = CHIP8_STREAM_HEADER_SIZE + payloadLength;
+    if (client->start > 0 && CHIP8_STREAM_CLIENT_BUFFER - client->length < size) {
+        // move what is left to the front before giving up on the space
+        memmove(client->buffer, client->buffer + client->start, client->length - client->start);
+        client->length -= client->start;
+        client->start = 0;
+    }
+    if (CHIP8_STREAM_CLIENT_BUFFER - client->length < size) {
+        client->needsKeyframe = true;
+        stream->framesDropped++;
+        return;
+    }
+    memcpy(client->buffer + client->length, header, CHIP8_STREAM_HEADER_SIZE);
+    memcpy(client->buffer + client->length + CHIP8_STREAM_HEADER_SIZE, payload, payloadLength);
+    client->length += size;
+    stream->framesSent++;
+}
+
+static void chip8_streamHeader(uint8_t* header, const chip8StreamInstance_t* instance, char type, size_t payloadLength) {
+    header[0] = 'C';
+    header[1] = '8';
+    header[2] = (uint8_t)type;
+    header[3] = instance->machine;
+    chip8_streamPut32(header + 4, instance->sentFrame);
+    chip8_streamPut16(header + 8, instance->sentWidth);
+    chip8_streamPut16(header + 10, instance->sentHeight);
+    chip8_streamPut32(header + 12, (uint32_t)payloadLength);
+}
+
+// sends a keyframe of the last encoded frame, what a viewer that just subscribed or fell behind starts from
+static void chip8_streamSendKeyframe(chip8Stream_t* stream, chip8StreamClient_t* client) {
+    chip8StreamInstance_t* instance = &stream->instances[client->instance];
+    uint8_t header[CHIP8_STREAM_HEADER_SIZE];
+    uint8_t payload[CHIP8_STREAM_MAX_PAYLOAD];
+    size_t payloadLength = chip8_streamEncode(instance->previous, NULL, payload);
+    chip8_streamHeader(header, instance, 'K', payloadLength);
+    client->needsKeyframe = false;
+    chip8_streamQueue(stream, client, header, payload, payloadLength);
+}
+
+// encodes every newly published frame once and queues it for the viewers of its instance
+static void chip8_streamDistribute(chip8Stream_t* stream) {
+    uint8_t header[CHIP8_STREAM_HEADER_SIZE];
+    uint8_t payload[CHIP8_STREAM_MAX_PAYLOAD];
+    for (int i = 0; i < stream->instanceCount; i++) {
+        chip8StreamInstance_t* instance = &stream->instances[i];
+        EnterCriticalSection(&instance->lock);
+        bool published = instance->frame != instance->sentFrame;
+        if (published) {
+            memcpy(instance->current, instance->display, CHIP8_STREAM_FRAME_BYTES);
+            instance->sentFrame = instance->frame;
+        }
+        uint16_t width = instance->width;
+        uint16_t height = instance->height;
+        LeaveCriticalSection(&instance->lock);
+        if (!published) {
+            continue;
+        }
+
+        bool keyframe = ++instance->sinceKeyframe >= CHIP8_STREAM_KEYFRAME_INTERVAL;
+        bool resized = width != instance->sentWidth || height != instance->sentHeight;
+        size_t payloadLength = chip8_streamEncode(instance->current, instance->previous, payload);
+        // a delta of nothing but zero runs changes nothing, and up to the first literal every byte is a run header
+        bool changed = resized;
+        for (size_t j = 0; !changed && j < payloadLength; j++) {
+            changed = payload[j] >= 0x80u;
+        }
+        memcpy(instance->previous, instance->current, CHIP8_STREAM_FRAME_BYTES);
+        instance->sentWidth = width;
+        instance->sentHeight = height;
+        if (keyframe) {
+            instance->sinceKeyframe = 0;
+        }
+        chip8_streamHeader(header, instance, 'D', payloadLength);
+        for (int c = 0; c < stream->clientCount; c++) {
+            chip8StreamClient_t* client = &stream->clients[c];
+            if (client->instance != i) {
+                continue;
+            }
+            if (keyframe || client->needsKeyframe) {
+                chip8_streamSendKeyframe(stream, client);
+            } else if (changed) {
+                chip8_streamQueue(stream, client, header, payload, payloadLength);
+            }
+        }
+    }
+}
+
+static void chip8_streamHandleMessage(chip8Stream_t* stream, chip8StreamClient_t* client) {
+    const uint8_t* message = client->message;
+    uint16_t argument = (uint16_t)(message[2] | message[3] << 8u);
+    if (message[0] == 'S' && argument < stream->instanceCount) {
+        client->instance = argument;
+        // nothing was encoded yet, the first frame is sent as a keyframe
+        client->needsKeyframe = true;
+        if (stream->instances[argument].sentFrame > 0) {
+            chip8_streamSendKeyframe(stream, client);
+        }
+    } else if (message[0] == 'K' && client->instance >= 0 && message[1] < CHIP8_KEYS_SIZE) {
+        chip8StreamInstance_t* instance = &stream->instances[client->instance];
+        EnterCriticalSection(&instance->lock);
+        // a viewer flooding keys loses the newest ones, never the emulator's time
+        if (instance->keyCount < CHIP8_STREAM_KEY_QUEUE) {
+            instance->keys[instance->keyCount].key = (int8_t)message[1];
+            instance->keys[instance->keyCount].value = argument != 0;
+            instance->keyCount++;
+        }
+        LeaveCriticalSection(&instance->lock);
+    }
+}
+
+// returns false once the viewer is gone
+static bool chip8_streamReceive(chip8Stream_t* stream, chip8StreamClient_t* client) {
+    uint8_t data[256];
+    while (1) {
+        int received = recv(client->socket, (char*)data, sizeof(data), 0);
+        if (received == 0) {
+            return false;
+        }
+        if (received == SOCKET_ERROR) {
+            return WSAGetLastError() == WSAEWOULDBLOCK;
+        }
+        for (int i = 0; i < received; i++) {
+            client->message[client->messageLength++] = data[i];
+            if (client->messageLength == CHIP8_STREAM_MESSAGE_SIZE) {
+                chip8_streamHandleMessage(stream, client);
+                client->messageLength = 0;
+            }
+        }
+    }
+}
+
+// returns false once the viewer is gone
+static bool chip8_streamSend(chip8StreamClient_t* client) {
+    while (client->start < client->length) {
+        int sent = send(client->socket, (const char*)client->buffer + client->start,
+                        (int)(client->length - client->start), 0);
+        if (sent == SOCKET_ERROR) {
+            return WSAGetLastError() == WSAEWOULDBLOCK;
+        }
+        client->start += (size_t)sent;
+    }
+    client->start = 0;
+    client->length = 0;
+    return true;
+}
+
+static void chip8_streamAccept(chip8Stream_t* stream) {
+    while (1) {
+        SOCKET socket = accept(stream->listener, NULL, NULL);
+        if (socket == INVALID_SOCKET) {
+            return;
+        }
+        if (stream->clientCount == CHIP8_STREAM_MAX_CLIENTS) {
+            closesocket(socket);
+            continue;
+        }
+        u_long nonBlocking = 1;
+        ioctlsocket(socket, FIONBIO, &nonBlocking);
+        // frames are small and late frames are useless
+        int noDelay = 1;
+        setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof(noDelay));
+        chip8StreamClient_t* client = &stream->clients[stream->clientCount];
+        client->buffer = malloc(CHIP8_STREAM_CLIENT_BUFFER);
+        if (client->buffer == NULL) {
+            closesocket(socket);
+            continue;
+        }
+        client->socket = socket;
+        client->instance = -1;
+        client->needsKeyframe = true;
+        client->start = 0;
+        client->length = 0;
+        client->messageLength = 0;
+        stream->clientCount++;
+    }
+}
+
+static void chip8_streamDisconnect(chip8Stream_t* stream, int index) {
+    closesocket(stream->clients[index].socket);
+    free(stream->clients[index].buffer);
+    // keep the viewers packed, the last one takes the free slot
+    stream->clients[index] = stream->clients[--stream->clientCount];
+}
+
+static DWORD WINAPI chip8_streamServe(LPVOID parameter) {
+    chip8Stream_t* stream = parameter;
+    while (stream->running) {
+        stream->polls[0].fd = stream->listener;
+        stream->polls[0].events = POLLRDNORM;
+        stream->polls[0].revents = 0;
+        for (int i = 0; i < stream->clientCount; i++) {
+            stream->polls[i + 1].fd = stream->clients[i].socket;
+            stream->polls[i + 1].events = (SHORT)(POLLRDNORM | (stream->clients[i].length > 0 ? POLLWRNORM : 0));
+            stream->polls[i + 1].revents = 0;
+        }
+        int polled = stream->clientCount + 1;
+        // the timeout doubles as the wait for the next published frame
+        if (WSAPoll(stream->polls, (ULONG)polled, CHIP8_STREAM_POLL_MS) == SOCKET_ERROR) {
+            fprintf(stderr, "Stream poll failed: %d\n", WSAGetLastError());
+            break;
+        }
+
+        // walk backwards so disconnecting, which moves the last viewer, does not skip anyone
+        for (int i = polled - 2; i >= 0; i--) {
+            SHORT events = stream->polls[i + 1].revents;
+            bool alive = (events & (POLLERR | POLLNVAL)) == 0;
+            if (alive && (events & (POLLRDNORM | POLLHUP)) != 0) {
+                alive = chip8_streamReceive(stream, &stream->clients[i]);
+            }
+            if (alive && (events & POLLWRNORM) != 0) {
+                alive = chip8_streamSend(&stream->clients[i]);
+            }
+            if (!alive) {
+                chip8_streamDisconnect(stream, i);
+            }
+        }
+        if (stream->polls[0].revents & POLLRDNORM) {
+            chip8_streamAccept(stream);
+        }
+
+        chip8_streamDistribute(stream);
+        // most sockets can take a frame right away, do not wait for the next poll to find out
+        for (int i = stream->clientCount - 1; i >= 0; i--) {
+            if (stream->clients[i].length > 0 && !chip8_streamSend(&stream->clients[i])) {
+                chip8_streamDisconnect(stream, i);
+            }
+        }
+    }
+    return 0;
+}
+
+chip8Stream_t* chip8_streamInit(uint16_t port, int instanceCount) {
+    WSADATA data;
+    if (WSAStartup(MAKEWORD(2, 2), &data) != 0) {
+        fprintf(stderr, "Failed to start Winsock\n");
+        return NULL;
+    }
+    SOCKET listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    // only viewers on the same host
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    u_long nonBlocking = 1;
+    if (listener == INVALID_SOCKET || bind(listener, (struct sockaddr*)&address, sizeof(address)) == SOCKET_ERROR ||
+        listen(listener, SOMAXCONN) == SOCKET_ERROR || ioctlsocket(listener, FIONBIO, &nonBlocking) == SOCKET_ERROR) {
+        fprintf(stderr, "Failed to listen on port %u: %d\n", port, WSAGetLastError());
+        if (listener != INVALID_SOCKET) {
+            closesocket(listener);
+        }
+        WSACleanup();
+        return NULL;
+    }
+
+    chip8Stream_t* stream = calloc(1, sizeof(chip8Stream_t));
+    stream->listener = listener;
+    stream->port = port;
+    stream->running = 1;
+    stream->instanceCount = instanceCount;
+    stream->instances = calloc((size_t)instanceCount, sizeof(chip8StreamInstance_t));
+    for (int i = 0; i < instanceCount; i++) {
+        InitializeCriticalSection(&stream->instances[i].lock);
+        stream->instances[i].width = CHIP8_GRAPHICS_WIDTH;
+        stream->instances[i].height = CHIP8_GRAPHICS_HEIGHT;
+    }
+    stream->clients = calloc(CHIP8_STREAM_MAX_CLIENTS, sizeof(chip8StreamClient_t));
+    stream->clientCount = 0;
+    stream->polls = calloc(CHIP8_STREAM_MAX_CLIENTS + 1, sizeof(WSAPOLLFD));
+    stream->thread = CreateThread(NULL, 0, chip8_streamServe, stream, 0, NULL);
+    if (stream->thread == NULL) {
+        fprintf(stderr, "Failed to start the stream thread\n");
+        stream->running = 0;
+        chip8_streamDel(&stream);
+    }
+    return stream;
+}
+
+void chip8_streamDel(chip8Stream_t** stream) {
+    if (stream != NULL && *stream != NULL) {
+        chip8Stream_t* server = *stream;
+        if (server->thread != NULL) {
+            InterlockedExchange(&server->running, 0);
+            WaitForSingleObject(server->thread, INFINITE);
+            CloseHandle(server->thread);
+        }
+        while (server->clientCount > 0) {
+            chip8_streamDisconnect(server, server->clientCount - 1);
+        }
+        closesocket(server->listener);
+        for (int i = 0; i < server->instanceCount; i++) {
+            DeleteCriticalSection(&server->instances[i].lock);
+        }
+        free(server->instances);
+        free(server->clients);
+        free(server->polls);
+        free(server);
+        WSACleanup();
+        *stream = NULL;
+    }
+}
+
+void chip8_streamPublish(chip8Stream_t* stream, int instance, const chip8State_t* state) {
+    chip8StreamInstance_t* published = &stream->instances[instance];
+    EnterCriticalSection(&published->lock);
+    memcpy(published->display, state->display, CHIP8_STREAM_FRAME_BYTES);
+    published->width = (uint16_t)state->width;
+    published->height = (uint16_t)state->height;
+    published->machine = (uint8_t)state->machine;
+    published->frame++;
+    LeaveCriticalSection(&published->lock);
+}
+
+void chip8_streamApplyKeys(chip8Stream_t* stream, int instance, chip8State_t* state) {
+    chip8StreamInstance_t* published = &stream->instances[instance];
+    EnterCriticalSection(&published->lock);
+    for (size_t i = 0; i < published->keyCount; i++) {
+        chip8_queueKey(state, published->keys[i].key, published->keys[i].value);
+    }
+    published->keyCount = 0;
+    LeaveCriticalSection(&published->lock);
+}
@@ -0,0 +1,115 @@
+#ifndef CHIP_8_CHIP8_STREAM_H
+#define CHIP_8_CHIP8_STREAM_H
+
+// winsock2.h has to come before windows.h, which chip8.h includes
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "chip8.h"
+
+#define CHIP8_STREAM_DEFAULT_PORT 8508
+#define CHIP8_STREAM_MAX_CLIENTS 1024
+#define CHIP8_STREAM_CLIENT_BUFFER 65536    // Bytes a viewer may fall behind before frames are dropped for it
+#define CHIP8_STREAM_KEYFRAME_INTERVAL 60   // Published frames between keyframes
+#define CHIP8_STREAM_POLL_MS 2              // Longest a new frame waits for the server thread
+#define CHIP8_STREAM_KEY_QUEUE 64
+// the whole packed display of every plane, the payload of a keyframe before run-length encoding
+#define CHIP8_STREAM_FRAME_BYTES (CHIP8_DISPLAY_PLANES * CHIP8_HIRES_HEIGHT * CHIP8_DISPLAY_WORDS * sizeof(uint64_t))
+// one run header per 128 literal bytes in the worst case
+#define CHIP8_STREAM_MAX_PAYLOAD (CHIP8_STREAM_FRAME_BYTES + CHIP8_STREAM_FRAME_BYTES / 128)
+#define CHIP8_STREAM_HEADER_SIZE 16
+#define CHIP8_STREAM_MESSAGE_SIZE 4
+#define CHIP8_STREAM_RUN_MAX 128
+
+/*
+ * Protocol, every integer is little endian
+ * Viewer to server, 4 byte messages:
+ *   'S' 0 <instance:u16>   subscribe to an instance, a keyframe follows as soon as the instance has a frame
+ *   'K' <key> <value:u16>  press (value 1) or release (value 0) a key of the keypad
+ * Server to viewer, a 16 byte header and a payload:
+ *   'C' '8' <type> <machine> <frame:u32> <width:u16> <height:u16> <payload length:u32>
+ *   type 'K' is a keyframe, 'D' a delta against the last frame the viewer got, frames that change nothing are not
+ *   sent. The payload XORed onto that frame (zeros for a keyframe) gives CHIP8_STREAM_FRAME_BYTES of packed display,
+ *   see chip8State_t.display, with the 64 bit words in little endian. It is a sequence of runs, a byte N < 128 stands
+ *   for N + 1 zero bytes, a byte 128 + N is followed by N + 1 literal bytes.
+ */
+
+typedef struct {
+    CRITICAL_SECTION lock;      // Guards everything the emulator and the server thread share below
+    uint8_t display[CHIP8_STREAM_FRAME_BYTES]; // Most recent published display
+    uint16_t width;
+    uint16_t height;
+    uint8_t machine;
+    uint32_t frame;             // Frames published so far
+    chip8KeyEvent_t keys[CHIP8_STREAM_KEY_QUEUE]; // Key events from viewers waiting for the emulator
+    size_t keyCount;
+    // only touched by the server thread
+    uint32_t sentFrame;         // Last frame encoded
+    uint16_t sentWidth;
+    uint16_t sentHeight;
+    uint32_t sinceKeyframe;     // Frames encoded since the last periodic keyframe
+    uint8_t previous[CHIP8_STREAM_FRAME_BYTES]; // Last frame encoded, deltas are against it
+    uint8_t current[CHIP8_STREAM_FRAME_BYTES];  // Copy of the published display taken under the lock
+} chip8StreamInstance_t;
+
+typedef struct {
+    SOCKET socket;
+    int instance;               // Subscribed instance or -1
+    bool needsKeyframe;         // Whether the viewer missed a frame and can not apply deltas
+    uint8_t* buffer;            // Bytes waiting to be sent, CHIP8_STREAM_CLIENT_BUFFER long
+    size_t start;               // First byte not sent yet
+    size_t length;              // End of the bytes not sent yet
+    uint8_t message[CHIP8_STREAM_MESSAGE_SIZE]; // Partially received message
+    size_t messageLength;
+} chip8StreamClient_t;
+
+typedef struct chip8Stream {
+    SOCKET listener;
+    uint16_t port;
+    HANDLE thread;              // The server thread multiplexing every viewer of every instance
+    volatile LONG running;
+    int instanceCount;
+    chip8StreamInstance_t* instances;
+    chip8StreamClient_t* clients;
+    int clientCount;
+    WSAPOLLFD* polls;
+    uint64_t framesSent;        // Frames queued for viewers
+    uint64_t framesDropped;     // Frames a viewer was too far behind to take
+} chip8Stream_t;
+
+/**
+ * Starts serving instances to viewers on a local TCP port
+ * A single server thread accepts viewers, encodes frames and reads key events for every instance. The emulator only
+ * ever holds a per instance lock for a copy, so slow viewers never stall it, they lose frames and get a keyframe.
+ * @param port The port on 127.0.0.1 to listen on
+ * @param instanceCount The number of instances served
+ * @return A pointer to the created chip8Stream_t struct or NULL if the port could not be opened
+ */
+chip8Stream_t* chip8_streamInit(uint16_t port, int instanceCount);
+
+/**
+ * Stops the server thread, disconnects every viewer and frees the server
+ * It also nulls the pointer to the object during deletion
+ * @param stream A pointer to the pointer to be freed of type chip8Stream_t**
+ */
+void chip8_streamDel(chip8Stream_t** stream);
+
+/**
+ * Publishes the display of an instance, its viewers get it the next time the server thread runs
+ * @param stream A pointer to the server
+ * @param instance The index of the instance
+ * @param state A pointer to the state of the instance
+ */
+void chip8_streamPublish(chip8Stream_t* stream, int instance, const chip8State_t* state);
+
+/**
+ * Hands the key events viewers sent for an instance to the machine with chip8_queueKey
+ * @param stream A pointer to the server
+ * @param instance The index of the instance
+ * @param state A pointer to the state of the instance
+ */
+void chip8_streamApplyKeys(chip8Stream_t* stream, int instance, chip8State_t* state);
+
+#endif //CHIP_8_CHIP8_STREAM_H
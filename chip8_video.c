@@ -0,0 +1,105 @@
+#include <stdlib.h>
+#include <string.h>
+#include "chip8.h"
+#include "chip8_video.h"
+
+chip8VideoWriter_t* chip8_videoInit(FILE* out, enum chip8_videoFormat format, int displayWidth, int displayHeight,
+                                    int scale, bool deduplicate, double frameSeconds, FILE* timecodes) {
+    chip8VideoWriter_t* writer = calloc(1, sizeof(chip8VideoWriter_t));
+    if (writer == NULL) {
+        return NULL;
+    }
+    writer->out = out;
+    writer->timecodes = timecodes;
+    writer->format = format;
+    writer->scale = scale > 0 ? scale : 1;
+    writer->displayWidth = displayWidth;
+    writer->displayHeight = displayHeight;
+    writer->width = displayWidth * writer->scale;
+    writer->height = displayHeight * writer->scale;
+    writer->bytesPerPixel = format == Chip8_Video_Format_Y4M ? 1 : 3;
+    writer->deduplicate = deduplicate;
+    writer->frameSeconds = frameSeconds;
+    writer->imageSize = (size_t)writer->width * writer->height * writer->bytesPerPixel;
+    writer->previous = calloc(CHIP8_DISPLAY_SIZE, sizeof(uint8_t));
+    writer->image = malloc(writer->imageSize);
+    if (writer->previous == NULL || writer->image == NULL) {
+        chip8_videoDel(&writer);
+        return NULL;
+    }
+
+    if (format == Chip8_Video_Format_Y4M) {
+        // the frame rate is written as frames per million microseconds
+        fprintf(out, "YUV4MPEG2 W%d H%d F%d:%d Ip A1:1 Cmono\n", writer->width, writer->height, 1000000,
+                (int)(frameSeconds * 1000000.0 + 0.5));
+    }
+    if (timecodes != NULL) {
+        fprintf(timecodes, "# timecode format v2\n");
+    }
+    return writer;
+}
+
+void chip8_videoDel(chip8VideoWriter_t** writer) {
+    if (writer != NULL && *writer != NULL) {
+        free((*writer)->previous);
+        (*writer)->previous = NULL;
+        free((*writer)->image);
+        (*writer)->image = NULL;
+        free(*writer);
+        *writer = NULL;
+    }
+}
+
+static void chip8_videoScale(chip8VideoWriter_t* writer, const uint8_t* pixels, int width, int height) {
+    uint8_t levels[CHIP8_PALETTE_SIZE];
+    for (int i = 0; i < CHIP8_PALETTE_SIZE; i++) {
+        // Y4M luma only spans 16 to 235
+        levels[i] = writer->format == Chip8_Video_Format_Y4M
+                    ? (uint8_t)(CHIP8_VIDEO_Y4M_BLACK +
+                                chip8_palette[i] * (CHIP8_VIDEO_Y4M_WHITE - CHIP8_VIDEO_Y4M_BLACK) / 255)
+                    : chip8_palette[i];
+    }
+    // a low resolution display fills the same output as the largest one
+    int scale = writer->scale * (writer->displayWidth / width);
+    size_t pixelSize = (size_t)scale * writer->bytesPerPixel;
+    size_t rowSize = (size_t)writer->width * writer->bytesPerPixel;
+
+    for (int y = 0; y < height; y++) {
+        // build the first line of each row of chip 8 pixels, then copy it down
+        uint8_t* line = &writer->image[(size_t)y * scale * rowSize];
+        for (int x = 0; x < width; x++) {
+            memset(&line[x * pixelSize], levels[pixels[y * width + x]], pixelSize);
+        }
+        for (int copy = 1; copy < scale; copy++) {
+            memcpy(&line[copy * rowSize], line, rowSize);
+        }
+    }
+}
+
+bool chip8_videoWriteFrame(chip8VideoWriter_t* writer, const uint8_t* pixels, int width, int height) {
+    uint64_t frame = writer->frames++;
+    bool changed = !writer->hasPrevious || width != writer->previousWidth || height != writer->previousHeight ||
+                   memcmp(writer->previous, pixels, (size_t)width * height) != 0;
+    if (!changed && writer->deduplicate) {
+        return false;
+    }
+    if (changed) {
+        chip8_videoScale(writer, pixels, width, height);
+        memcpy(writer->previous, pixels, (size_t)width * height);
+        writer->previousWidth = width;
+        writer->previousHeight = height;
+        writer->hasPrevious = true;
+    }
+
+    if (writer->format == Chip8_Video_Format_Y4M) {
+        fputs("FRAME\n", writer->out);
+    } else {
+        fprintf(writer->out, "P6\n%d %d\n255\n", writer->width, writer->height);
+    }
+    fwrite(writer->image, 1, writer->imageSize, writer->out);
+    if (writer->timecodes != NULL) {
+        fprintf(writer->timecodes, "%.3f\n", (double)frame * writer->frameSeconds * 1000.0);
+    }
+    writer->written++;
+    return true;
+}
@@ -0,0 +1,68 @@
+#ifndef CHIP_8_CHIP8_VIDEO_H
+#define CHIP_8_CHIP8_VIDEO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#define CHIP8_VIDEO_Y4M_BLACK 16
+#define CHIP8_VIDEO_Y4M_WHITE 235
+
+enum chip8_videoFormat { Chip8_Video_Format_Y4M, Chip8_Video_Format_PPM };
+
+typedef struct {
+    FILE* out;                      // Stream the frames are written to
+    FILE* timecodes;                // Optional timecode file with the presentation time of each written frame
+    enum chip8_videoFormat format;  // Container of the stream
+    int scale;                      // Width and height of each chip 8 pixel of the largest display in the output
+    int displayWidth;               // Width of the largest display the machine can switch to
+    int displayHeight;              // Height of the largest display the machine can switch to
+    int width;                      // Width of the output in pixels
+    int height;                     // Height of the output in pixels
+    int bytesPerPixel;              // 1 for Y4M luma, 3 for PPM RGB
+    bool deduplicate;               // Whether unchanged frames are dropped instead of written again
+    double frameSeconds;            // Emulated time between two frames
+    uint8_t* previous;              // Unpacked display of the last frame written
+    int previousWidth;              // Width of the last frame written
+    int previousHeight;             // Height of the last frame written
+    uint8_t* image;                 // Scaled image of the last frame written
+    size_t imageSize;               // Size of image in bytes
+    bool hasPrevious;               // Whether a frame has been written yet
+    uint64_t frames;                // Frames passed to chip8_videoWriteFrame
+    uint64_t written;               // Frames actually written
+} chip8VideoWriter_t;
+
+/**
+ * Initializes a writer and writes the stream header
+ * @param out The stream to write to, opened in binary mode
+ * @param format Whether to write a Y4M (mono) stream or a stream of concatenated binary PPM images
+ * @param displayWidth The width of the largest display of the machine, smaller ones are scaled up to it
+ * @param displayHeight The height of the largest display of the machine
+ * @param scale The width and height of each pixel of the largest display in the output
+ * @param deduplicate Whether to drop frames identical to the previous one
+ * @param frameSeconds The emulated time between two frames
+ * @param timecodes A stream for the presentation times of written frames in timecode v2 format, or NULL
+ * @return A pointer to the created chip8VideoWriter_t struct or NULL if it could not be allocated
+ */
+chip8VideoWriter_t* chip8_videoInit(FILE* out, enum chip8_videoFormat format, int displayWidth, int displayHeight,
+                                    int scale, bool deduplicate, double frameSeconds, FILE* timecodes);
+
+/**
+ * Frees a writer, the streams are left open
+ * It also nulls the pointer to the object during deletion
+ * @param writer A pointer to the pointer to be freed of type chip8VideoWriter_t**
+ */
+void chip8_videoDel(chip8VideoWriter_t** writer);
+
+/**
+ * Writes one frame of emulated time. An unchanged frame is dropped when deduplicating and otherwise written again
+ * without being scaled again.
+ * @param writer A pointer to the writer
+ * @param pixels The display unpacked by chip8_unpackDisplay
+ * @param width The width of the display in pixels
+ * @param height The height of the display in pixels
+ * @return If the frame was written
+ */
+bool chip8_videoWriteFrame(chip8VideoWriter_t* writer, const uint8_t* pixels, int width, int height);
+
+#endif //CHIP_8_CHIP8_VIDEO_H
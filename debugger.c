@@ -0,0 +1,208 @@
+#include <stdlib.h>
+#include <string.h>
+#include "chip8.h"
+#include "chip8_debugger.h"
+
+#define DEBUGGER_LINE_SIZE 256
+// a minute of machine time
+#define DEBUGGER_DEFAULT_CYCLES (CHIP8_CYCLES_PER_TIMER_UPDATE * 60 * 60)
+#define DEBUGGER_LIST_COUNT 10
+#define DEBUGGER_DUMP_LENGTH 64
+
+static void debugger_usage(void) {
+    fprintf(stderr, "Usage: debugger <rom.ch8> [--schip|--xochip]\n");
+}
+
+static void debugger_help(void) {
+    printf("Numbers are hexadecimal.\n"
+           "  b <addr> [if V<x> <op> <value>]  break before the instruction at addr, op is == != < > <= >=\n"
+           "  w <addr> [length]                stop before FX33 or FX55 writes to the bytes\n"
+           "  d <n> / dw <n>                   delete breakpoint / watchpoint n\n"
+           "  i                                list breakpoints and watchpoints\n"
+           "  c [cycles]                       continue until something stops execution\n"
+           "  s [count]                        step instructions\n"
+           "  n                                step over a 2NNN call\n"
+           "  r                                registers\n"
+           "  bt                               stack\n"
+           "  l [addr] [count]                 disassemble, from PC by default\n"
+           "  x <addr> [length]                dump memory\n"
+           "  p                                print the display\n"
+           "  k <key> <0|1>                    release or press a key of the keypad\n"
+           "  q                                quit\n");
+}
+
+static void debugger_where(const chip8Debugger_t* debugger) {
+    // step over stops at a temporary breakpoint that is gone by now
+    if (debugger->reason == Chip8_Stop_Breakpoint && debugger->breakpoints[debugger->hit].used) {
+        printf("breakpoint %d\n", debugger->hit);
+    } else if (debugger->reason == Chip8_Stop_Watchpoint) {
+        printf("watchpoint %d, about to write 0x%04X\n", debugger->hit, debugger->watchAddress);
+    }
+    chip8_debuggerPrintDisassembly(debugger, debugger->state->PC, 1, stdout);
+}
+
+static void debugger_dump(const chip8State_t* state, uint16_t address, uint16_t length) {
+    for (uint16_t i = 0; i < length; i++) {
+        uint16_t at = (uint16_t)((address + i) & state->memMask);
+        if (i % 16 == 0) {
+            printf("%s0x%04X ", i > 0 ? "\n" : "", at);
+        }
+        printf(" %02X", state->memory[at]);
+    }
+    printf("\n");
+}
+
+static void debugger_display(const chip8State_t* state) {
+    uint8_t pixels[CHIP8_DISPLAY_SIZE];
+    static const char shades[] = ".#+*";
+    chip8_unpackDisplay(state, pixels);
+    char line[CHIP8_HIRES_WIDTH + 1];
+    for (int y = 0; y < state->height; y++) {
+        for (int x = 0; x < state->width; x++) {
+            line[x] = shades[pixels[y * state->width + x] & 0x03u];
+        }
+        line[state->width] = '\0';
+        printf("%s\n", line);
+    }
+}
+
+static bool debugger_condition(const char* text, enum chip8_condition* condition) {
+    for (int i = Chip8_Condition_Equal; i < CHIP8_CONDITIONS; i++) {
+        if (strcmp(text, chip8_conditionNames[i]) == 0) {
+            *condition = (enum chip8_condition)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void debugger_break(chip8Debugger_t* debugger, const char* arguments) {
+    unsigned address;
+    unsigned reg;
+    unsigned value;
+    char op[4];
+    enum chip8_condition condition = Chip8_Condition_Always;
+    int fields = sscanf(arguments, "%x if V%x %3s %x", &address, &reg, op, &value);
+    if (fields == 1) {
+        reg = 0;
+        value = 0;
+    } else if (fields != 4 || reg > 0xF || !debugger_condition(op, &condition)) {
+        printf("usage: b <addr> [if V<x> <op> <value>]\n");
+        return;
+    }
+    int index = chip8_debuggerAddBreakpoint(debugger, (uint16_t)address, condition, (uint8_t)reg, (uint8_t)value);
+    if (index < 0) {
+        printf("every breakpoint is in use\n");
+    } else {
+        printf("breakpoint %d at 0x%04X\n", index, debugger->breakpoints[index].address);
+    }
+}
+
+static bool debugger_report(chip8Debugger_t* debugger, bool ok) {
+    if (!ok) {
+        printf("the machine stopped on an invalid instruction\n");
+    }
+    debugger_where(debugger);
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        debugger_usage();
+        return 1;
+    }
+    enum chip8_machine machine = Chip8_Machine_Chip8;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--schip") == 0) {
+            machine = Chip8_Machine_SuperChip;
+        } else if (strcmp(argv[i], "--xochip") == 0) {
+            machine = Chip8_Machine_XoChip;
+        } else {
+            debugger_usage();
+            return 1;
+        }
+    }
+
+    chip8State_t* state = chip8_initMachine(machine, NULL);
+    if (!chip8_loadGame(state, argv[1])) {
+        chip8_del(&state);
+        return 1;
+    }
+    chip8Debugger_t* debugger = chip8_debuggerInit(state);
+    debugger_where(debugger);
+
+    char line[DEBUGGER_LINE_SIZE];
+    char command[8];
+    bool running = true;
+    while (running) {
+        printf("(chip8) ");
+        fflush(stdout);
+        if (fgets(line, sizeof(line), stdin) == NULL) {
+            break;
+        }
+        int consumed = 0;
+        if (sscanf(line, "%7s%n", command, &consumed) != 1) {
+            continue;
+        }
+        const char* arguments = line + consumed;
+        unsigned first;
+        unsigned second;
+        int fields = sscanf(arguments, "%x %x", &first, &second);
+
+        if (strcmp(command, "b") == 0) {
+            debugger_break(debugger, arguments);
+        } else if (strcmp(command, "w") == 0 && fields >= 1) {
+            int index = chip8_debuggerAddWatchpoint(debugger, (uint16_t)first, (uint16_t)(fields == 2 ? second : 1));
+            if (index < 0) {
+                printf("every watchpoint is in use\n");
+            } else {
+                printf("watchpoint %d\n", index);
+            }
+        } else if (strcmp(command, "d") == 0 && fields >= 1) {
+            if (!chip8_debuggerRemoveBreakpoint(debugger, (int)first)) {
+                printf("no breakpoint %u\n", first);
+            }
+        } else if (strcmp(command, "dw") == 0 && fields >= 1) {
+            if (!chip8_debuggerRemoveWatchpoint(debugger, (int)first)) {
+                printf("no watchpoint %u\n", first);
+            }
+        } else if (strcmp(command, "i") == 0) {
+            chip8_debuggerPrintPoints(debugger, stdout);
+        } else if (strcmp(command, "c") == 0) {
+            running = debugger_report(debugger, chip8_debuggerContinue(debugger, fields >= 1 ? first :
+                                                                                DEBUGGER_DEFAULT_CYCLES));
+            if (running && !debugger->stopped) {
+                printf("still running after %u cycles\n", fields >= 1 ? first : DEBUGGER_DEFAULT_CYCLES);
+            }
+        } else if (strcmp(command, "s") == 0) {
+            bool ok = true;
+            for (unsigned i = 0; i < (fields >= 1 ? first : 1) && ok; i++) {
+                ok = chip8_debuggerStep(debugger);
+            }
+            running = debugger_report(debugger, ok);
+        } else if (strcmp(command, "n") == 0) {
+            running = debugger_report(debugger, chip8_debuggerStepOver(debugger, DEBUGGER_DEFAULT_CYCLES));
+        } else if (strcmp(command, "r") == 0) {
+            chip8_debuggerPrintRegisters(debugger, stdout);
+        } else if (strcmp(command, "bt") == 0) {
+            chip8_debuggerPrintStack(debugger, stdout);
+        } else if (strcmp(command, "l") == 0) {
+            chip8_debuggerPrintDisassembly(debugger, (uint16_t)(fields >= 1 ? first : state->PC),
+                                           fields == 2 ? (int)second : DEBUGGER_LIST_COUNT, stdout);
+        } else if (strcmp(command, "x") == 0 && fields >= 1) {
+            debugger_dump(state, (uint16_t)first, (uint16_t)(fields == 2 ? second : DEBUGGER_DUMP_LENGTH));
+        } else if (strcmp(command, "p") == 0) {
+            debugger_display(state);
+        } else if (strcmp(command, "k") == 0 && fields == 2 && first < CHIP8_KEYS_SIZE) {
+            chip8_queueKey(state, (int)first, second != 0);
+        } else if (strcmp(command, "q") == 0) {
+            break;
+        } else {
+            debugger_help();
+        }
+    }
+
+    chip8_debuggerDel(&debugger);
+    chip8_del(&state);
+    return running ? 0 : 1;
+}
@@ -0,0 +1,126 @@
+#include <stdlib.h>
+#include <string.h>
+#include "chip8_env.h"
+
+#define ENVBENCH_DEFAULT_INSTANCES 64
+#define ENVBENCH_DEFAULT_STEPS 1000
+#define ENVBENCH_DEFAULT_SKIP 4
+
+static void envbench_usage(void) {
+    fprintf(stderr, "Usage: envbench <rom.ch8> [--instances N] [--workers N] [--steps N] [--skip N] [--seed N] "
+                    "[--reward ADDR] [--done ADDR VALUE] [--packed] [--schip|--xochip]\n");
+}
+
+static double envbench_seconds(void) {
+    LARGE_INTEGER now;
+    LARGE_INTEGER frequency;
+    QueryPerformanceCounter(&now);
+    QueryPerformanceFrequency(&frequency);
+    return (double)now.QuadPart / (double)frequency.QuadPart;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        envbench_usage();
+        return 1;
+    }
+
+    const char* romPath = argv[1];
+    int instanceCount = ENVBENCH_DEFAULT_INSTANCES;
+    int workerCount = 0;
+    int steps = ENVBENCH_DEFAULT_STEPS;
+    int frameSkip = ENVBENCH_DEFAULT_SKIP;
+    uint32_t seed = CHIP8_RANDOM_SEED;
+    bool packed = false;
+    int reward = -1;
+    int doneAddress = -1;
+    int doneValue = 0;
+    enum chip8_machine machine = Chip8_Machine_Chip8;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--instances") == 0 && i + 1 < argc) {
+            instanceCount = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            workerCount = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--steps") == 0 && i + 1 < argc) {
+            steps = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--skip") == 0 && i + 1 < argc) {
+            frameSkip = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--reward") == 0 && i + 1 < argc) {
+            reward = (int)strtol(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--done") == 0 && i + 2 < argc) {
+            doneAddress = (int)strtol(argv[++i], NULL, 0);
+            doneValue = (int)strtol(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--packed") == 0) {
+            packed = true;
+        } else if (strcmp(argv[i], "--schip") == 0) {
+            machine = Chip8_Machine_SuperChip;
+        } else if (strcmp(argv[i], "--xochip") == 0) {
+            machine = Chip8_Machine_XoChip;
+        } else {
+            envbench_usage();
+            return 1;
+        }
+    }
+
+    chip8Env_t* env = chip8_envInit(romPath, machine, instanceCount, workerCount, frameSkip, seed);
+    if (env == NULL) {
+        return 1;
+    }
+    if (reward >= 0) {
+        chip8_envAddReward(env, (uint16_t)reward, Chip8_Env_Value_Byte, 1.0f);
+    }
+    if (doneAddress >= 0) {
+        chip8_envAddDone(env, (uint16_t)doneAddress, Chip8_Env_Value_Byte, doneValue);
+    }
+    chip8_envSetObservation(env, packed ? Chip8_Env_Observation_Packed : Chip8_Env_Observation_Unpacked);
+    size_t observationSize = chip8_envObservationSize(env);
+    uint8_t* observations = malloc(observationSize * instanceCount);
+    uint16_t* actions = malloc(instanceCount * sizeof(uint16_t));
+    float* rewards = malloc(instanceCount * sizeof(float));
+    uint8_t* dones = malloc(instanceCount);
+    if (observations == NULL || actions == NULL || rewards == NULL || dones == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    memset(actions, 0, instanceCount * sizeof(uint16_t));
+    chip8_envReset(env, observations);
+    // the agent presses one random key or none and keeps it for a few steps, like a policy early in training
+    uint32_t random = seed != 0 ? seed : CHIP8_RANDOM_SEED;
+    uint64_t episodes = 0;
+    double totalReward = 0.0;
+    double start = envbench_seconds();
+    for (int step = 0; step < steps; step++) {
+        for (int i = 0; i < instanceCount; i++) {
+            random ^= random << 13u;
+            random ^= random >> 17u;
+            random ^= random << 5u;
+            if ((random & 7u) == 0) {
+                uint32_t key = (random >> 8u) % (CHIP8_KEYS_SIZE + 1);
+                actions[i] = key == CHIP8_KEYS_SIZE ? 0 : (uint16_t)(1u << key);
+            }
+        }
+        chip8_envStep(env, actions, observations, rewards, dones);
+        for (int i = 0; i < instanceCount; i++) {
+            totalReward += rewards[i];
+            episodes += dones[i] != Chip8_Env_Done_None;
+        }
+    }
+    double elapsed = envbench_seconds() - start;
+
+    printf("%d instances on %d workers, %d steps of %d frames\n", instanceCount, env->workerCount, steps, frameSkip);
+    printf("%.0f steps/s, %.0f frames/s, %.3f us per instance step\n", (double)steps * instanceCount / elapsed,
+           (double)steps * instanceCount * frameSkip / elapsed, 1e6 * elapsed / ((double)steps * instanceCount));
+    // the same seed gives the same hash whatever the number of workers
+    printf("%llu episodes ended, total reward %.1f, observation hash %016llx\n", (unsigned long long)episodes,
+           totalReward, (unsigned long long)chip8_romHash(observations, observationSize * instanceCount));
+
+    free(dones);
+    free(rewards);
+    free(actions);
+    free(observations);
+    chip8_envDel(&env);
+    return 0;
+}
@@ -0,0 +1,111 @@
+#include <fcntl.h>
+#include <io.h>
+#include <stdlib.h>
+#include <string.h>
+#include "chip8.h"
+#include "chip8_video.h"
+
+#define EXPORT_DEFAULT_SECONDS 60
+#define EXPORT_DEFAULT_SCALE 8
+
+static void export_usage(void) {
+    fprintf(stderr, "Usage: export <rom.ch8> <output|-> [--seconds N] [--scale N] [--ppm] [--dedup] "
+                    "[--timecodes file] "
+                    "[--schip|--xochip] [--vip]\n");
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        export_usage();
+        return 1;
+    }
+
+    const char* romPath = argv[1];
+    const char* outputPath = argv[2];
+    double seconds = EXPORT_DEFAULT_SECONDS;
+    int scale = EXPORT_DEFAULT_SCALE;
+    enum chip8_videoFormat format = Chip8_Video_Format_Y4M;
+    bool deduplicate = false;
+    const char* timecodesPath = NULL;
+    enum chip8_machine machine = Chip8_Machine_Chip8;
+    bool vipTiming = false;
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            seconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc) {
+            scale = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--ppm") == 0) {
+            format = Chip8_Video_Format_PPM;
+        } else if (strcmp(argv[i], "--dedup") == 0) {
+            deduplicate = true;
+        } else if (strcmp(argv[i], "--timecodes") == 0 && i + 1 < argc) {
+            timecodesPath = argv[++i];
+        } else if (strcmp(argv[i], "--vip") == 0) {
+            vipTiming = true;
+        } else if (strcmp(argv[i], "--schip") == 0) {
+            machine = Chip8_Machine_SuperChip;
+        } else if (strcmp(argv[i], "--xochip") == 0) {
+            machine = Chip8_Machine_XoChip;
+        } else {
+            export_usage();
+            return 1;
+        }
+    }
+
+    FILE* out;
+    if (strcmp(outputPath, "-") == 0) {
+        // frames are binary, stop the runtime from translating newlines
+        _setmode(_fileno(stdout), _O_BINARY);
+        out = stdout;
+    } else {
+        out = fopen(outputPath, "wb");
+    }
+    FILE* timecodes = timecodesPath != NULL ? fopen(timecodesPath, "w") : NULL;
+    if (out == NULL || (timecodesPath != NULL && timecodes == NULL)) {
+        fprintf(stderr, "Failed to open output\n");
+        return 1;
+    }
+
+    // the trace would cost far more than the emulation itself
+    chip8State_t* state = chip8_initMachine(machine, NULL);
+    if (!chip8_loadGame(state, romPath)) {
+        chip8_del(&state);
+        return 1;
+    }
+    double frameSeconds = vipTiming ? CHIP8_VIP_FRAME_SECS : CHIP8_ALLEGRO_TIMER_UPDATE_SECS;
+    // anything but the original machine can switch to high resolution at any time, --scale stays the size of a
+    // low resolution pixel
+    bool hires = machine != Chip8_Machine_Chip8;
+    chip8VideoWriter_t* writer = chip8_videoInit(out, format, hires ? CHIP8_HIRES_WIDTH : CHIP8_GRAPHICS_WIDTH,
+                                                 hires ? CHIP8_HIRES_HEIGHT : CHIP8_GRAPHICS_HEIGHT,
+                                                 hires ? (scale + 1) / 2 : scale, deduplicate,
+                                                 frameSeconds, timecodes);
+    if (writer == NULL) {
+        fprintf(stderr, "Failed to allocate video writer\n");
+        chip8_del(&state);
+        return 1;
+    }
+
+    uint8_t pixels[CHIP8_DISPLAY_SIZE];
+    long frames = (long)(seconds / frameSeconds);
+    for (long frame = 0; frame < frames; frame++) {
+        if (!(vipTiming ? chip8_emulateVipFrame(state) : chip8_emulateFrame(state))) {
+            break;
+        }
+        chip8_unpackDisplay(state, pixels);
+        chip8_videoWriteFrame(writer, pixels, state->width, state->height);
+        state->drawFlag = false;
+    }
+    fprintf(stderr, "%llu frames emulated, %llu written\n", (unsigned long long)writer->frames,
+            (unsigned long long)writer->written);
+
+    chip8_videoDel(&writer);
+    chip8_del(&state);
+    if (out != stdout) {
+        fclose(out);
+    }
+    if (timecodes != NULL) {
+        fclose(timecodes);
+    }
+    return 0;
+}
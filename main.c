@@ -1,9 +1,115 @@
+#include <stdlib.h>
+#include <string.h>
 #include "chip8.h"
 
-int main() {
-    chip8State_t* state = chip8_init();
-    chip8_loadGame(state, "..\\roms\\Tic-Tac-Toe.ch8");
+int main(int argc, char** argv) {
+    const char* romPath = "..\\roms\\Tic-Tac-Toe.ch8";
+    bool publish = false;
+    bool lateLatch = false;
+    bool latency = false;
+    bool pacing = false;
+    enum chip8_machine machine = Chip8_Machine_Chip8;
+    bool vipTiming = false;
+    bool strictMemory = false;
+    enum chip8_scalerFilter filter = Chip8_Scaler_Filter_Nearest;
+    int scale = CHIP8_SCALED_PIXEL_SIZE;
+    int phosphor = 0;
+    bool scanlines = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--publish") == 0) {
+            publish = true;
+        } else if (strcmp(argv[i], "--late-latch") == 0) {
+            lateLatch = true;
+        } else if (strcmp(argv[i], "--latency") == 0) {
+            latency = true;
+        } else if (strcmp(argv[i], "--pacing") == 0) {
+            pacing = true;
+        } else if (strcmp(argv[i], "--vip") == 0) {
+            vipTiming = true;
+        } else if (strcmp(argv[i], "--strict") == 0) {
+            strictMemory = true;
+        } else if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc) {
+            scale = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--scale2x") == 0) {
+            filter = Chip8_Scaler_Filter_Scale2x;
+        } else if (strcmp(argv[i], "--scale3x") == 0) {
+            filter = Chip8_Scaler_Filter_Scale3x;
+        } else if (strcmp(argv[i], "--phosphor") == 0 && i + 1 < argc) {
+            phosphor = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--scanlines") == 0) {
+            scanlines = true;
+        } else if (strcmp(argv[i], "--schip") == 0) {
+            machine = Chip8_Machine_SuperChip;
+        } else if (strcmp(argv[i], "--xochip") == 0) {
+            machine = Chip8_Machine_XoChip;
+        } else {
+            romPath = argv[i];
+        }
+    }
+
+    chip8State_t* state = chip8_initMachine(machine, CHIP8_LOG_PATH);
+    chip8_loadGame(state, romPath);
+    if (publish) {
+        state->shared = chip8_sharedInit(NULL);
+        if (state->shared != NULL) {
+            fprintf(stderr, "Publishing state to %s\n", state->shared->name);
+        }
+    }
+    state->lateLatch = lateLatch;
+    state->vipTiming = vipTiming;
+    state->strictMemory = strictMemory;
+    if (latency) {
+        state->latency = chip8_latencyInit();
+    }
+    if (pacing) {
+        state->pacing = chip8_pacingInit(vipTiming ? CHIP8_VIP_FRAME_SECS : CHIP8_ALLEGRO_TIMER_UPDATE_SECS);
+    }
+    // --scale is the size of a low resolution pixel, high resolution pixels are half as big and need at least one
+    if (scale < 2) {
+        scale = 2;
+    }
+    if (phosphor < 0 || phosphor > 255) {
+        phosphor = phosphor < 0 ? 0 : 255;
+    }
+    state->scaler = chip8_scalerInit(filter, CHIP8_GRAPHICS_WIDTH * scale, CHIP8_GRAPHICS_HEIGHT * scale,
+                                     (uint8_t)phosphor, scanlines);
+#ifdef CHIP8_PROFILE
+    state->profiler = chip8_profilerInit(1, state->memSize);
+#endif
     chip8_run(state);
+#ifdef CHIP8_PROFILE
+    FILE* folded = fopen("..\\logs\\profile.folded", "w");
+    FILE* report = fopen("..\\logs\\profile.txt", "w");
+    FILE* heatmap = fopen("..\\logs\\heatmap.ppm", "wb");
+    if (folded != NULL && report != NULL && heatmap != NULL) {
+        chip8_profilerWriteFolded(state->profiler, folded);
+        chip8_profilerWriteReport(state->profiler, report);
+        chip8_profilerWriteHeatmap(state->profiler, heatmap, 8);
+    } else {
+        fprintf(stderr, "Failed to open profile output\n");
+    }
+    if (folded != NULL) {
+        fclose(folded);
+    }
+    if (report != NULL) {
+        fclose(report);
+    }
+    if (heatmap != NULL) {
+        fclose(heatmap);
+    }
+    chip8_profilerDel(&state->profiler);
+#endif
+    if (state->latency != NULL) {
+        chip8_latencyReport(state->latency, stderr);
+        chip8_latencyDel(&state->latency);
+    }
+    if (state->pacing != NULL) {
+        chip8_pacingReport(state->pacing, stderr);
+        chip8_pacingDel(&state->pacing);
+    }
+    chip8_writeFaults(state, stderr);
+    chip8_scalerDel(&state->scaler);
+    chip8_sharedDel(&state->shared);
     chip8_del(&state);
     return 0;
 }
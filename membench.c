@@ -0,0 +1,70 @@
+#include <stdlib.h>
+#include <string.h>
+#include "chip8.h"
+
+#define MEMBENCH_DEFAULT_INSTRUCTIONS 20000000
+#define MEMBENCH_ROM_SIZE 32
+#define MEMBENCH_INSIDE 0x300       // Base address far from the end of memory
+
+static const char* membench_machines[] = {"chip8", "schip", "xochip"};
+
+static double membench_seconds(void) {
+    LARGE_INTEGER now;
+    LARGE_INTEGER frequency;
+    QueryPerformanceCounter(&now);
+    QueryPerformanceFrequency(&frequency);
+    return (double)now.QuadPart / (double)frequency.QuadPart;
+}
+
+// a loop of the instructions that access memory through I, with I at base: BCD, storing and loading every
+// register, a sprite of 15 rows and the loop counter
+static size_t membench_program(enum chip8_machine machine, uint16_t base, uint8_t* rom) {
+    size_t size = 0;
+    if (machine == Chip8_Machine_XoChip) {
+        const uint8_t address[] = {0xF0, 0x00, (uint8_t)(base >> 8u), (uint8_t)base};
+        memcpy(rom, address, sizeof(address));
+        size += sizeof(address);
+    } else {
+        rom[size++] = (uint8_t)(0xA0 | (base >> 8u));
+        rom[size++] = (uint8_t)base;
+    }
+    const uint8_t loop[] = {0x6A, 0x7B, 0xFA, 0x33, 0xFF, 0x55, 0xFF, 0x65, 0xD0, 0x1F, 0x70, 0x01, 0x12, 0x00};
+    memcpy(&rom[size], loop, sizeof(loop));
+    return size + sizeof(loop);
+}
+
+int main(int argc, char** argv) {
+    long long count = argc > 1 ? atoll(argv[1]) : MEMBENCH_DEFAULT_INSTRUCTIONS;
+    if (count < 1) {
+        fprintf(stderr, "Usage: membench [instructions]\n");
+        return 1;
+    }
+
+    printf("%lld instructions per run\n", count);
+    printf("%-7s %-8s %10s %10s %12s\n", "machine", "base", "MIPS", "ns/instr", "faults");
+    for (int machine = Chip8_Machine_Chip8; machine <= Chip8_Machine_XoChip; machine++) {
+        chip8State_t* state = chip8_initMachine((enum chip8_machine)machine, NULL);
+        // inside memory, then so close to its end that every access through I wraps around
+        const uint16_t bases[] = {MEMBENCH_INSIDE, (uint16_t)(state->memSize - 8u)};
+        for (int b = 0; b < 2; b++) {
+            uint8_t data[MEMBENCH_ROM_SIZE];
+            size_t size = membench_program((enum chip8_machine)machine, bases[b], data);
+            chip8Rom_t rom = {NULL, data, size, chip8_romHash(data, size)};
+            chip8_reset(state);
+            chip8_loadRom(state, &rom);
+
+            double start = membench_seconds();
+            for (long long i = 0; i < count; i++) {
+                if (!chip8_emulateCycle(state)) {
+                    return 1;
+                }
+            }
+            double elapsed = membench_seconds() - start;
+            printf("%-7s 0x%04X %10.1f %10.2f %12llu\n", membench_machines[machine], bases[b],
+                   (double)count / elapsed / 1e6, 1e9 * elapsed / (double)count,
+                   (unsigned long long)chip8_faultCount(state));
+        }
+        chip8_del(&state);
+    }
+    return 0;
+}
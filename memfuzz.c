@@ -0,0 +1,237 @@
+#include <stdlib.h>
+#include <string.h>
+#include "chip8.h"
+
+#define MEMFUZZ_DEFAULT_ROMS 1000
+#define MEMFUZZ_DEFAULT_CYCLES 20000
+#define MEMFUZZ_KEY_INTERVAL 97     // Cycles between key events, so FX0A never waits for long
+
+static const char* memfuzz_machines[] = {"chip8", "schip", "xochip"};
+
+typedef struct {
+    uint64_t instructions;  // Instructions the run executed
+    uint64_t firstFault;    // Value of instructions when the first fault was counted or UINT64_MAX
+    bool stopped;           // Whether an invalid instruction ended the run before its last cycle
+} memfuzzRun_t;
+
+static void memfuzz_usage(void) {
+    fprintf(stderr, "Usage: memfuzz [--roms N] [--cycles N] [--seed N]\n");
+}
+
+static uint32_t memfuzz_next(uint32_t* random) {
+    uint32_t value = *random;
+    value ^= value << 13u;
+    value ^= value >> 17u;
+    value ^= value << 5u;
+    *random = value;
+    return value;
+}
+
+// an address in the last 256 bytes of memory, where every multi-byte access has a chance to run past the end
+static uint16_t memfuzz_nearEnd(uint32_t* random, uint32_t memSize) {
+    return (uint16_t)(memSize - 1u - (memfuzz_next(random) & 0xFFu));
+}
+
+// programs made of the instructions that form addresses, all of them valid on the machine so runs last long enough
+// to reach the end of memory
+static void memfuzz_generate(uint32_t* random, enum chip8_machine machine, uint32_t memSize, uint8_t* rom,
+                             size_t size) {
+    bool xoChip = machine == Chip8_Machine_XoChip;
+    for (size_t offset = 0; offset + 1 < size; offset += 2) {
+        uint32_t r = memfuzz_next(random);
+        uint16_t X = (r >> 8u) & 0xFu;
+        uint16_t Y = (r >> 12u) & 0xFu;
+        uint16_t opcode;
+        switch (r % (xoChip ? 13u : 10u)) {
+            case 0:
+                opcode = 0xA000 | (memfuzz_nearEnd(random, CHIP8_MEM_SIZE) & 0x0FFFu);
+                break;
+            case 1:
+                opcode = 0xF01E | X << 8u;
+                break;
+            case 2:
+                opcode = 0xF055 | X << 8u;
+                break;
+            case 3:
+                opcode = 0xF065 | X << 8u;
+                break;
+            case 4:
+                opcode = 0xF033 | X << 8u;
+                break;
+            case 5:
+                opcode = 0xD000 | X << 8u | Y << 4u | ((r >> 16u) & 0xFu);
+                break;
+            case 6:
+                // rarely, most of them leave the program for the fonts
+                opcode = (r & 0x00F00000u) == 0 ? 0xB000 | (memfuzz_nearEnd(random, CHIP8_MEM_SIZE) & 0x0FFFu)
+                                                : 0x7000 | X << 8u | ((r >> 16u) & 0xFFu);
+                break;
+            case 7:
+                opcode = 0x6000 | X << 8u | ((r >> 16u) & 0xFFu);
+                break;
+            case 8:
+                opcode = 0xF00A | X << 8u;
+                break;
+            case 9:
+                opcode = 0xC000 | X << 8u | 0xFF;
+                break;
+            case 10:
+                opcode = 0x5002 | X << 8u | Y << 4u | (r >> 16u & 1u);
+                break;
+            case 11:
+                // F002 or FN01, which makes sprites read a second plane
+                opcode = (r & 0x00100000u) ? 0xF002 : 0xF001 | (X & 0x3u) << 8u;
+                break;
+            default:
+                // F000 NNNN is two instructions long, the second half is the address
+                if (offset + 3 < size) {
+                    uint16_t address = memfuzz_nearEnd(random, memSize);
+                    rom[offset] = 0xF0;
+                    rom[offset + 1] = 0x00;
+                    offset += 2;
+                    opcode = address;
+                } else {
+                    opcode = 0x00E0;
+                }
+                break;
+        }
+        rom[offset] = (uint8_t)(opcode >> 8u);
+        rom[offset + 1] = (uint8_t)opcode;
+    }
+}
+
+// runs a rom and checks after every cycle that the guard still mirrors the start of memory
+static bool memfuzz_run(chip8State_t* state, const chip8Rom_t* rom, int cycles, memfuzzRun_t* run) {
+    chip8_reset(state);
+    chip8_loadRom(state, rom);
+    chip8_seedRandom(state, CHIP8_RANDOM_SEED);
+    run->firstFault = UINT64_MAX;
+    run->stopped = false;
+    for (int cycle = 0; cycle < cycles; cycle++) {
+        if (cycle % MEMFUZZ_KEY_INTERVAL == 0) {
+            // press and release a key the cycle number picks, the same in every run of the rom
+            chip8_queueKey(state, (cycle / MEMFUZZ_KEY_INTERVAL) % CHIP8_KEYS_SIZE, 1);
+            chip8_queueKey(state, (cycle / MEMFUZZ_KEY_INTERVAL) % CHIP8_KEYS_SIZE, 0);
+        }
+        uint64_t instructions = state->instructions;
+        bool valid = chip8_emulateCycle(state);
+        if (run->firstFault == UINT64_MAX && chip8_faultCount(state) != 0) {
+            run->firstFault = instructions;
+        }
+        if (memcmp(&state->memory[state->memSize], state->memory, CHIP8_MEMORY_GUARD) != 0) {
+            fprintf(stderr, "Guard no longer mirrors memory after instruction %llu\n",
+                    (unsigned long long)instructions);
+            return false;
+        }
+        if (!valid) {
+            run->stopped = true;
+            break;
+        }
+    }
+    run->instructions = state->instructions;
+    return true;
+}
+
+int main(int argc, char** argv) {
+    int romCount = MEMFUZZ_DEFAULT_ROMS;
+    int cycles = MEMFUZZ_DEFAULT_CYCLES;
+    uint32_t seed = CHIP8_RANDOM_SEED;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--roms") == 0 && i + 1 < argc) {
+            romCount = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--cycles") == 0 && i + 1 < argc) {
+            cycles = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else {
+            memfuzz_usage();
+            return 1;
+        }
+    }
+    if (romCount < 1 || cycles < 1) {
+        memfuzz_usage();
+        return 1;
+    }
+
+    uint8_t* data = malloc(CHIP8_XO_MAX_ROM_SIZE);
+    if (data == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    uint32_t random = seed != 0 ? seed : CHIP8_RANDOM_SEED;
+    int failed = 0;
+    for (int machine = Chip8_Machine_Chip8; machine <= Chip8_Machine_XoChip; machine++) {
+        chip8State_t* state = chip8_initMachine((enum chip8_machine)machine, NULL);
+        uint64_t faults[CHIP8_DISPATCH_SIZE] = {0};
+        uint64_t instructions = 0;
+        int faulted = 0;
+        for (int i = 0; i < romCount; i++) {
+            // every size up to filling memory, the full ones run into the end of memory by themselves
+            uint32_t maxSize = state->memSize - CHIP8_PC_START;
+            size_t size = (memfuzz_next(&random) % (maxSize / 2) + 1) * 2;
+            memfuzz_generate(&random, (enum chip8_machine)machine, state->memSize, data, size);
+            chip8Rom_t rom = {NULL, data, size, chip8_romHash(data, size)};
+
+            memfuzzRun_t counted;
+            memfuzzRun_t strict;
+            state->strictMemory = false;
+            if (!memfuzz_run(state, &rom, cycles, &counted)) {
+                failed++;
+                continue;
+            }
+            for (int c = 0; c < CHIP8_DISPATCH_SIZE; c++) {
+                faults[c] += state->faults[c];
+            }
+            instructions += counted.instructions;
+            faulted += counted.firstFault != UINT64_MAX;
+
+            // with the profiler attached the run has to be the same, and every instruction it saw stays inside its
+            // tables, which AddressSanitizer checks
+            memfuzzRun_t profiled;
+            state->strictMemory = false;
+            state->profiler = chip8_profilerInit(1, state->memSize);
+            bool ran = memfuzz_run(state, &rom, cycles, &profiled);
+            uint64_t profiledInstructions = state->profiler->instructions;
+            chip8_profilerDel(&state->profiler);
+            if (!ran) {
+                failed++;
+                continue;
+            }
+            if (profiled.instructions != counted.instructions || profiled.stopped != counted.stopped ||
+                profiledInstructions > profiled.instructions) {
+                fprintf(stderr, "%s rom %d: profiled run executed %llu instructions, the counting run %llu\n",
+                        memfuzz_machines[machine], i, (unsigned long long)profiled.instructions,
+                        (unsigned long long)counted.instructions);
+                failed++;
+            }
+
+            // strict mode has to stop at the first fault the counting run saw, and nowhere else
+            state->strictMemory = true;
+            if (!memfuzz_run(state, &rom, cycles, &strict)) {
+                failed++;
+                continue;
+            }
+            bool agrees = counted.firstFault == UINT64_MAX
+                          ? strict.instructions == counted.instructions && strict.stopped == counted.stopped &&
+                            chip8_faultCount(state) == 0
+                          : strict.instructions == counted.firstFault && strict.stopped && chip8_faultCount(state) == 1;
+            if (!agrees) {
+                fprintf(stderr, "%s rom %d: strict run stopped after %llu instructions, the first fault was at %llu\n",
+                        memfuzz_machines[machine], i, (unsigned long long)strict.instructions,
+                        (unsigned long long)counted.firstFault);
+                failed++;
+            }
+        }
+        printf("%s: %d roms, %llu instructions, %d roms ran past the end of memory\n", memfuzz_machines[machine],
+               romCount, (unsigned long long)instructions, faulted);
+        for (int c = 0; c < CHIP8_DISPATCH_SIZE; c++) {
+            if (faults[c] != 0) {
+                printf("  %XNNN: %llu faults\n", c, (unsigned long long)faults[c]);
+            }
+        }
+        chip8_del(&state);
+    }
+    free(data);
+    printf("%s\n", failed == 0 ? "no failures" : "FAILED");
+    return failed == 0 ? 0 : 1;
+}
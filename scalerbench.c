@@ -0,0 +1,102 @@
+#include <stdlib.h>
+#include <string.h>
+#include "chip8.h"
+#include "chip8_scaler.h"
+
+#define SCALERBENCH_WIDTH 1920
+#define SCALERBENCH_HEIGHT 1080
+#define SCALERBENCH_DEFAULT_FRAMES 1000
+#define SCALERBENCH_SIZES 3
+
+static const char* scalerbench_filters[] = {"nearest", "scale2x", "scale3x"};
+
+static double scalerbench_seconds(void) {
+    LARGE_INTEGER now;
+    LARGE_INTEGER frequency;
+    QueryPerformanceCounter(&now);
+    QueryPerformanceFrequency(&frequency);
+    return (double)now.QuadPart / (double)frequency.QuadPart;
+}
+
+// two frames of sprite-like noise, alternating them is what XOR drawn sprites look like to the phosphor filter
+static void scalerbench_frames(uint8_t* frames, int width, int height) {
+    srand(1);
+    for (int i = 0; i < width * height; i++) {
+        // runs of lit pixels in blocks, so the edge filters find edges to smooth
+        uint8_t lit = (uint8_t)((rand() & 3) == 0);
+        frames[i] = lit;
+        frames[width * height + i] = (i / width) % 2 == 0 ? lit : (uint8_t)(rand() & 1);
+    }
+}
+
+int main(int argc, char** argv) {
+    int frameCount = argc > 1 ? atoi(argv[1]) : SCALERBENCH_DEFAULT_FRAMES;
+    if (frameCount < 1) {
+        fprintf(stderr, "Usage: scalerbench [frames]\n");
+        return 1;
+    }
+
+    uint8_t* frames = malloc(2 * CHIP8_DISPLAY_SIZE);
+    if (frames == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    printf("%d frames per run into RGBA\n", frameCount);
+    printf("%-7s %-8s %-9s %-9s %-9s %10s\n", "isa", "filter", "effect", "output", "display", "ms/frame");
+    // display and output sizes, the last one is a high resolution display cut off by an output the size of a low
+    // resolution one
+    const int sizes[SCALERBENCH_SIZES][4] = {
+            {CHIP8_GRAPHICS_WIDTH, CHIP8_GRAPHICS_HEIGHT, SCALERBENCH_WIDTH, SCALERBENCH_HEIGHT},
+            {CHIP8_HIRES_WIDTH, CHIP8_HIRES_HEIGHT, SCALERBENCH_WIDTH, SCALERBENCH_HEIGHT},
+            {CHIP8_HIRES_WIDTH, CHIP8_HIRES_HEIGHT, CHIP8_GRAPHICS_WIDTH, CHIP8_GRAPHICS_HEIGHT}};
+    for (int isa = Chip8_Scaler_Isa_Scalar; isa <= Chip8_Scaler_Isa_Avx2; isa++) {
+        if (!chip8_scalerSupports((enum chip8_scalerIsa)isa)) {
+            continue;
+        }
+        for (int filter = Chip8_Scaler_Filter_Nearest; filter <= Chip8_Scaler_Filter_Scale3x; filter++) {
+            // plain, phosphor persistence and scanlines
+            for (int effect = 0; effect < 3; effect++) {
+                for (int size = 0; size < SCALERBENCH_SIZES; size++) {
+                    int width = sizes[size][0];
+                    int height = sizes[size][1];
+                    int outputWidth = sizes[size][2];
+                    int outputHeight = sizes[size][3];
+                    // exactly the size of the output, so AddressSanitizer catches anything written past it
+                    uint8_t* image = malloc((size_t)outputWidth * outputHeight * 4);
+                    if (image == NULL) {
+                        fprintf(stderr, "Out of memory\n");
+                        return 1;
+                    }
+                    scalerbench_frames(frames, width, height);
+                    chip8Scaler_t* scaler = chip8_scalerInit((enum chip8_scalerFilter)filter, outputWidth,
+                                                             outputHeight, effect == 1 ? 200 : 0, effect == 2);
+                    scaler->isa = (enum chip8_scalerIsa)isa;
+                    int scaledWidth;
+                    int scaledHeight;
+                    // warm up the caches and the afterglow
+                    chip8_scalerRun(scaler, frames, width, height, image, outputWidth * 4, &scaledWidth,
+                                    &scaledHeight);
+                    double start = scalerbench_seconds();
+                    for (int i = 0; i < frameCount; i++) {
+                        chip8_scalerRun(scaler, frames + (i % 2) * width * height, width, height, image,
+                                        outputWidth * 4, &scaledWidth, &scaledHeight);
+                    }
+                    double elapsed = scalerbench_seconds() - start;
+                    char output[16];
+                    char display[16];
+                    snprintf(output, sizeof(output), "%dx%d", outputWidth, outputHeight);
+                    snprintf(display, sizeof(display), "%dx%d", scaledWidth, scaledHeight);
+                    printf("%-7s %-8s %-9s %-9s %-9s %10.3f\n", chip8_scalerIsaName((enum chip8_scalerIsa)isa),
+                           scalerbench_filters[filter], effect == 1 ? "phosphor" : effect == 2 ? "scanlines" : "-",
+                           output, display, 1000.0 * elapsed / frameCount);
+                    chip8_scalerDel(&scaler);
+                    free(image);
+                }
+            }
+        }
+    }
+
+    free(frames);
+    return 0;
+}
@@ -0,0 +1,82 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "chip8_shared.h"
+
+#define SHMREADER_WATCH_MS 100
+#define SHMREADER_TEXT_SIZE 16384
+
+// Renders a snapshot into text straight from the mapping, returns false if it changed underneath
+static bool shmreader_render(const chip8SharedLayout_t* layout, char* text, uint64_t* frame) {
+    LONG sequence;
+    const chip8SharedSnapshot_t* snapshot = chip8_sharedBegin(layout, &sequence);
+    if (snapshot == NULL) {
+        return false;
+    }
+
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    double ageMs = 1000.0 * (double)((uint64_t)now.QuadPart - snapshot->publishTicks) /
+                   (double)layout->ticksPerSecond;
+    int length = snprintf(text, SHMREADER_TEXT_SIZE,
+                          "frame %llu  instructions %llu  faults %llu  published %.1f ms ago%s\n"
+                          "PC %03X  I %03X  SP %u  DT %u  ST %u\nV ",
+                          (unsigned long long)snapshot->frame, (unsigned long long)snapshot->instructions,
+                          (unsigned long long)snapshot->faults, ageMs,
+                          snapshot->waitingForKey ? "  waiting for key" : "", snapshot->PC, snapshot->I,
+                          snapshot->SP, snapshot->delay, snapshot->sound);
+    for (int i = 0; i < CHIP8_SHARED_REGISTERS; i++) {
+        length += snprintf(&text[length], SHMREADER_TEXT_SIZE - length, "%02X ", snapshot->V[i]);
+    }
+    text[length++] = '\n';
+    static const char shades[] = ".#+*";
+    uint32_t width = snapshot->width <= layout->width ? snapshot->width : layout->width;
+    uint32_t height = snapshot->height <= layout->height ? snapshot->height : layout->height;
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            text[length++] = shades[snapshot->gfx[y * width + x] & 3u];
+        }
+        text[length++] = '\n';
+    }
+    text[length] = '\0';
+    *frame = snapshot->frame;
+    return chip8_sharedValidate(layout, sequence);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: shmreader <pid|name> [--watch]\n");
+        return 1;
+    }
+
+    char name[CHIP8_SHARED_NAME_SIZE];
+    if (isdigit((unsigned char)argv[1][0])) {
+        snprintf(name, sizeof(name), CHIP8_SHARED_NAME_FORMAT, strtoul(argv[1], NULL, 10));
+    } else {
+        snprintf(name, sizeof(name), "%s", argv[1]);
+    }
+    bool watch = argc > 2 && strcmp(argv[2], "--watch") == 0;
+
+    const chip8SharedLayout_t* layout = chip8_sharedOpen(name);
+    if (layout == NULL) {
+        return 1;
+    }
+
+    char text[SHMREADER_TEXT_SIZE];
+    uint64_t frame = 0;
+    uint64_t retries = 0;
+    do {
+        while (!shmreader_render(layout, text, &frame)) {
+            retries++;
+        }
+        printf("%s%llu retries\n\n", text, (unsigned long long)retries);
+        fflush(stdout);
+        if (watch) {
+            Sleep(SHMREADER_WATCH_MS);
+        }
+    } while (watch);
+
+    chip8_sharedClose(layout);
+    return 0;
+}
@@ -0,0 +1,122 @@
+#include <stdlib.h>
+#include <string.h>
+#include "chip8_stream.h"
+#include "chip8_rom.h"
+
+#define STREAMER_DEFAULT_INSTANCES 1
+#define STREAMER_DEFAULT_SECONDS 0      // Run until killed
+
+static void streamer_usage(void) {
+    fprintf(stderr, "Usage: streamer <rom.ch8> [--instances N] [--port P] [--seconds N] [--schip|--xochip]\n");
+}
+
+static double streamer_seconds(void) {
+    LARGE_INTEGER now;
+    LARGE_INTEGER frequency;
+    QueryPerformanceCounter(&now);
+    QueryPerformanceFrequency(&frequency);
+    return (double)now.QuadPart / (double)frequency.QuadPart;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        streamer_usage();
+        return 1;
+    }
+
+    const char* romPath = argv[1];
+    int instanceCount = STREAMER_DEFAULT_INSTANCES;
+    int port = CHIP8_STREAM_DEFAULT_PORT;
+    double seconds = STREAMER_DEFAULT_SECONDS;
+    enum chip8_machine machine = Chip8_Machine_Chip8;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--instances") == 0 && i + 1 < argc) {
+            instanceCount = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+            port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            seconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--schip") == 0) {
+            machine = Chip8_Machine_SuperChip;
+        } else if (strcmp(argv[i], "--xochip") == 0) {
+            machine = Chip8_Machine_XoChip;
+        } else {
+            streamer_usage();
+            return 1;
+        }
+    }
+    if (instanceCount < 1 || port < 1 || port > 65535) {
+        streamer_usage();
+        return 1;
+    }
+
+    // every instance runs the same rom, map it once
+    chip8Rom_t* rom = chip8_romOpen(romPath, CHIP8_XO_MAX_ROM_SIZE);
+    if (rom == NULL) {
+        return 1;
+    }
+    // and its artifact, every instance holds it for as long as its program leaves its code alone
+    chip8Aot_t* aot = chip8_aotOpen(CHIP8_AOT_DIR, rom);
+    chip8State_t** states = calloc((size_t)instanceCount, sizeof(chip8State_t*));
+    for (int i = 0; i < instanceCount; i++) {
+        states[i] = chip8_initMachine(machine, NULL);
+        if (!chip8_loadRom(states[i], rom)) {
+            for (int j = 0; j <= i; j++) {
+                chip8_del(&states[j]);
+            }
+            free(states);
+            chip8_aotClose(&aot);
+            chip8_romClose(&rom);
+            return 1;
+        }
+        chip8_attachAot(states[i], aot);
+    }
+    chip8_aotClose(&aot);
+    chip8_romClose(&rom);
+
+    chip8Stream_t* stream = chip8_streamInit((uint16_t)port, instanceCount);
+    if (stream == NULL) {
+        for (int i = 0; i < instanceCount; i++) {
+            chip8_del(&states[i]);
+        }
+        free(states);
+        return 1;
+    }
+    fprintf(stderr, "Streaming %d instances on 127.0.0.1:%d\n", instanceCount, port);
+
+    double start = streamer_seconds();
+    long frame = 0;
+    while (seconds <= 0 || frame * CHIP8_ALLEGRO_TIMER_UPDATE_SECS < seconds) {
+        for (int i = 0; i < instanceCount; i++) {
+            if (states[i] == NULL) {
+                continue;
+            }
+            chip8_streamApplyKeys(stream, i, states[i]);
+            if (!chip8_emulateFrame(states[i])) {
+                // a crashed instance keeps its last frame on screen, the others carry on
+                fprintf(stderr, "Instance %d stopped\n", i);
+                chip8_del(&states[i]);
+                continue;
+            }
+            chip8_streamPublish(stream, i, states[i]);
+            states[i]->drawFlag = false;
+        }
+        frame++;
+        // pace to the 60 Hz timers, a machine that can not keep up runs as fast as it can
+        double wait = start + frame * CHIP8_ALLEGRO_TIMER_UPDATE_SECS - streamer_seconds();
+        if (wait > 0) {
+            Sleep((DWORD)(wait * 1000.0));
+        }
+    }
+    fprintf(stderr, "%ld frames emulated, %llu frames sent, %llu dropped\n", frame,
+            (unsigned long long)stream->framesSent, (unsigned long long)stream->framesDropped);
+
+    chip8_streamDel(&stream);
+    for (int i = 0; i < instanceCount; i++) {
+        if (states[i] != NULL) {
+            chip8_del(&states[i]);
+        }
+    }
+    free(states);
+    return 0;
+}